@@ -0,0 +1,255 @@
+/*
+
+File: checksummed_matrix.hpp
+Author: Aldhinn Espinas
+Description: This file contains the checksum-augmented matrix declarations used for
+    algorithm-based fault tolerance of matrix multiplications.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(CHECKSUMMED_MATRIX_HEADER_FILE)
+#define CHECKSUMMED_MATRIX_HEADER_FILE
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "matrix.hpp"
+
+/// @brief The row and column sums of a 4x4 matrix.
+struct alignas(32) Checksums4x4 {
+    /// @brief The sum of each row.
+    double rowSums[4];
+    /// @brief The sum of each column.
+    double colSums[4];
+};
+
+/// @brief Compute the row and column sums of a matrix.
+/// @param mat The matrix.
+/// @return The checksums.
+inline Checksums4x4 computeChecksums(const Matrix4x4& mat) {
+    Checksums4x4 sums;
+    for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+        const double* row = mat.data + rowIndex * 4;
+        sums.rowSums[rowIndex] = (row[0] + row[1]) + (row[2] + row[3]);
+    }
+    for (int colIndex = 0; colIndex < 4; colIndex++) {
+        sums.colSums[colIndex] = (mat.data[colIndex] + mat.data[4 + colIndex]) +
+            (mat.data[8 + colIndex] + mat.data[12 + colIndex]);
+    }
+    return sums;
+}
+
+/// @brief The exclusive or of the bit patterns of the elements of each row and column
+/// of a 4x4 matrix. Unlike sums, they are exact and can be adjusted for ever.
+struct Parities4x4 {
+    /// @brief The parity of each row.
+    ::std::uint64_t rowParities[4];
+    /// @brief The parity of each column.
+    ::std::uint64_t colParities[4];
+};
+
+/// @brief The bit pattern of a double.
+inline ::std::uint64_t bitsOf(double value) {
+    ::std::uint64_t bits;
+    ::std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/// @brief Compute the row and column parities of a matrix.
+/// @param mat The matrix.
+/// @return The parities.
+inline Parities4x4 computeParities(const Matrix4x4& mat) {
+    Parities4x4 parities = {};
+    for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+        for (int colIndex = 0; colIndex < 4; colIndex++) {
+            ::std::uint64_t bits = bitsOf(mat.data[rowIndex * 4 + colIndex]);
+            parities.rowParities[rowIndex] ^= bits;
+            parities.colParities[colIndex] ^= bits;
+        }
+    }
+    return parities;
+}
+
+/// @brief Determines if two checksums agree within a tolerance.
+/// @param left The left hand-side checksum.
+/// @param right The right hand-side checksum.
+/// @param tolerance The accepted difference, relative to their magnitude.
+inline bool checksumsMatch(double left, double right, double tolerance) {
+    if (left == right) return true;
+    double scale = ::std::fmax(1.0, ::std::fmax(::std::fabs(left), ::std::fabs(right)));
+    return ::std::fabs(left - right) <= tolerance * scale;
+}
+
+/// @brief Determines if a matrix agrees with the checksums it carries.
+/// A mismatch means the matrix was read while it was being written, or got corrupted.
+/// @param mat The matrix.
+/// @param sums The checksums carried with the matrix.
+/// @param tolerance The accepted difference, relative to the magnitude of the sums.
+inline bool checkOperand(const Matrix4x4& mat, const Checksums4x4& sums, double tolerance = 1e-12) {
+    Checksums4x4 actual = computeChecksums(mat);
+    for (int i = 0; i < 4; i++) {
+        if (!checksumsMatch(actual.rowSums[i], sums.rowSums[i], tolerance) ||
+            !checksumsMatch(actual.colSums[i], sums.colSums[i], tolerance)) return false;
+    }
+    return true;
+}
+
+/// @brief Determines if a product agrees with the checksums of its operands.
+///
+/// The column sums of `A B` are the column sums of `A` times `B`, and its row sums
+/// are `A` times the row sums of `B`. Both take O(n^2) operations, against the O(n^3)
+/// of recomputing the product.
+/// @param leftMat The left hand-side matrix.
+/// @param leftSums The checksums of the left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param rightSums The checksums of the right hand-side matrix.
+/// @param dotProduct The dot product to be checked.
+/// @param tolerance The accepted difference, relative to the magnitude of the sums.
+inline bool checkProduct(const Matrix4x4& leftMat, const Checksums4x4& leftSums,
+    const Matrix4x4& rightMat, const Checksums4x4& rightSums,
+    const Matrix4x4& dotProduct, double tolerance = 1e-12) {
+    Checksums4x4 actual = computeChecksums(dotProduct);
+    for (int i = 0; i < 4; i++) {
+        double expectedRowSum = 0.0;
+        double expectedColSum = 0.0;
+        for (int k = 0; k < 4; k++) {
+            expectedRowSum += leftMat.data[i * 4 + k] * rightSums.rowSums[k];
+            expectedColSum += leftSums.colSums[k] * rightMat.data[k * 4 + i];
+        }
+        if (!checksumsMatch(actual.rowSums[i], expectedRowSum, tolerance) ||
+            !checksumsMatch(actual.colSums[i], expectedColSum, tolerance)) return false;
+    }
+    return true;
+}
+
+/// @brief Multiply two matrices and check the product against their checksums.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param dotProduct The dot product.
+/// @param tolerance The accepted difference, relative to the magnitude of the sums.
+/// @return Whether the product passed the check.
+inline bool multiplyChecked(const Matrix4x4& leftMat, const Matrix4x4& rightMat, Matrix4x4& dotProduct,
+    double tolerance = 1e-12) {
+    dotProduct = leftMat * rightMat;
+    return checkProduct(leftMat, computeChecksums(leftMat), rightMat, computeChecksums(rightMat),
+        dotProduct, tolerance);
+}
+
+/// @brief A description of a 4x4 matrix containing atomic values that carries its
+/// row and column parities.
+///
+/// Every write adjusts the parities along with the element, so that a reader can tell a
+/// snapshot taken in the middle of a write apart from a state the matrix really had.
+/// Parities rather than sums are carried, since adjusting a sum rounds, and the error of
+/// many writes adds up until every snapshot fails the check.
+class ChecksummedMatrix4x4 final {
+public:
+    /// @brief Construct from a plain matrix.
+    /// @param values The plain matrix where data is being copied from.
+    inline explicit ChecksummedMatrix4x4(const Matrix4x4& values = Matrix4x4()) {
+        Parities4x4 parities = computeParities(values);
+        for (int i = 0; i < 16; i++) _data[i].store(values.data[i]);
+        for (int i = 0; i < 4; i++) {
+            _rowParities[i].store(parities.rowParities[i]);
+            _colParities[i].store(parities.colParities[i]);
+        }
+    }
+
+    ChecksummedMatrix4x4(const ChecksummedMatrix4x4&) = delete;
+    ChecksummedMatrix4x4& operator=(const ChecksummedMatrix4x4&) = delete;
+
+    /// @brief Set the element in the specified index.
+    /// @param rowIndex The row-index of the element.
+    /// @param colIndex The column-index of the element.
+    /// @param value The new value.
+    inline void store(unsigned int rowIndex, unsigned int colIndex, double value) {
+        if (rowIndex >= 4 || colIndex >= 4) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        // Exchanging makes the adjustments of concurrent writers add up.
+        ::std::uint64_t change = bitsOf(value) ^ bitsOf(_data[rowIndex * 4 + colIndex].exchange(value));
+        _rowParities[rowIndex].fetch_xor(change);
+        _colParities[colIndex].fetch_xor(change);
+    }
+    /// @brief Get the value of the element in the specified index.
+    /// @param rowIndex The row-index of the element.
+    /// @param colIndex The column-index of the element.
+    inline double load(unsigned int rowIndex, unsigned int colIndex) const {
+        if (rowIndex >= 4 || colIndex >= 4) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return _data[rowIndex * 4 + colIndex].load();
+    }
+
+    /// @brief Load every element, then the parities, and check them against each other.
+    /// @param values The loaded elements.
+    /// @param sums The checksums of the loaded elements, for checking products.
+    /// @return Whether the elements matched the parities, exactly.
+    inline bool snapshot(Matrix4x4& values, Checksums4x4& sums) const {
+        for (int i = 0; i < 16; i++) values.data[i] = _data[i].load();
+        Parities4x4 actual = computeParities(values);
+        bool isConsistent = true;
+        for (int i = 0; i < 4; i++) {
+            isConsistent = isConsistent && _rowParities[i].load() == actual.rowParities[i] &&
+                _colParities[i].load() == actual.colParities[i];
+        }
+        sums = computeChecksums(values);
+        return isConsistent;
+    }
+
+private:
+    /// @brief The row-major container for the matrix components.
+    ::std::atomic<double> _data[16];
+    /// @brief The parity of each row.
+    ::std::atomic<::std::uint64_t> _rowParities[4];
+    /// @brief The parity of each column.
+    ::std::atomic<::std::uint64_t> _colParities[4];
+};
+
+/// @brief Multiply two checksummed matrices and check both the operands and the product.
+///
+/// A failed check means that an operand was read in the middle of a write, or that
+/// the product got corrupted. Either way the product is not to be used, and the
+/// multiplication may simply be repeated.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param dotProduct The dot product.
+/// @param tolerance The accepted difference, relative to the magnitude of the sums.
+/// @return Whether the operands and the product passed the checks.
+inline bool multiplyChecked(const ChecksummedMatrix4x4& leftMat, const ChecksummedMatrix4x4& rightMat,
+    Matrix4x4& dotProduct, double tolerance = 1e-12) {
+    Matrix4x4 left, right;
+    Checksums4x4 leftSums, rightSums;
+    if (!leftMat.snapshot(left, leftSums) || !rightMat.snapshot(right, rightSums)) return false;
+
+    dotProduct = left * right;
+    return checkProduct(left, leftSums, right, rightSums, dotProduct, tolerance);
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
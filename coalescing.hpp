@@ -0,0 +1,278 @@
+/*
+
+File: coalescing.hpp
+Author: Aldhinn Espinas
+Description: This file contains a 4x4 matrix whose element writes are buffered per
+    thread and published merged.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(COALESCING_HEADER_FILE)
+#define COALESCING_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "matrix.hpp"
+#include "seqlock.hpp"
+
+/// @brief A description of a 4x4 matrix whose element writes are coalesced.
+///
+/// Each writing thread records its writes in a buffer of its own, keeping only the latest
+/// value of each element. A flush merges the buffers, the latest write of an element
+/// winning, and publishes them as a single write section of a seqlock, so an element
+/// overwritten many times between flushes is published once and readers retry once per
+/// flush rather than once per write. A write takes no lock: only its thread writes a
+/// buffer, under a seqlock of the buffer that flushes read it with. Flushes happen when
+/// a writer buffered enough writes, when a reader asks, and on a background thread once
+/// per flush interval, so that the writes of a writer gone idle still reach readers.
+class CoalescingMatrix4x4 final {
+private:
+    struct Buffer;
+
+public:
+    /// @brief The buffer of a writing thread.
+    class Writer final {
+    public:
+        /// @brief Write an element.
+        /// @param rowIndex The row-index of the element.
+        /// @param colIndex The column-index of the element.
+        /// @param value The new value.
+        inline void store(unsigned int rowIndex, unsigned int colIndex, double value) {
+            if (rowIndex >= 4 || colIndex >= 4) {
+                throw ::std::out_of_range("Invalid index.");
+            }
+            // Increasing, so that flushes tell every write of the buffer from the last.
+            ::std::int64_t stamp = ::std::max(CoalescingMatrix4x4::now(), _buffer->lastStamp + 1);
+            _buffer->lastStamp = stamp;
+            unsigned int index = rowIndex * 4 + colIndex;
+            {
+                SeqLockWriteGuard guard(_buffer->version);
+                _buffer->values[index].store(value, ::std::memory_order_relaxed);
+                _buffer->stamps[index].store(stamp, ::std::memory_order_relaxed);
+            }
+            _buffer->writes.store(_buffer->writes.load(::std::memory_order_relaxed) + 1, ::std::memory_order_relaxed);
+            if (++_buffer->pendingWrites >= _matrix->_countThreshold) {
+                _buffer->pendingWrites = 0;
+                _matrix->flush();
+            }
+        }
+
+    private:
+        friend class CoalescingMatrix4x4;
+        inline Writer(CoalescingMatrix4x4* matrix, Buffer* buffer) : _matrix(matrix), _buffer(buffer) {}
+
+        /// @brief The matrix. Needs to outlive the writer.
+        CoalescingMatrix4x4* _matrix;
+        /// @brief The buffer of this thread.
+        Buffer* _buffer;
+    };
+
+    /// @brief Construct with an initial value.
+    /// @param values The initial value.
+    /// @param countThreshold The number of buffered writes of a thread that triggers a flush.
+    /// @param flushInterval The period of the background flushes, or 0 for none.
+    inline explicit CoalescingMatrix4x4(const Matrix4x4& values = Matrix4x4::identity(),
+        unsigned int countThreshold = 64, ::std::chrono::microseconds flushInterval = ::std::chrono::milliseconds(1)) :
+    _countThreshold(countThreshold == 0 ? 1 : countThreshold), _flushInterval(flushInterval),
+    _publishedWrites(0), _flushes(0), _isStopping(false) {
+        for (int i = 0; i < 16; i++) {
+            _data[i].store(values.data[i], ::std::memory_order_relaxed);
+            _stamps[i] = 0;
+        }
+        if (_flushInterval.count() > 0) _flusher = ::std::thread(&CoalescingMatrix4x4::runFlusher, this);
+    }
+    /// @brief Stop the background flushes. The writes still buffered are dropped.
+    inline ~CoalescingMatrix4x4() {
+        {
+            ::std::lock_guard<::std::mutex> lock(_flusherMutex);
+            _isStopping = true;
+        }
+        _flusherCondition.notify_one();
+        if (_flusher.joinable()) _flusher.join();
+    }
+
+    CoalescingMatrix4x4(const CoalescingMatrix4x4&) = delete;
+    CoalescingMatrix4x4& operator=(const CoalescingMatrix4x4&) = delete;
+
+    /// @brief Get the buffer of a new writing thread.
+    /// @return The writer, to be used by a single thread.
+    inline Writer writer() {
+        ::std::lock_guard<::std::mutex> lock(_flushMutex);
+        _buffers.emplace_back(new Buffer());
+        return Writer(this, _buffers.back().get());
+    }
+
+    /// @brief Read the published matrix, without the writes still buffered.
+    inline Matrix4x4 load() const {
+        Matrix4x4 values;
+        _version.read([&]() {
+            for (int i = 0; i < 16; i++) values.data[i] = _data[i].load(::std::memory_order_relaxed);
+        });
+        return values;
+    }
+    /// @brief Flush, then read the matrix.
+    inline Matrix4x4 loadLatest() {
+        flush();
+        return load();
+    }
+
+    /// @brief Publish the buffered writes of every thread as a single change.
+    inline void flush() {
+        ::std::lock_guard<::std::mutex> lock(_flushMutex);
+        double values[16];
+        ::std::int64_t stamps[16];
+        ::std::uint16_t dirtyMask = 0;
+        for (const ::std::unique_ptr<Buffer>& buffer : _buffers) {
+            double bufferValues[16];
+            ::std::int64_t bufferStamps[16];
+            buffer->version.read([&]() {
+                for (int i = 0; i < 16; i++) {
+                    bufferValues[i] = buffer->values[i].load(::std::memory_order_relaxed);
+                    bufferStamps[i] = buffer->stamps[i].load(::std::memory_order_relaxed);
+                }
+            });
+            // The elements written since the last flush are the ones with a newer stamp.
+            for (int i = 0; i < 16; i++) {
+                if (bufferStamps[i] <= buffer->flushedStamps[i]) continue;
+                buffer->flushedStamps[i] = bufferStamps[i];
+                if ((dirtyMask & (1u << i)) == 0 || bufferStamps[i] > stamps[i]) {
+                    values[i] = bufferValues[i];
+                    stamps[i] = bufferStamps[i];
+                }
+                dirtyMask |= static_cast<::std::uint16_t>(1u << i);
+            }
+        }
+        // A write stamped before one already published lost, even if flushed later.
+        for (int i = 0; i < 16; i++) {
+            if ((dirtyMask & (1u << i)) != 0 && stamps[i] < _stamps[i]) dirtyMask &= static_cast<::std::uint16_t>(~(1u << i));
+        }
+        if (dirtyMask == 0) return;
+
+        SeqLockWriteGuard guard(_version);
+        for (::std::uint16_t mask = dirtyMask; mask != 0; mask &= static_cast<::std::uint16_t>(mask - 1)) {
+            int i = __builtin_ctz(mask);
+            _data[i].store(values[i], ::std::memory_order_relaxed);
+            _stamps[i] = stamps[i];
+            _publishedWrites.fetch_add(1, ::std::memory_order_relaxed);
+        }
+        _flushes.fetch_add(1, ::std::memory_order_relaxed);
+    }
+
+    /// @brief The number of element writes so far.
+    inline unsigned long long writes() {
+        ::std::lock_guard<::std::mutex> lock(_flushMutex);
+        unsigned long long total = 0;
+        for (const ::std::unique_ptr<Buffer>& buffer : _buffers) total += buffer->writes.load(::std::memory_order_relaxed);
+        return total;
+    }
+    /// @brief The number of element writes that made it to the matrix, at most one per
+    /// element and flush.
+    inline unsigned long long publishedWrites() const { return _publishedWrites.load(::std::memory_order_relaxed); }
+    /// @brief The number of flushes that published anything, each a single version.
+    inline unsigned long long flushes() const { return _flushes.load(::std::memory_order_relaxed); }
+
+private:
+    /// @brief The writes of a thread since the last flush.
+    struct alignas(64) Buffer {
+        inline Buffer() : lastStamp(0), pendingWrites(0), writes(0) {
+            for (int i = 0; i < 16; i++) {
+                values[i].store(0.0, ::std::memory_order_relaxed);
+                stamps[i].store(0, ::std::memory_order_relaxed);
+                flushedStamps[i] = 0;
+            }
+        }
+
+        /// @brief The version of the values, written by the thread of the buffer alone.
+        SeqLock version;
+        /// @brief The latest value of each element.
+        ::std::atomic<double> values[16];
+        /// @brief The time of the latest write of each element, 0 if never written.
+        ::std::atomic<::std::int64_t> stamps[16];
+        /// @brief The stamp of each element taken by the last flush. Under the flush mutex.
+        ::std::int64_t flushedStamps[16];
+        /// @brief The stamp of the latest write. Used by the thread of the buffer alone.
+        ::std::int64_t lastStamp;
+        /// @brief The number of writes since this thread last flushed. Used by the thread
+        /// of the buffer alone.
+        unsigned int pendingWrites;
+        /// @brief The number of writes ever.
+        ::std::atomic<unsigned long long> writes;
+    };
+
+    /// @brief Flush once per flush interval until stopped.
+    inline void runFlusher() {
+        ::std::unique_lock<::std::mutex> lock(_flusherMutex);
+        while (!_flusherCondition.wait_for(lock, _flushInterval, [this]() { return _isStopping; })) {
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+    /// @brief The time used to order writes, in nanoseconds.
+    inline static ::std::int64_t now() {
+        return ::std::chrono::duration_cast<::std::chrono::nanoseconds>(
+            ::std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    /// @brief The row-major container for the matrix components.
+    ::std::atomic<double> _data[16];
+    /// @brief The time of the write published in each element. Under the flush mutex.
+    ::std::int64_t _stamps[16];
+    /// @brief The version checked by readers.
+    SeqLock _version;
+    /// @brief Serializes flushes and registrations.
+    ::std::mutex _flushMutex;
+    /// @brief The buffer of each writing thread.
+    ::std::vector<::std::unique_ptr<Buffer>> _buffers;
+    /// @brief The number of buffered writes of a thread that triggers a flush.
+    const unsigned int _countThreshold;
+    /// @brief The period of the background flushes.
+    const ::std::chrono::microseconds _flushInterval;
+    /// @brief The number of element writes published.
+    alignas(64) ::std::atomic<unsigned long long> _publishedWrites;
+    /// @brief The number of flushes that published anything.
+    ::std::atomic<unsigned long long> _flushes;
+    /// @brief Guards the stop request of the background flushes.
+    ::std::mutex _flusherMutex;
+    /// @brief Wakes the background flushes up to stop.
+    ::std::condition_variable _flusherCondition;
+    /// @brief Set to stop the background flushes.
+    bool _isStopping;
+    /// @brief Runs the background flushes.
+    ::std::thread _flusher;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
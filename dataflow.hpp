@@ -0,0 +1,264 @@
+/*
+
+File: dataflow.hpp
+Author: Aldhinn Espinas
+Description: This file contains a graph of matrix expressions over source matrices,
+    recomputed incrementally when the sources change.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(DATAFLOW_HEADER_FILE)
+#define DATAFLOW_HEADER_FILE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+/// @brief A graph of matrix expressions, such as products, sums and inverses, over
+/// source matrices.
+///
+/// Changing a source marks the nodes depending on it dirty, and `recompute()` only
+/// evaluates those, level by level in topological order, with the nodes of a level in
+/// parallel. The values are published as a whole with a version, so readers always see
+/// every node computed from the same sources, and never wait for a recomputation. A
+/// snapshot holds on to its version for as long as it lives. Taking one is an atomic
+/// load of a `shared_ptr`, which libstdc++ guards with a short lock from a global pool.
+class DataflowGraph final {
+public:
+    /// @brief The identifier of a node.
+    using NodeId = ::std::size_t;
+
+    /// @brief The number of nodes of a level handed to a thread. Each is a small
+    /// fixed amount of work.
+    static constexpr ::std::size_t RECOMPUTE_GRAIN = 256;
+
+    /// @brief The values of every node at one version.
+    class Snapshot final {
+    public:
+        /// @brief The version, increased by each recomputation.
+        inline ::std::uint64_t version() const { return _state->version; }
+        /// @brief The number of nodes computed.
+        inline ::std::size_t size() const { return _state->values.size(); }
+        /// @brief The value of a node.
+        /// @param node The node, which has to be computed.
+        inline const Matrix4x4& value(NodeId node) const {
+            if (node >= _state->values.size()) {
+                throw ::std::out_of_range("Invalid index.");
+            }
+            return *_state->values[node];
+        }
+
+    private:
+        friend class DataflowGraph;
+        /// @brief The values of a version.
+        struct State {
+            /// @brief The version.
+            ::std::uint64_t version = 0;
+            /// @brief The value of each node.
+            ::std::vector<::std::shared_ptr<const Matrix4x4>> values;
+        };
+        inline explicit Snapshot(::std::shared_ptr<const State> state) : _state(::std::move(state)) {}
+
+        /// @brief The published values.
+        ::std::shared_ptr<const State> _state;
+    };
+
+    inline DataflowGraph() : _state(::std::make_shared<const Snapshot::State>()) {}
+
+    DataflowGraph(const DataflowGraph&) = delete;
+    DataflowGraph& operator=(const DataflowGraph&) = delete;
+
+    /// @brief The number of nodes.
+    inline ::std::size_t size() const {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        return _nodes.size();
+    }
+
+    /// @brief Add a source matrix.
+    inline NodeId addSource(const Matrix4x4& value) {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        NodeId node = addNode(Operation::Source, 0, 0);
+        _sourceValues[node] = value;
+        return node;
+    }
+    /// @brief Add the product of two nodes.
+    inline NodeId addProduct(NodeId left, NodeId right) { return addExpression(Operation::Product, left, right); }
+    /// @brief Add the sum of two nodes.
+    inline NodeId addSum(NodeId left, NodeId right) { return addExpression(Operation::Sum, left, right); }
+    /// @brief Add the difference of two nodes.
+    inline NodeId addDifference(NodeId left, NodeId right) { return addExpression(Operation::Difference, left, right); }
+    /// @brief Add the inverse of a node. Recomputing throws while it is singular.
+    inline NodeId addInverse(NodeId operand) { return addExpression(Operation::Inverse, operand, operand); }
+    /// @brief Add the transpose of a node.
+    inline NodeId addTranspose(NodeId operand) { return addExpression(Operation::Transpose, operand, operand); }
+
+    /// @brief Change a source, marking the nodes depending on it dirty. Takes effect at
+    /// the next `recompute()`.
+    /// @param source The source.
+    /// @param value The new value.
+    inline void set(NodeId source, const Matrix4x4& value) {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        checkNode(source);
+        if (_nodes[source].operation != Operation::Source) {
+            throw ::std::invalid_argument("Only sources can be set.");
+        }
+        _sourceValues[source] = value;
+        markDirty(source);
+    }
+
+    /// @brief Evaluate the dirty nodes and publish the values as a new version. Nothing
+    /// is published if an evaluation throws, and the nodes stay dirty.
+    /// @return The number of nodes evaluated.
+    inline ::std::size_t recompute() {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        if (_dirty.empty()) return 0;
+        // Nodes only depend on earlier nodes, so ordering by level keeps the inputs of a
+        // node ahead of it, and the nodes of a level independent of each other.
+        ::std::sort(_dirty.begin(), _dirty.end(), [this](NodeId left, NodeId right) {
+            return _nodes[left].level != _nodes[right].level ? _nodes[left].level < _nodes[right].level : left < right;
+        });
+        ::std::shared_ptr<const Snapshot::State> current = ::std::atomic_load(&_state);
+        ::std::vector<::std::shared_ptr<const Matrix4x4>> values = current->values;
+        values.resize(_nodes.size());
+        for (::std::size_t levelBegin = 0; levelBegin < _dirty.size();) {
+            ::std::size_t levelEnd = levelBegin;
+            unsigned int level = _nodes[_dirty[levelBegin]].level;
+            while (levelEnd < _dirty.size() && _nodes[_dirty[levelEnd]].level == level) levelEnd++;
+            parallelFor(levelBegin, levelEnd, RECOMPUTE_GRAIN, [&](::std::size_t begin, ::std::size_t end) {
+                for (::std::size_t i = begin; i < end; i++) {
+                    values[_dirty[i]] = ::std::make_shared<const Matrix4x4>(evaluate(_dirty[i], values));
+                }
+            });
+            levelBegin = levelEnd;
+        }
+
+        ::std::shared_ptr<Snapshot::State> next = ::std::make_shared<Snapshot::State>();
+        next->version = current->version + 1;
+        next->values = ::std::move(values);
+        ::std::atomic_store(&_state, ::std::shared_ptr<const Snapshot::State>(::std::move(next)));
+        ::std::size_t count = _dirty.size();
+        for (NodeId node : _dirty) _nodes[node].isDirty = false;
+        _dirty.clear();
+        return count;
+    }
+
+    /// @brief The values of the last recomputation. Takes the short lock of the atomic
+    /// `shared_ptr`, never the lock of the recomputation.
+    inline Snapshot snapshot() const { return Snapshot(::std::atomic_load(&_state)); }
+
+private:
+    /// @brief The operation of a node.
+    enum class Operation { Source, Product, Sum, Difference, Inverse, Transpose };
+    /// @brief A node.
+    struct Node {
+        /// @brief The operation.
+        Operation operation;
+        /// @brief The left or only operand.
+        NodeId left;
+        /// @brief The right operand.
+        NodeId right;
+        /// @brief 0 for sources, else one more than the level of the operands.
+        unsigned int level;
+        /// @brief The nodes using this one as an operand.
+        ::std::vector<NodeId> dependents;
+        /// @brief Determines if the node waits for a recomputation.
+        bool isDirty;
+    };
+
+    inline void checkNode(NodeId node) const {
+        if (node >= _nodes.size()) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+    }
+    inline NodeId addExpression(Operation operation, NodeId left, NodeId right) {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        checkNode(left);
+        checkNode(right);
+        return addNode(operation, left, right);
+    }
+    /// @brief Add a node, dirty. The mutex needs to be held.
+    inline NodeId addNode(Operation operation, NodeId left, NodeId right) {
+        NodeId node = _nodes.size();
+        unsigned int level = 0;
+        if (operation != Operation::Source) {
+            level = ::std::max(_nodes[left].level, _nodes[right].level) + 1;
+            _nodes[left].dependents.push_back(node);
+            if (right != left) _nodes[right].dependents.push_back(node);
+        }
+        _nodes.push_back({operation, left, right, level, {}, false});
+        _sourceValues.emplace_back();
+        markDirty(node);
+        return node;
+    }
+    /// @brief Mark a node and every node depending on it dirty. The mutex needs to be held.
+    inline void markDirty(NodeId node) {
+        ::std::vector<NodeId> stack = {node};
+        while (!stack.empty()) {
+            NodeId current = stack.back();
+            stack.pop_back();
+            // Whatever depends on a dirty node is dirty already.
+            if (_nodes[current].isDirty) continue;
+            _nodes[current].isDirty = true;
+            _dirty.push_back(current);
+            for (NodeId dependent : _nodes[current].dependents) stack.push_back(dependent);
+        }
+    }
+    /// @brief The value of a node from the values of its operands.
+    inline Matrix4x4 evaluate(NodeId node, const ::std::vector<::std::shared_ptr<const Matrix4x4>>& values) const {
+        const Node& current = _nodes[node];
+        switch (current.operation) {
+        case Operation::Source: return _sourceValues[node];
+        case Operation::Product: return *values[current.left] * *values[current.right];
+        case Operation::Sum: return *values[current.left] + *values[current.right];
+        case Operation::Difference: return *values[current.left] - *values[current.right];
+        case Operation::Inverse: return inverse(*values[current.left]);
+        default: return transpose(*values[current.left]);
+        }
+    }
+
+private:
+    /// @brief Serializes changes and recomputations.
+    mutable ::std::mutex _mutex;
+    /// @brief The nodes, in topological order.
+    ::std::vector<Node> _nodes;
+    /// @brief The latest value of each source, by node.
+    ::std::vector<Matrix4x4> _sourceValues;
+    /// @brief The dirty nodes.
+    ::std::vector<NodeId> _dirty;
+    /// @brief The published values.
+    ::std::shared_ptr<const Snapshot::State> _state;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
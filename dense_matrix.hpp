@@ -0,0 +1,255 @@
+/*
+
+File: dense_matrix.hpp
+Author: Aldhinn Espinas
+Description: This file contains the dynamic-size dense matrix declarations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(DENSE_MATRIX_HEADER_FILE)
+#define DENSE_MATRIX_HEADER_FILE
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "parallel.hpp"
+
+/// @brief A description of a dynamic-size matrix containing plain values in row-major order.
+/// Used for large matrices and for snapshots of the concurrent large matrix types.
+class DenseMatrix final {
+public:
+    /// @brief Construct a matrix filled with a value.
+    /// @param rows The number of rows.
+    /// @param cols The number of columns.
+    /// @param value The value of every element.
+    inline DenseMatrix(::std::size_t rows = 0, ::std::size_t cols = 0, double value = 0.0) :
+    _rows(rows), _cols(cols), _data(rows * cols, value) {}
+
+    /// @brief Construct a matrix from row vectors.
+    /// @param values The row vectors, which all need to have the same size.
+    inline DenseMatrix(const ::std::initializer_list<::std::initializer_list<double>>& values) :
+    _rows(values.size()), _cols(values.size() == 0 ? 0 : values.begin()->size()) {
+        _data.reserve(_rows * _cols);
+        for (const ::std::initializer_list<double>& rowVector : values) {
+            if (rowVector.size() != _cols) {
+                throw ::std::invalid_argument("Every row vector needs to have the same number of elements.");
+            }
+            _data.insert(_data.end(), rowVector.begin(), rowVector.end());
+        }
+    }
+
+    /// @brief The identity matrix.
+    /// @param size The number of rows and columns.
+    inline static DenseMatrix identity(::std::size_t size) {
+        DenseMatrix result(size, size);
+        for (::std::size_t i = 0; i < size; i++) result._data[i * size + i] = 1.0;
+        return result;
+    }
+
+    /// @brief The number of rows.
+    inline ::std::size_t rows() const { return _rows; }
+    /// @brief The number of columns.
+    inline ::std::size_t cols() const { return _cols; }
+    /// @brief The row-major elements.
+    inline double* data() { return _data.data(); }
+    /// @brief The row-major elements.
+    inline const double* data() const { return _data.data(); }
+
+    /// @brief Get the reference to the element in the specified index.
+    /// @param rowIndex The row-index of the element to be accessed.
+    /// @param colIndex The column-index of the element to be accessed.
+    /// @return The reference at the specified index.
+    inline double& operator()(::std::size_t rowIndex, ::std::size_t colIndex) {
+        if (rowIndex >= _rows || colIndex >= _cols) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return _data[rowIndex * _cols + colIndex];
+    }
+    /// @brief Get the value of the element in the specified index.
+    /// @param rowIndex The row-index of the element to be accessed.
+    /// @param colIndex The column-index of the element to be accessed.
+    /// @return The value at the specified index.
+    inline double operator()(::std::size_t rowIndex, ::std::size_t colIndex) const {
+        if (rowIndex >= _rows || colIndex >= _cols) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return _data[rowIndex * _cols + colIndex];
+    }
+
+private:
+    /// @brief The number of rows.
+    ::std::size_t _rows;
+    /// @brief The number of columns.
+    ::std::size_t _cols;
+    /// @brief The row-major container for the matrix components.
+    ::std::vector<double> _data;
+};
+
+/// @brief The equality comparator.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The equality value.
+inline bool operator==(const DenseMatrix& leftMat, const DenseMatrix& rightMat) {
+    if (leftMat.rows() != rightMat.rows() || leftMat.cols() != rightMat.cols()) return false;
+    const double* left = leftMat.data();
+    const double* right = rightMat.data();
+    for (::std::size_t i = 0; i < leftMat.rows() * leftMat.cols(); i++) {
+        if (left[i] != right[i]) return false;
+    }
+    return true;
+}
+
+/// @brief The inequality comparator.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The inequality value.
+inline bool operator!=(const DenseMatrix& leftMat, const DenseMatrix& rightMat) {
+    return !(leftMat == rightMat);
+}
+
+/// @brief The 4x8 register-blocked kernel of `gemmAccumulate`, `C += A B`.
+inline void gemmMicroKernel4x8(::std::size_t depth, const double* a, ::std::size_t lda,
+    const double* b, ::std::size_t ldb, double* c, ::std::size_t ldc) {
+#if defined(__AVX__)
+    __m256d c00 = _mm256_loadu_pd(c), c01 = _mm256_loadu_pd(c + 4);
+    __m256d c10 = _mm256_loadu_pd(c + ldc), c11 = _mm256_loadu_pd(c + ldc + 4);
+    __m256d c20 = _mm256_loadu_pd(c + 2 * ldc), c21 = _mm256_loadu_pd(c + 2 * ldc + 4);
+    __m256d c30 = _mm256_loadu_pd(c + 3 * ldc), c31 = _mm256_loadu_pd(c + 3 * ldc + 4);
+    for (::std::size_t p = 0; p < depth; p++) {
+        __m256d b0 = _mm256_loadu_pd(b + p * ldb);
+        __m256d b1 = _mm256_loadu_pd(b + p * ldb + 4);
+        __m256d a0 = _mm256_broadcast_sd(a + p);
+        c00 = _mm256_add_pd(c00, _mm256_mul_pd(a0, b0));
+        c01 = _mm256_add_pd(c01, _mm256_mul_pd(a0, b1));
+        __m256d a1 = _mm256_broadcast_sd(a + lda + p);
+        c10 = _mm256_add_pd(c10, _mm256_mul_pd(a1, b0));
+        c11 = _mm256_add_pd(c11, _mm256_mul_pd(a1, b1));
+        __m256d a2 = _mm256_broadcast_sd(a + 2 * lda + p);
+        c20 = _mm256_add_pd(c20, _mm256_mul_pd(a2, b0));
+        c21 = _mm256_add_pd(c21, _mm256_mul_pd(a2, b1));
+        __m256d a3 = _mm256_broadcast_sd(a + 3 * lda + p);
+        c30 = _mm256_add_pd(c30, _mm256_mul_pd(a3, b0));
+        c31 = _mm256_add_pd(c31, _mm256_mul_pd(a3, b1));
+    }
+    _mm256_storeu_pd(c, c00); _mm256_storeu_pd(c + 4, c01);
+    _mm256_storeu_pd(c + ldc, c10); _mm256_storeu_pd(c + ldc + 4, c11);
+    _mm256_storeu_pd(c + 2 * ldc, c20); _mm256_storeu_pd(c + 2 * ldc + 4, c21);
+    _mm256_storeu_pd(c + 3 * ldc, c30); _mm256_storeu_pd(c + 3 * ldc + 4, c31);
+#else
+    double sums[4][8];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++) sums[i][j] = c[i * ldc + j];
+    }
+    for (::std::size_t p = 0; p < depth; p++) {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 8; j++) sums[i][j] += a[i * lda + p] * b[p * ldb + j];
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 8; j++) c[i * ldc + j] = sums[i][j];
+    }
+#endif
+}
+
+/// @brief The cache-blocked product of row-major blocks, `C += A B`.
+///
+/// Every element accumulates its products in increasing order of the inner index, so
+/// the result is the same as that of the textbook triple loop.
+/// @param rows The number of rows of A and C.
+/// @param cols The number of columns of B and C.
+/// @param depth The number of columns of A and rows of B.
+/// @param a The first element of A.
+/// @param lda The distance between the rows of A.
+/// @param b The first element of B.
+/// @param ldb The distance between the rows of B.
+/// @param c The first element of C.
+/// @param ldc The distance between the rows of C.
+inline void gemmAccumulate(::std::size_t rows, ::std::size_t cols, ::std::size_t depth,
+    const double* a, ::std::size_t lda, const double* b, ::std::size_t ldb, double* c, ::std::size_t ldc) {
+    // Keep a slice of B in the L2 cache while it is swept by the rows of A.
+    const ::std::size_t DEPTH_BLOCK = 256;
+    const ::std::size_t COL_BLOCK = 256;
+    for (::std::size_t p0 = 0; p0 < depth; p0 += DEPTH_BLOCK) {
+        ::std::size_t pEnd = ::std::min(depth, p0 + DEPTH_BLOCK);
+        for (::std::size_t j0 = 0; j0 < cols; j0 += COL_BLOCK) {
+            ::std::size_t jEnd = ::std::min(cols, j0 + COL_BLOCK);
+            ::std::size_t i = 0;
+            for (; i + 4 <= rows; i += 4) {
+                ::std::size_t j = j0;
+                for (; j + 8 <= jEnd; j += 8) {
+                    gemmMicroKernel4x8(pEnd - p0, a + i * lda + p0, lda, b + p0 * ldb + j, ldb, c + i * ldc + j, ldc);
+                }
+                // Columns left over from the register blocks.
+                for (::std::size_t row = i; row < i + 4; row++) {
+                    for (::std::size_t col = j; col < jEnd; col++) {
+                        double sum = c[row * ldc + col];
+                        for (::std::size_t p = p0; p < pEnd; p++) sum += a[row * lda + p] * b[p * ldb + col];
+                        c[row * ldc + col] = sum;
+                    }
+                }
+            }
+            // Rows left over from the register blocks.
+            for (; i < rows; i++) {
+                for (::std::size_t col = j0; col < jEnd; col++) {
+                    double sum = c[i * ldc + col];
+                    for (::std::size_t p = p0; p < pEnd; p++) sum += a[i * lda + p] * b[p * ldb + col];
+                    c[i * ldc + col] = sum;
+                }
+            }
+        }
+    }
+}
+
+/// @brief The dot product operation.
+/// Rows of the product are split across threads.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The dot product.
+inline DenseMatrix operator*(const DenseMatrix& leftMat, const DenseMatrix& rightMat) {
+    if (leftMat.cols() != rightMat.rows()) {
+        throw ::std::invalid_argument("The number of columns of the left matrix does not match the rows of the right.");
+    }
+    DenseMatrix dotProductMatrix(leftMat.rows(), rightMat.cols());
+    parallelFor(0, (leftMat.rows() + 3) / 4, 16, [&](::std::size_t blockBegin, ::std::size_t blockEnd) {
+        ::std::size_t rowBegin = blockBegin * 4;
+        ::std::size_t rowEnd = ::std::min(leftMat.rows(), blockEnd * 4);
+        gemmAccumulate(rowEnd - rowBegin, rightMat.cols(), leftMat.cols(),
+            leftMat.data() + rowBegin * leftMat.cols(), leftMat.cols(),
+            rightMat.data(), rightMat.cols(),
+            dotProductMatrix.data() + rowBegin * rightMat.cols(), rightMat.cols());
+    });
+    return dotProductMatrix;
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,280 @@
+/*
+
+File: factorization.hpp
+Author: Aldhinn Espinas
+Description: This file contains the blocked LU and Cholesky factorizations of dense matrices.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(FACTORIZATION_HEADER_FILE)
+#define FACTORIZATION_HEADER_FILE
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "dense_matrix.hpp"
+#include "paged_matrix.hpp"
+#include "parallel.hpp"
+
+/// @brief The width of the panels of the blocked factorizations, and the height of
+/// the row tiles their trailing updates are split into.
+constexpr ::std::size_t FACTORIZATION_BLOCK = 64;
+
+/// @brief The trailing update of a blocked factorization, `C -= L R`, split into row tiles
+/// that run in parallel. Each tile only depends on the panel factored before it.
+/// @param rows The rows of L and C.
+/// @param cols The columns of R and C, or the diagonal of C the update stops at if `isLower`.
+/// @param depth The columns of L and rows of R.
+/// @param negatedLeft The negated L, row-major and packed.
+/// @param right The first element of R.
+/// @param ldr The distance between the rows of R.
+/// @param c The first element of C.
+/// @param ldc The distance between the rows of C.
+/// @param isLower Whether only the tiles on and below the diagonal of C are updated.
+inline void trailingUpdate(::std::size_t rows, ::std::size_t cols, ::std::size_t depth, const double* negatedLeft,
+    const double* right, ::std::size_t ldr, double* c, ::std::size_t ldc, bool isLower) {
+    ::std::size_t tiles = (rows + FACTORIZATION_BLOCK - 1) / FACTORIZATION_BLOCK;
+    parallelFor(0, tiles, 1, [&](::std::size_t tileBegin, ::std::size_t tileEnd) {
+        for (::std::size_t tile = tileBegin; tile < tileEnd; tile++) {
+            ::std::size_t rowBegin = tile * FACTORIZATION_BLOCK;
+            ::std::size_t rowEnd = ::std::min(rows, rowBegin + FACTORIZATION_BLOCK);
+            gemmAccumulate(rowEnd - rowBegin, isLower ? rowEnd : cols, depth,
+                negatedLeft + rowBegin * depth, depth, right, ldr, c + rowBegin * ldc, ldc);
+        }
+    });
+}
+
+/// @brief The LU factorization with partial pivoting, `P A = L U`.
+struct LuFactorization {
+    /// @brief L below the diagonal, with an implicit unit diagonal, and U on and above it.
+    DenseMatrix lu;
+    /// @brief Row `i` was swapped with row `pivots[i]`, in increasing order of `i`.
+    ::std::vector<::std::size_t> pivots;
+
+    /// @brief Solve `A x = b`.
+    /// @param b The right-hand side.
+    /// @return The solution.
+    inline ::std::vector<double> solve(::std::vector<double> b) const {
+        const ::std::size_t size = lu.rows();
+        if (b.size() != size) {
+            throw ::std::invalid_argument("The size of the right-hand side does not match the matrix.");
+        }
+        for (::std::size_t i = 0; i < size; i++) ::std::swap(b[i], b[pivots[i]]);
+        for (::std::size_t i = 0; i < size; i++) {
+            double sum = b[i];
+            for (::std::size_t j = 0; j < i; j++) sum -= lu(i, j) * b[j];
+            b[i] = sum;
+        }
+        for (::std::size_t i = size; i-- > 0;) {
+            double sum = b[i];
+            for (::std::size_t j = i + 1; j < size; j++) sum -= lu(i, j) * b[j];
+            b[i] = sum / lu(i, i);
+        }
+        return b;
+    }
+    /// @brief The determinant of A.
+    inline double determinant() const {
+        double result = 1.0;
+        for (::std::size_t i = 0; i < lu.rows(); i++) {
+            result *= lu(i, i);
+            if (pivots[i] != i) result = -result;
+        }
+        return result;
+    }
+};
+
+/// @brief Factor a square matrix into `P A = L U`, with partial pivoting.
+///
+/// Right-looking and blocked: each panel of columns is factored, the rows of U right
+/// of it are solved for, and the trailing matrix is updated with the GEMM kernel, one
+/// row tile per task.
+/// @param mat The matrix.
+/// @return The factorization.
+inline LuFactorization factorLu(DenseMatrix mat) {
+    if (mat.rows() != mat.cols()) {
+        throw ::std::invalid_argument("The matrix is not square.");
+    }
+    const ::std::size_t size = mat.rows();
+    double* a = mat.data();
+    ::std::vector<::std::size_t> pivots(size);
+    ::std::vector<double> negatedPanel;
+
+    for (::std::size_t panelBegin = 0; panelBegin < size; panelBegin += FACTORIZATION_BLOCK) {
+        const ::std::size_t panelEnd = ::std::min(size, panelBegin + FACTORIZATION_BLOCK);
+        const ::std::size_t width = panelEnd - panelBegin;
+
+        // The panel, column by column.
+        for (::std::size_t j = panelBegin; j < panelEnd; j++) {
+            ::std::size_t pivot = j;
+            for (::std::size_t i = j + 1; i < size; i++) {
+                if (::std::fabs(a[i * size + j]) > ::std::fabs(a[pivot * size + j])) pivot = i;
+            }
+            if (a[pivot * size + j] == 0.0) {
+                throw ::std::domain_error("The matrix is singular.");
+            }
+            pivots[j] = pivot;
+            if (pivot != j) ::std::swap_ranges(a + j * size, a + (j + 1) * size, a + pivot * size);
+            for (::std::size_t i = j + 1; i < size; i++) {
+                double factor = a[i * size + j] /= a[j * size + j];
+                for (::std::size_t col = j + 1; col < panelEnd; col++) a[i * size + col] -= factor * a[j * size + col];
+            }
+        }
+        if (panelEnd == size) break;
+
+        // The rows of U right of the panel, U12 = L11^-1 A12, in column tiles.
+        parallelFor(panelEnd, size, FACTORIZATION_BLOCK, [&](::std::size_t colBegin, ::std::size_t colEnd) {
+            for (::std::size_t i = panelBegin + 1; i < panelEnd; i++) {
+                for (::std::size_t j = panelBegin; j < i; j++) {
+                    double factor = a[i * size + j];
+                    for (::std::size_t col = colBegin; col < colEnd; col++) a[i * size + col] -= factor * a[j * size + col];
+                }
+            }
+        });
+
+        // A22 -= L21 U12
+        const ::std::size_t trailing = size - panelEnd;
+        negatedPanel.resize(trailing * width);
+        for (::std::size_t i = 0; i < trailing; i++) {
+            for (::std::size_t j = 0; j < width; j++) {
+                negatedPanel[i * width + j] = -a[(panelEnd + i) * size + panelBegin + j];
+            }
+        }
+        trailingUpdate(trailing, trailing, width, negatedPanel.data(), a + panelBegin * size + panelEnd, size,
+            a + panelEnd * size + panelEnd, size, false);
+    }
+    return {::std::move(mat), ::std::move(pivots)};
+}
+/// @brief Factor a consistent snapshot of a paged matrix into `P A = L U`.
+/// @param snapshot The snapshot.
+/// @return The factorization.
+inline LuFactorization factorLu(const PagedMatrix::Snapshot& snapshot) {
+    return factorLu(snapshot.toDense());
+}
+
+/// @brief The Cholesky factorization, `A = L L^T`.
+struct CholeskyFactorization {
+    /// @brief L, with zeros above the diagonal.
+    DenseMatrix lower;
+
+    /// @brief Solve `A x = b`.
+    /// @param b The right-hand side.
+    /// @return The solution.
+    inline ::std::vector<double> solve(::std::vector<double> b) const {
+        const ::std::size_t size = lower.rows();
+        if (b.size() != size) {
+            throw ::std::invalid_argument("The size of the right-hand side does not match the matrix.");
+        }
+        for (::std::size_t i = 0; i < size; i++) {
+            double sum = b[i];
+            for (::std::size_t j = 0; j < i; j++) sum -= lower(i, j) * b[j];
+            b[i] = sum / lower(i, i);
+        }
+        for (::std::size_t i = size; i-- > 0;) {
+            double sum = b[i];
+            for (::std::size_t j = i + 1; j < size; j++) sum -= lower(j, i) * b[j];
+            b[i] = sum / lower(i, i);
+        }
+        return b;
+    }
+};
+
+/// @brief Factor a symmetric positive definite matrix into `A = L L^T`.
+///
+/// Right-looking and blocked like `factorLu`. Only the lower triangle of the matrix is read.
+/// @param mat The matrix.
+/// @return The factorization.
+inline CholeskyFactorization factorCholesky(DenseMatrix mat) {
+    if (mat.rows() != mat.cols()) {
+        throw ::std::invalid_argument("The matrix is not square.");
+    }
+    const ::std::size_t size = mat.rows();
+    double* a = mat.data();
+    ::std::vector<double> negatedPanel, transposedPanel;
+
+    for (::std::size_t panelBegin = 0; panelBegin < size; panelBegin += FACTORIZATION_BLOCK) {
+        const ::std::size_t panelEnd = ::std::min(size, panelBegin + FACTORIZATION_BLOCK);
+        const ::std::size_t width = panelEnd - panelBegin;
+
+        // The diagonal block.
+        for (::std::size_t j = panelBegin; j < panelEnd; j++) {
+            double diagonal = a[j * size + j];
+            for (::std::size_t p = panelBegin; p < j; p++) diagonal -= a[j * size + p] * a[j * size + p];
+            // Also rejects NaN.
+            if (!(diagonal > 0.0)) {
+                throw ::std::domain_error("The matrix is not positive definite.");
+            }
+            diagonal = ::std::sqrt(diagonal);
+            a[j * size + j] = diagonal;
+            for (::std::size_t i = j + 1; i < panelEnd; i++) {
+                double sum = a[i * size + j];
+                for (::std::size_t p = panelBegin; p < j; p++) sum -= a[i * size + p] * a[j * size + p];
+                a[i * size + j] = sum / diagonal;
+            }
+        }
+        if (panelEnd == size) break;
+
+        // The panel below it, L21 = A21 L11^-T, in row tiles.
+        parallelFor(panelEnd, size, FACTORIZATION_BLOCK, [&](::std::size_t rowBegin, ::std::size_t rowEnd) {
+            for (::std::size_t i = rowBegin; i < rowEnd; i++) {
+                for (::std::size_t j = panelBegin; j < panelEnd; j++) {
+                    double sum = a[i * size + j];
+                    for (::std::size_t p = panelBegin; p < j; p++) sum -= a[i * size + p] * a[j * size + p];
+                    a[i * size + j] = sum / a[j * size + j];
+                }
+            }
+        });
+
+        // A22 -= L21 L21^T, on and below the diagonal.
+        const ::std::size_t trailing = size - panelEnd;
+        negatedPanel.resize(trailing * width);
+        transposedPanel.resize(width * trailing);
+        for (::std::size_t i = 0; i < trailing; i++) {
+            for (::std::size_t j = 0; j < width; j++) {
+                double value = a[(panelEnd + i) * size + panelBegin + j];
+                negatedPanel[i * width + j] = -value;
+                transposedPanel[j * trailing + i] = value;
+            }
+        }
+        trailingUpdate(trailing, trailing, width, negatedPanel.data(), transposedPanel.data(), trailing,
+            a + panelEnd * size + panelEnd, size, true);
+    }
+
+    for (::std::size_t i = 0; i < size; i++) ::std::fill(a + i * size + i + 1, a + (i + 1) * size, 0.0);
+    return {::std::move(mat)};
+}
+/// @brief Factor a consistent snapshot of a paged matrix into `A = L L^T`.
+/// @param snapshot The snapshot.
+/// @return The factorization.
+inline CholeskyFactorization factorCholesky(const PagedMatrix::Snapshot& snapshot) {
+    return factorCholesky(snapshot.toDense());
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
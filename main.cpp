@@ -30,16 +30,66 @@ SOFTWARE.
 */
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
 #include <vector>
 #include <random>
 #include <time.h>
 #include <thread>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <mutex>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "matrix.hpp"
+#include "matrix_chain.hpp"
+#include "node_replication.hpp"
+#include "checksummed_matrix.hpp"
+#include "coalescing.hpp"
+#include "dataflow.hpp"
+#include "factorization.hpp"
+#include "out_of_core.hpp"
+#include "sparse_matrix.hpp"
+#include "timeline.hpp"
+#include "strassen.hpp"
+#include "paged_matrix.hpp"
+#include "realtime.hpp"
+#include "recorder.hpp"
+#include "registry.hpp"
+#include "shard.hpp"
+#include "shared_log.hpp"
+#include "transform.hpp"
+#include "wal.hpp"
+#include "workloads.hpp"
+
+/// @brief The number of heap allocations made by the calling thread.
+thread_local unsigned long long threadAllocations = 0;
+
+// Replaced to count allocations, the other forms of `new` and `delete` forward to these.
+// Kept out of line, or the compiler pairs the inlined `malloc` and `free` with the
+// `delete` and `new` of the caller.
+[[gnu::noinline]] void* operator new(::std::size_t size) {
+    threadAllocations++;
+    if (void* data = ::std::malloc(size == 0 ? 1 : size)) return data;
+    throw ::std::bad_alloc();
+}
+[[gnu::noinline]] void* operator new(::std::size_t size, ::std::align_val_t alignment) {
+    threadAllocations++;
+    void* data = nullptr;
+    if (::posix_memalign(&data, ::std::max(static_cast<::std::size_t>(alignment), sizeof(void*)),
+        size == 0 ? 1 : size) == 0) return data;
+    throw ::std::bad_alloc();
+}
+[[gnu::noinline]] void operator delete(void* data) noexcept { ::std::free(data); }
+[[gnu::noinline]] void operator delete(void* data, ::std::align_val_t) noexcept { ::std::free(data); }
+[[gnu::noinline]] void operator delete(void* data, ::std::size_t) noexcept { ::std::free(data); }
+[[gnu::noinline]] void operator delete(void* data, ::std::size_t, ::std::align_val_t) noexcept { ::std::free(data); }
 
 /// @brief The test suite fixture class for this test.
 class TestSuiteFixture : public ::testing::Test {
@@ -223,4 +273,1491 @@ TEST_F(TestSuiteFixture, verifyEqualityImplementationCorrectness) {
     GTEST_ASSERT_EQ(_mat1, _mat1);
     GTEST_ASSERT_EQ(_mat2, _mat2);
     GTEST_ASSERT_NE(_mat1, _mat2);
+}
+
+TEST(ConcurrentSparseMatrixTest, verifyMultiplicationImplementationCorrectness) {
+    // [ 1.0  0.0  2.0 ]
+    // [ 0.0  0.0  0.0 ]
+    // [ 0.0  3.0  4.0 ]
+    ConcurrentSparseMatrix matrix(3, 3, {
+        {2, 2, 4.0}, {0, 0, 1.0}, {2, 1, 3.0}, {0, 2, 9.0}, {0, 2, 2.0}
+    });
+    GTEST_ASSERT_EQ(matrix.nonZeroCount(), 4u);
+    GTEST_ASSERT_EQ(matrix.get(0, 2), 2.0);
+    GTEST_ASSERT_EQ(matrix.get(1, 1), 0.0);
+
+    ::std::vector<double> product = matrix.multiply({1.0, 2.0, 3.0});
+    GTEST_ASSERT_EQ(product, (::std::vector<double>{7.0, 0.0, 18.0}));
+
+    // Two right hand-side vectors at once, [1 2 3] and [1 1 1].
+    double vectors[6] = {1.0, 1.0, 2.0, 1.0, 3.0, 1.0};
+    double products[6];
+    matrix.multiply(vectors, 2, products);
+    GTEST_ASSERT_EQ(::std::vector<double>(products, products + 6),
+        (::std::vector<double>{7.0, 3.0, 0.0, 0.0, 18.0, 7.0}));
+
+    EXPECT_THROW(matrix.set(1, 1, 1.0), ::std::out_of_range);
+    matrix.restructure({{1, 1, 5.0}}, {{0, 0}});
+    GTEST_ASSERT_EQ(matrix.multiply({1.0, 2.0, 3.0}), (::std::vector<double>{6.0, 10.0, 18.0}));
+}
+
+TEST(ConcurrentSparseMatrixTest, runUpdatesWithConsistentSnapshots) {
+    // Every row holds two elements that always sum up to 10.
+    const ConcurrentSparseMatrix::Index SIZE = 256;
+    ::std::vector<ConcurrentSparseMatrix::Entry> entries;
+    for (ConcurrentSparseMatrix::Index row = 0; row < SIZE; row++) {
+        entries.push_back({row, row, 5.0});
+        entries.push_back({row, (row + 1) % SIZE, 5.0});
+    }
+    ConcurrentSparseMatrix matrix(SIZE, SIZE, entries);
+
+    ::std::atomic<bool> shouldContinue(true);
+    // Two value writers on few rows, so that their updates of the same row overlap.
+    auto writeValues = [&]() {
+        while (shouldContinue.load()) {
+            ConcurrentSparseMatrix::Index row = static_cast<ConcurrentSparseMatrix::Index>(::std::rand()) % 4;
+            double value = static_cast<double>(::std::rand() % 10);
+            matrix.update({{row, row, value}, {row, (row + 1) % SIZE, 10.0 - value}});
+        }
+    };
+    ::std::thread valueWriter(writeValues);
+    ::std::thread otherValueWriter(writeValues);
+    ::std::thread structureWriter([&]() {
+        while (shouldContinue.load()) {
+            // Elements that are zero do not change the row sums.
+            ConcurrentSparseMatrix::Index row = static_cast<ConcurrentSparseMatrix::Index>(::std::rand()) % SIZE;
+            matrix.restructure({{row, (row + 2) % SIZE, 0.0}});
+            matrix.restructure({}, {{row, (row + 2) % SIZE}});
+        }
+    });
+
+    const ::std::vector<double> ones(SIZE, 1.0);
+    unsigned long inconsistentProducts = 0;
+    for (int i = 0; i < 2000; i++) {
+        for (double rowSum : matrix.multiply(ones)) {
+            if (rowSum != 10.0) inconsistentProducts++;
+        }
+    }
+    shouldContinue.store(false);
+    valueWriter.join();
+    otherValueWriter.join();
+    structureWriter.join();
+
+    GTEST_ASSERT_EQ(inconsistentProducts, 0ul);
+}
+
+TEST(TrsTransformTest, verifyConversionImplementationCorrectness) {
+    // A rotation of 90 degrees about z, scaled by 2 and translated by [1 2 3].
+    Matrix4x4 matrix = {{
+        0.0, -2.0, 0.0, 1.0,
+        2.0, 0.0, 0.0, 2.0,
+        0.0, 0.0, 2.0, 3.0,
+        0.0, 0.0, 0.0, 1.0
+    }};
+    TrsTransform transform = TrsTransform::fromMatrix(AtomicMatrix4x4(matrix));
+    GTEST_ASSERT_EQ(transform.scale, 2.0f);
+    Matrix4x4 roundTrip = transform.toMatrix4x4();
+    for (int i = 0; i < 16; i++) EXPECT_NEAR(roundTrip.data[i], matrix.data[i], 1e-6);
+
+    float point[3] = {1.0f, 0.0f, 0.0f};
+    float transformed[3];
+    transform.transformPoint(point, transformed);
+    EXPECT_NEAR(transformed[0], 1.0f, 1e-6f);
+    EXPECT_NEAR(transformed[1], 4.0f, 1e-6f);
+    EXPECT_NEAR(transformed[2], 3.0f, 1e-6f);
+
+    // Shear and projective matrices have no TRS form.
+    Matrix4x4 shear = Matrix4x4::identity();
+    shear(0, 1) = 0.5;
+    EXPECT_THROW(TrsTransform::fromMatrix(shear), ::std::domain_error);
+    Matrix4x4 projective = Matrix4x4::identity();
+    projective(3, 0) = 1.0;
+    TrsTransform untouched = TrsTransform::identity();
+    GTEST_ASSERT_FALSE(TrsTransform::tryFromMatrix(projective, untouched));
+}
+
+TEST(TrsTransformTest, verifyCompositionImplementationCorrectness) {
+    const double HALF_SQRT2 = ::std::sqrt(0.5);
+    // A rotation of 90 degrees about x, scaled by 3 and translated by [0 1 0].
+    TrsTransform left = {{static_cast<float>(HALF_SQRT2), 0.0f, 0.0f, static_cast<float>(HALF_SQRT2)}, {0.0f, 1.0f, 0.0f}, 3.0f};
+    // A rotation of 90 degrees about z, scaled by 0.5 and translated by [4 0 -2].
+    TrsTransform right = {{0.0f, 0.0f, static_cast<float>(HALF_SQRT2), static_cast<float>(HALF_SQRT2)}, {4.0f, 0.0f, -2.0f}, 0.5f};
+
+    Matrix4x4 expected = (left.toMatrix() * right.toMatrix()).snapshot();
+    Matrix4x4 composed = (left * right).toMatrix4x4();
+    for (int i = 0; i < 16; i++) EXPECT_NEAR(composed.data[i], expected.data[i], 1e-5);
+
+    Matrix4x4 identity = (left * left.inverse()).toMatrix4x4();
+    for (int i = 0; i < 16; i++) EXPECT_NEAR(identity.data[i], Matrix4x4::identity().data[i], 1e-5);
+
+    TrsTransform stored = left * right;
+    AtomicTrsTransform published;
+    published.store(stored);
+    TrsTransform loaded = published.load();
+    GTEST_ASSERT_EQ(::std::memcmp(&loaded, &stored, sizeof(TrsTransform)), 0);
+    GTEST_ASSERT_EQ(loaded.scale, 1.5f);
+}
+
+TEST(TrsTransformTest, runConcurrentWritersAndReader) {
+    const int CYCLES = 200000;
+    const double HALF_SQRT2 = ::std::sqrt(0.5);
+    const TrsTransform transforms[2] = {
+        {{static_cast<float>(HALF_SQRT2), 0.0f, 0.0f, static_cast<float>(HALF_SQRT2)}, {0.0f, 1.0f, 0.0f}, 3.0f},
+        {{0.0f, 0.0f, static_cast<float>(HALF_SQRT2), static_cast<float>(HALF_SQRT2)}, {4.0f, 0.0f, -2.0f}, 0.5f}
+    };
+    AtomicTrsTransform published(transforms[0]);
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::vector<::std::thread> writers;
+    for (int writer = 0; writer < 2; writer++) {
+        writers.emplace_back([&, writer]() {
+            while (shouldContinue.load(::std::memory_order_relaxed)) published.store(transforms[writer]);
+        });
+    }
+    // Every transform read has to be one of the two written, never a mix of both.
+    int mixed = 0;
+    for (int i = 0; i < CYCLES; i++) {
+        TrsTransform loaded = published.load();
+        if (::std::memcmp(&loaded, &transforms[0], sizeof(TrsTransform)) != 0 &&
+            ::std::memcmp(&loaded, &transforms[1], sizeof(TrsTransform)) != 0) mixed++;
+    }
+    shouldContinue.store(false);
+    for (::std::thread& writer : writers) writer.join();
+    GTEST_ASSERT_EQ(mixed, 0);
+}
+
+TEST_F(TestSuiteFixture, verifyElementwiseImplementationCorrectness) {
+    Matrix4x4 mat1 = _mat1.snapshot();
+    Matrix4x4 mat2 = _mat2.snapshot();
+    for (int i = 0; i < 16; i++) {
+        GTEST_ASSERT_EQ((mat1 + mat2).data[i], mat1.data[i] + mat2.data[i]);
+        GTEST_ASSERT_EQ((mat1 - mat2).data[i], mat1.data[i] - mat2.data[i]);
+        GTEST_ASSERT_EQ(hadamard(mat1, mat2).data[i], mat1.data[i] * mat2.data[i]);
+        GTEST_ASSERT_EQ((mat1 * 2.5).data[i], mat1.data[i] * 2.5);
+        GTEST_ASSERT_EQ(lerp(mat1, mat2, 0.25).data[i], mat1.data[i] + 0.25 * (mat2.data[i] - mat1.data[i]));
+    }
+    GTEST_ASSERT_EQ(lerp(mat1, mat2, 0.0), mat1);
+    GTEST_ASSERT_EQ(lerp(mat1, mat2, 1.0), mat2);
+
+    // The squares of the elements of _mat1 sum up to 16.
+    GTEST_ASSERT_EQ(trace(mat1), 2.0);
+    GTEST_ASSERT_EQ(frobeniusNorm(mat1), 4.0);
+    GTEST_ASSERT_EQ(maxAbs(-1.0 * mat2), 3.0);
+
+    Matrix4x4 lefts[3] = {mat1, mat2, mat1};
+    Matrix4x4 rights[3] = {mat2, mat1, mat1};
+    Matrix4x4 sums[3];
+    elementwiseBatch(lefts, rights, sums, 3, ElementwiseSum());
+    for (int i = 0; i < 3; i++) GTEST_ASSERT_EQ(sums[i], lefts[i] + rights[i]);
+    scaleBatch(sums, 0.5, sums, 3);
+    GTEST_ASSERT_EQ(sums[2], mat1);
+
+    double traces[3];
+    traceBatch(lefts, traces, 3);
+    GTEST_ASSERT_EQ(traces[1], 7.0);
+    double norms[3];
+    maxAbsBatch(rights, norms, 3);
+    GTEST_ASSERT_EQ(norms[0], 3.0);
+    frobeniusNormBatch(rights, norms, 3);
+    GTEST_ASSERT_EQ(norms[2], 4.0);
+}
+
+TEST_F(TestSuiteFixture, verifyPowerImplementationCorrectness) {
+    Matrix4x4 mat1 = _mat1.snapshot();
+    GTEST_ASSERT_EQ(mat1 * _mat2.snapshot(), (_mat1 * _mat2).snapshot());
+
+    GTEST_ASSERT_EQ(power(mat1, 0), Matrix4x4::identity());
+    Matrix4x4 repeated = mat1;
+    for (int i = 1; i < 7; i++) repeated = repeated * mat1;
+    GTEST_ASSERT_EQ(power(mat1, 7), repeated);
+
+    Matrix4x4 bases[2] = {mat1, _mat2.snapshot()};
+    unsigned long long exponents[2] = {7, 1};
+    Matrix4x4 powers[2];
+    powerBatch(bases, exponents, powers, 2);
+    GTEST_ASSERT_EQ(powers[0], repeated);
+    GTEST_ASSERT_EQ(powers[1], bases[1]);
+
+    // A two-state chain on the first two states with the stationary distribution
+    // [2/3 1/3], next to a two-state chain that stays put.
+    Matrix4x4 transition = {{
+        0.75, 0.25, 0.0, 0.0,
+        0.5, 0.5, 0.0, 0.0,
+        0.0, 0.0, 1.0, 0.0,
+        0.0, 0.0, 0.0, 1.0
+    }};
+    Matrix4x4 limit = powerStochastic(transition, 1000000000000ULL);
+    EXPECT_NEAR(limit(0, 0), 2.0 / 3.0, 1e-12);
+    EXPECT_NEAR(limit(1, 1), 1.0 / 3.0, 1e-12);
+    GTEST_ASSERT_EQ(limit(2, 2), 1.0);
+    Matrix4x4 exact = power(transition, 5);
+    GTEST_ASSERT_EQ(powerStochastic(transition, 5), exact);
+    EXPECT_THROW(powerStochastic(mat1, 2), ::std::invalid_argument);
+}
+
+TEST_F(TestSuiteFixture, verifyFreivaldsImplementationCorrectness) {
+    FreivaldsVerifier verifier(1e-9);
+    GTEST_ASSERT_EQ(verifier.trials(), 30u);
+    Matrix4x4 mat1 = _mat1.snapshot();
+    Matrix4x4 mat2 = _mat2.snapshot();
+    Matrix4x4 product = mat1 * mat2;
+    GTEST_ASSERT_TRUE(verifier.verify(mat1, mat2, product));
+    GTEST_ASSERT_TRUE(verifier.verify(4, mat1.data, mat2.data, product.data));
+
+    // A single wrong element is caught.
+    Matrix4x4 wrongProduct = product;
+    wrongProduct(2, 3) += 1.0;
+    GTEST_ASSERT_FALSE(verifier.verify(mat1, mat2, wrongProduct));
+    GTEST_ASSERT_FALSE(verifier.verify(4, mat1.data, mat2.data, wrongProduct.data));
+
+    // Correct non-integer products pass despite rounding differently.
+    ::std::mt19937_64 random(11);
+    ::std::uniform_real_distribution<double> distribution(-10.0, 10.0);
+    for (int i = 0; i < 1000; i++) {
+        Matrix4x4 left, right;
+        for (int j = 0; j < 16; j++) {
+            left.data[j] = distribution(random);
+            right.data[j] = distribution(random);
+        }
+        GTEST_ASSERT_TRUE(verifier.verify(left, right, left * right));
+        GTEST_ASSERT_TRUE(verifier.verify(4, left.data, right.data, (left * right).data));
+    }
+
+    Matrix4x4 lefts[2] = {mat1, mat1};
+    Matrix4x4 rights[2] = {mat2, mat2};
+    Matrix4x4 products[2] = {wrongProduct, product};
+    bool results[2];
+    GTEST_ASSERT_EQ(verifier.verifyBatch(lefts, rights, products, results, 2), 1u);
+    GTEST_ASSERT_FALSE(results[0]);
+    GTEST_ASSERT_TRUE(results[1]);
+
+    // Agrees with the full recomputation on recorded calculations.
+    runTestVariableModifier();
+    for (int i = 0; i < 10000; i++) {
+        MultiplicationRecorder calculation(_mat1, _mat2, _mat1 * _mat2);
+        GTEST_ASSERT_EQ(calculation.isProbablyCorrect(verifier), calculation.isCorrect());
+    }
+}
+
+TEST_F(TestSuiteFixture, verifyChecksummedMultiplicationCorrectness) {
+    Matrix4x4 mat1 = _mat1.snapshot();
+    Matrix4x4 mat2 = _mat2.snapshot();
+    Matrix4x4 product;
+    GTEST_ASSERT_TRUE(multiplyChecked(mat1, mat2, product));
+    GTEST_ASSERT_EQ(product, mat1 * mat2);
+
+    // A corrupted product is caught.
+    product(1, 2) += 1.0;
+    GTEST_ASSERT_FALSE(checkProduct(mat1, computeChecksums(mat1), mat2, computeChecksums(mat2), product));
+
+    // An operand that does not match its checksums is caught.
+    ChecksummedMatrix4x4 checksummed(mat1);
+    checksummed.store(0, 3, 5.0);
+    Matrix4x4 values;
+    Checksums4x4 sums;
+    GTEST_ASSERT_TRUE(checksummed.snapshot(values, sums));
+    GTEST_ASSERT_TRUE(checkOperand(values, sums));
+    values(0, 3) = 1.0;
+    GTEST_ASSERT_FALSE(checkOperand(values, sums));
+}
+
+TEST_F(TestSuiteFixture, runChecksummedCalculationsWithoutThreadLocks) {
+    // The writer turns the left matrix from one value into the other and back, element
+    // by element in order, so the states it really has are known. Non-integer values
+    // make the writes round, should the checks drift with them.
+    Matrix4x4 values[2];
+    ::std::mt19937_64 random(7);
+    ::std::uniform_real_distribution<double> distribution(-10.0, 10.0);
+    for (Matrix4x4& value : values) {
+        for (double& element : value.data) element = distribution(random);
+    }
+    Matrix4x4 right = _mat2.snapshot();
+    ChecksummedMatrix4x4 mat1(values[0]);
+    ChecksummedMatrix4x4 mat2(right);
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::thread modifier([&]() {
+        for (unsigned int sweep = 1; shouldContinue.load(); sweep++) {
+            for (unsigned int i = 0; i < 16; i++) mat1.store(i / 4, i % 4, values[sweep % 2].data[i]);
+        }
+    });
+    ::std::vector<Matrix4x4> products;
+    for (int from = 0; from < 2; from++) {
+        for (unsigned int written = 0; written <= 16; written++) {
+            Matrix4x4 state = values[from];
+            for (unsigned int i = 0; i < written; i++) state.data[i] = values[from ^ 1].data[i];
+            products.push_back(state * right);
+        }
+    }
+
+    const int CYCLES = 100000;
+    int flaggedCalculations = 0, incorrectCalculations = 0;
+    Matrix4x4 product;
+    for (int i = 0; i < CYCLES; i++) {
+        if (!multiplyChecked(mat1, mat2, product)) {
+            flaggedCalculations++;
+        } else if (::std::find(products.begin(), products.end(), product) == products.end()) {
+            incorrectCalculations++;
+        }
+    }
+    shouldContinue.store(false);
+    modifier.join();
+
+    // Without writers, nothing is flagged, however many writes came before.
+    GTEST_ASSERT_TRUE(multiplyChecked(mat1, mat2, product));
+    GTEST_ASSERT_LT(flaggedCalculations, CYCLES);
+    GTEST_ASSERT_EQ(incorrectCalculations, 0);
+
+    ::std::cout << "Calculations flagged by the checksums = "
+        << (static_cast<double>(flaggedCalculations) * 100.0) / CYCLES << "%.\n";
+}
+
+TEST(PagedMatrixTest, verifySnapshotImplementationCorrectness) {
+    // 2 x 3 tiles, with partial tiles on the edges.
+    PagedMatrix matrix(100, 150);
+    PagedMatrix::Snapshot empty = matrix.snapshot();
+
+    DenseMatrix values(100, 150);
+    for (::std::size_t row = 0; row < 100; row++) {
+        for (::std::size_t col = 0; col < 150; col++) values(row, col) = static_cast<double>(row * 1000 + col);
+    }
+    matrix.store(values);
+    PagedMatrix::Snapshot stored = matrix.snapshot();
+    matrix.update({{99, 149, -1.0}, {0, 0, -2.0}, {0, 0, -3.0}});
+    PagedMatrix::Snapshot updated = matrix.snapshot();
+
+    // Older snapshots keep seeing their own version.
+    GTEST_ASSERT_EQ(empty.toDense(), DenseMatrix(100, 150));
+    GTEST_ASSERT_EQ(stored.toDense(), values);
+    GTEST_ASSERT_EQ(updated.version(), 2u);
+    GTEST_ASSERT_EQ(updated(99, 149), -1.0);
+    GTEST_ASSERT_EQ(updated(0, 0), -3.0);
+    GTEST_ASSERT_EQ(updated(50, 70), 50070.0);
+
+    // Untouched tiles are shared between versions.
+    GTEST_ASSERT_EQ(stored.tile(1, 0), updated.tile(1, 0));
+    GTEST_ASSERT_NE(stored.tile(0, 0), updated.tile(0, 0));
+    EXPECT_THROW(matrix.set(100, 0, 1.0), ::std::out_of_range);
+}
+
+TEST(PagedMatrixTest, runUpdatesWithConsistentSnapshots) {
+    // Deep enough for a directory with more than one level. The writers keep the
+    // sum of the elements at zero.
+    const ::std::size_t SIZE = 600;
+    PagedMatrix matrix(SIZE, SIZE);
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::vector<::std::thread> writers;
+    for (int i = 0; i < 2; i++) {
+        writers.emplace_back([&]() {
+            while (shouldContinue.load()) {
+                ::std::size_t row = static_cast<::std::size_t>(::std::rand()) % SIZE;
+                ::std::size_t col = static_cast<::std::size_t>(::std::rand()) % SIZE;
+                double value = static_cast<double>(::std::rand() % 100);
+                matrix.update({{row, col, value}, {SIZE - 1 - row, SIZE - 1 - col, -value}});
+            }
+        });
+    }
+
+    unsigned long inconsistentSnapshots = 0;
+    for (int i = 0; i < 200; i++) {
+        DenseMatrix dense = matrix.snapshot().toDense();
+        double total = 0.0;
+        for (::std::size_t j = 0; j < SIZE * SIZE; j++) total += dense.data()[j];
+        if (total != 0.0) inconsistentSnapshots++;
+    }
+    shouldContinue.store(false);
+    for (::std::thread& writer : writers) writer.join();
+
+    GTEST_ASSERT_EQ(inconsistentSnapshots, 0ul);
+}
+
+TEST(OutOfCoreTest, verifyStreamedMultiplicationCorrectness) {
+    // Small integers keep every partial sum exact.
+    DenseMatrix leftMat(150, 70), rightMat(70, 90);
+    for (::std::size_t i = 0; i < 150 * 70; i++) leftMat.data()[i] = static_cast<double>(::std::rand() % 19 - 9);
+    for (::std::size_t i = 0; i < 70 * 90; i++) rightMat.data()[i] = static_cast<double>(::std::rand() % 19 - 9);
+    DenseMatrix expected(150, 90);
+    for (::std::size_t row = 0; row < 150; row++) {
+        for (::std::size_t col = 0; col < 90; col++) {
+            for (::std::size_t k = 0; k < 70; k++) expected(row, col) += leftMat(row, k) * rightMat(k, col);
+        }
+    }
+    GTEST_ASSERT_EQ(leftMat * rightMat, expected);
+
+    const ::std::string directory = ::testing::TempDir();
+    const ::std::string leftPath = directory + "out_of_core_left.mat";
+    const ::std::string rightPath = directory + "out_of_core_right.mat";
+    const ::std::string resultPath = directory + "out_of_core_result.mat";
+    writeMatrixFile(leftPath, leftMat);
+    writeMatrixFile(rightPath, rightMat);
+
+    // A budget far below the size of the operands forces many panels of both.
+    OutOfCoreOptions options;
+    options.memoryBudget = 64 * 1024;
+    options.prefetchDepth = 3;
+    multiplyOutOfCore(leftPath, rightPath, resultPath, options);
+    GTEST_ASSERT_EQ(readMatrixFile(resultPath), expected);
+
+    // Mismatched operands leave the previous result alone.
+    EXPECT_THROW(multiplyOutOfCore(rightPath, rightPath, resultPath), ::std::invalid_argument);
+    GTEST_ASSERT_EQ(readMatrixFile(resultPath), expected);
+    options.memoryBudget = 64;
+    EXPECT_THROW(multiplyOutOfCore(leftPath, rightPath, resultPath, options), ::std::invalid_argument);
+
+    // An empty inner dimension gives zeros, over whatever the result holds.
+    writeMatrixFile(leftPath, DenseMatrix(3, 0));
+    writeMatrixFile(rightPath, DenseMatrix(0, 4));
+    MappedMatrix emptyLeft = MappedMatrix::open(leftPath);
+    MappedMatrix emptyRight = MappedMatrix::open(rightPath);
+    MappedMatrix dotProduct = MappedMatrix::create(resultPath, 3, 4);
+    for (::std::size_t i = 0; i < 3 * 4; i++) dotProduct.data()[i] = 1.0;
+    multiplyOutOfCore(emptyLeft, emptyRight, dotProduct);
+    GTEST_ASSERT_EQ(readMatrixFile(resultPath), DenseMatrix(3, 4));
+    ::unlink(leftPath.c_str());
+    ::unlink(rightPath.c_str());
+    ::unlink(resultPath.c_str());
+}
+
+TEST(StrassenTest, verifyStrassenImplementationCorrectness) {
+    // Odd dimensions need padding. Small integers keep every intermediate exact.
+    DenseMatrix leftMat(77, 53), rightMat(53, 91);
+    for (::std::size_t i = 0; i < 77 * 53; i++) leftMat.data()[i] = static_cast<double>(::std::rand() % 19 - 9);
+    for (::std::size_t i = 0; i < 53 * 91; i++) rightMat.data()[i] = static_cast<double>(::std::rand() % 19 - 9);
+    StrassenOptions options;
+    options.crossover = 8;
+    for (unsigned int parallelDepth = 0; parallelDepth <= 2; parallelDepth++) {
+        options.parallelDepth = parallelDepth;
+        GTEST_ASSERT_EQ(multiplyStrassen(leftMat, rightMat, options), leftMat * rightMat);
+    }
+    EXPECT_THROW(multiplyStrassen(leftMat, leftMat), ::std::invalid_argument);
+    GTEST_ASSERT_LE(tuneStrassenCrossover(128), 128u);
+}
+
+TEST(StrassenTest, compareStrassenAccuracy) {
+    const ::std::size_t SIZE = 256;
+    ::std::mt19937_64 generator(7);
+    ::std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    DenseMatrix leftMat(SIZE, SIZE), rightMat(SIZE, SIZE);
+    for (::std::size_t i = 0; i < SIZE * SIZE; i++) {
+        leftMat.data()[i] = distribution(generator);
+        rightMat.data()[i] = distribution(generator);
+    }
+    StrassenOptions options;
+    for (::std::size_t crossover : {128, 64, 32, 16}) {
+        options.crossover = crossover;
+        double error = strassenRelativeError(leftMat, rightMat, options);
+        ::std::cout << "Strassen-Winograd relative error with crossover " << crossover << " = " << error << ".\n";
+        GTEST_ASSERT_LT(error, 1e-13);
+    }
+}
+
+TEST(FactorizationTest, verifyLuImplementationCorrectness) {
+    // Several panels, with a partial one at the end.
+    const ::std::size_t SIZE = 150;
+    ::std::mt19937_64 generator(11);
+    ::std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    PagedMatrix matrix(SIZE, SIZE);
+    DenseMatrix values(SIZE, SIZE);
+    for (::std::size_t i = 0; i < SIZE * SIZE; i++) values.data()[i] = distribution(generator);
+    matrix.store(values);
+    ::std::vector<double> expected(SIZE), b(SIZE, 0.0);
+    for (::std::size_t i = 0; i < SIZE; i++) expected[i] = distribution(generator);
+    for (::std::size_t row = 0; row < SIZE; row++) {
+        for (::std::size_t col = 0; col < SIZE; col++) b[row] += values(row, col) * expected[col];
+    }
+
+    LuFactorization factorization = factorLu(matrix.snapshot());
+    ::std::vector<double> solution = factorization.solve(b);
+    for (::std::size_t i = 0; i < SIZE; i++) GTEST_ASSERT_LT(::std::fabs(solution[i] - expected[i]), 1e-9);
+
+    GTEST_ASSERT_LT(::std::fabs(factorLu(DenseMatrix{{0.0, 2.0}, {3.0, 4.0}}).determinant() + 6.0), 1e-15);
+    EXPECT_THROW(factorLu(DenseMatrix{{1.0, 2.0}, {2.0, 4.0}}), ::std::domain_error);
+    EXPECT_THROW(factorLu(DenseMatrix(2, 3)), ::std::invalid_argument);
+}
+
+TEST(FactorizationTest, verifyCholeskyImplementationCorrectness) {
+    // A = M M^T + n I is symmetric positive definite.
+    const ::std::size_t SIZE = 150;
+    ::std::mt19937_64 generator(13);
+    ::std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    DenseMatrix factor(SIZE, SIZE);
+    for (::std::size_t i = 0; i < SIZE * SIZE; i++) factor.data()[i] = distribution(generator);
+    DenseMatrix values(SIZE, SIZE);
+    for (::std::size_t row = 0; row < SIZE; row++) {
+        for (::std::size_t col = 0; col < SIZE; col++) {
+            for (::std::size_t k = 0; k < SIZE; k++) values(row, col) += factor(row, k) * factor(col, k);
+        }
+        values(row, row) += static_cast<double>(SIZE);
+    }
+
+    DenseMatrix lower = factorCholesky(values).lower;
+    for (::std::size_t row = 0; row < SIZE; row++) {
+        for (::std::size_t col = 0; col < SIZE; col++) {
+            double sum = 0.0;
+            for (::std::size_t k = 0; k < SIZE; k++) sum += lower(row, k) * lower(col, k);
+            GTEST_ASSERT_LT(::std::fabs(sum - values(row, col)), 1e-9);
+            if (col > row) {
+                GTEST_ASSERT_EQ(lower(row, col), 0.0);
+            }
+        }
+    }
+    ::std::vector<double> solution = factorCholesky(values).solve(::std::vector<double>(SIZE, 1.0));
+    for (::std::size_t row = 0; row < SIZE; row++) {
+        double sum = 0.0;
+        for (::std::size_t col = 0; col < SIZE; col++) sum += values(row, col) * solution[col];
+        GTEST_ASSERT_LT(::std::fabs(sum - 1.0), 1e-9);
+    }
+    EXPECT_THROW(factorCholesky(DenseMatrix{{1.0, 2.0}, {2.0, 1.0}}), ::std::domain_error);
+}
+
+TEST(MatrixChainTest, verifyChainPlanCorrectness) {
+    ChainPlan optimal = planChainOptimal({30, 35, 15, 5, 10, 20, 25});
+    GTEST_ASSERT_EQ(optimal.multiplications, 15125.0);
+    GTEST_ASSERT_EQ(optimal.toString(), "((A0 (A1 A2)) ((A3 A4) A5))");
+    GTEST_ASSERT_EQ(planChain({3, 4}).toString(), "A0");
+
+    // Projection chains, tall x wide x tall, cost far less when the thin sides go first.
+    ::std::vector<::std::size_t> projection;
+    for (int i = 0; i < 300; i++) projection.push_back(i % 2 == 0 ? 1000 : 4);
+    projection.push_back(1000);
+    double leftToRight = 0.0;
+    for (::std::size_t i = 1; i + 1 < projection.size(); i++) {
+        leftToRight += static_cast<double>(projection[0]) * projection[i] * projection[i + 1];
+    }
+    ChainPlan greedy = planChain(projection);
+    GTEST_ASSERT_EQ(greedy.products.size(), 299u);
+    GTEST_ASSERT_LT(greedy.multiplications * 100.0, leftToRight);
+}
+
+TEST(MatrixChainTest, verifyChainProductCorrectness) {
+    ::std::vector<::std::size_t> dims = {40, 3, 50, 2, 60, 5, 30};
+    ::std::vector<DenseMatrix> mats;
+    for (::std::size_t i = 0; i + 1 < dims.size(); i++) {
+        DenseMatrix mat(dims[i], dims[i + 1]);
+        for (::std::size_t j = 0; j < dims[i] * dims[i + 1]; j++) mat.data()[j] = static_cast<double>(::std::rand() % 7 - 3);
+        mats.push_back(mat);
+    }
+    DenseMatrix expected = mats[0];
+    for (::std::size_t i = 1; i < mats.size(); i++) expected = expected * mats[i];
+
+    for (unsigned int parallelDepth = 0; parallelDepth <= 3; parallelDepth++) {
+        GTEST_ASSERT_EQ(multiplyChain(mats, parallelDepth), expected);
+    }
+    GTEST_ASSERT_EQ(multiplyChain({mats[0]}), mats[0]);
+    EXPECT_THROW(multiplyChain({mats[0], mats[0]}), ::std::invalid_argument);
+}
+
+/// @brief Run a workload with each synchronization strategy and report the rates.
+/// Only the atomic-only strategy may read torn matrices.
+template <typename Workload, typename... Arguments>
+inline void runWorkloadWithEveryStrategy(const char* name, Arguments... arguments) {
+    for (SyncStrategy strategy : {SyncStrategy::AtomicOnly, SyncStrategy::Mutex, SyncStrategy::SeqLock}) {
+        Workload workload(strategy, arguments...);
+        WorkloadResult result = runWorkload(workload, 2, ::std::chrono::milliseconds(200));
+        ::std::cout << name << " with " << toString(strategy) << ": " << result.readRate() << " reads/s, "
+            << result.writeRate() << " writes/s, " << result.inconsistentReads << " torn matrices.\n";
+        GTEST_ASSERT_GT(result.readSteps, 0ull);
+        if (strategy != SyncStrategy::AtomicOnly) {
+            GTEST_ASSERT_EQ(result.inconsistentReads, 0ull);
+        }
+    }
+}
+
+TEST(WorkloadTest, runSkinningWorkload) {
+    runWorkloadWithEveryStrategy<SkinningWorkload>("Skinning", ::std::size_t(512), ::std::size_t(5000));
+}
+
+TEST(WorkloadTest, runKalmanPredictWorkload) {
+    GTEST_ASSERT_EQ(transpose(transpose(Matrix4x4::identity() * 2.0)), Matrix4x4::identity() * 2.0);
+    Matrix4x4 transition = KalmanPredictWorkload::transitionFor(0.5);
+    GTEST_ASSERT_EQ(transpose(transition)(2, 0), 0.5);
+    GTEST_ASSERT_EQ(transpose(transition)(0, 2), 0.0);
+    runWorkloadWithEveryStrategy<KalmanPredictWorkload>("Kalman predict", ::std::size_t(1024));
+}
+
+TEST(WorkloadTest, runRigidBodyWorkload) {
+    runWorkloadWithEveryStrategy<RigidBodyWorkload>("Rigid-body integration", ::std::size_t(1024));
+}
+
+TEST_F(TestSuiteFixture, verifyColumnarRecorderCorrectness) {
+    // Run the modifier in the background.
+    runTestVariableModifier();
+    // Not a multiple of the vector width, to cover the remainder.
+    const int CYCLES = 10001;
+
+    ColumnarRecorder recorder(CYCLES);
+    for (int i = 0; i < CYCLES; i++) {
+        // Both recordings get the same copies.
+        AtomicMatrix4x4 leftMat(_mat1), rightMat(_mat2), dotProduct(_mat1 * _mat2);
+        _calculations.push_back(MultiplicationRecorder(leftMat, rightMat, dotProduct));
+        recorder.record(leftMat, rightMat, dotProduct);
+    }
+    _shouldModificationsContinue.store(false);
+
+    ::std::vector<::std::uint8_t> results(CYCLES);
+    ::std::size_t correct = recorder.verify(results.data());
+    GTEST_ASSERT_EQ(recorder.size(), static_cast<::std::size_t>(CYCLES));
+    for (int i = 0; i < CYCLES; i++) {
+        GTEST_ASSERT_EQ(results[i] == 1, _calculations[i].isCorrect());
+    }
+    GTEST_ASSERT_EQ(recorder.accuracy(), calculateAccuracy());
+    GTEST_ASSERT_EQ(static_cast<double>(correct) * 100.0 / CYCLES, calculateAccuracy());
+    GTEST_ASSERT_EQ(recorder.matrix(0, ColumnarRecorder::LEFT) * recorder.matrix(0, ColumnarRecorder::RIGHT) ==
+        recorder.matrix(0, ColumnarRecorder::PRODUCT), _calculations[0].isCorrect());
+    EXPECT_THROW(recorder.matrix(CYCLES, ColumnarRecorder::LEFT), ::std::out_of_range);
+
+    ::std::cout << "Accuracy of columnar-verified calculations with only atomic calculations = "
+        << recorder.accuracy() << "%.\n";
+}
+
+TEST_F(TestSuiteFixture, runFailureOnlyRecording) {
+    // Run the modifier in the background.
+    runTestVariableModifier();
+    // The number of calculations cycles.
+    const int CYCLES = 100000;
+
+    FailureRecorder recorder(16);
+    unsigned long long failures = 0;
+    for (int i = 0; i < CYCLES; i++) {
+        AtomicMatrix4x4 leftMat(_mat1), rightMat(_mat2), dotProduct(_mat1 * _mat2);
+        bool isCorrect = MultiplicationRecorder(leftMat, rightMat, dotProduct).isCorrect();
+        if (!isCorrect) failures++;
+        GTEST_ASSERT_EQ(recorder.record(leftMat, rightMat, dotProduct), isCorrect);
+    }
+    _shouldModificationsContinue.store(false);
+
+    GTEST_ASSERT_EQ(recorder.recorded(), static_cast<unsigned long long>(CYCLES));
+    GTEST_ASSERT_EQ(recorder.failed(), failures);
+    ::std::vector<FailureRecord> sampled = recorder.failures();
+    GTEST_ASSERT_EQ(sampled.size(), ::std::min<::std::size_t>(16, failures));
+    for (const FailureRecord& failure : sampled) {
+        GTEST_ASSERT_NE(failure.leftMat * failure.rightMat, failure.dotProduct);
+        GTEST_ASSERT_LT(failure.sequence, static_cast<unsigned long long>(CYCLES));
+    }
+
+    // The reservoir stays bounded however many failures there are.
+    recorder.clear();
+    Matrix4x4 wrong = Matrix4x4::identity() * 2.0;
+    for (int i = 0; i < 1000; i++) recorder.record(Matrix4x4::identity(), Matrix4x4::identity(), wrong);
+    GTEST_ASSERT_EQ(recorder.failed(), 1000ull);
+    GTEST_ASSERT_EQ(recorder.failures().size(), 16u);
+    GTEST_ASSERT_EQ(recorder.accuracy(), 0.0);
+
+    ::std::cout << "Failures kept by the failure-only recording = " << sampled.size()
+        << " of " << failures << ".\n";
+}
+
+TEST_F(TestSuiteFixture, runCalculationsWithTimeline) {
+    Timeline timeline(::std::chrono::milliseconds(10));
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::thread writer([&]() {
+        Timeline::Recorder recorder = timeline.recorder();
+        while (shouldContinue.load()) {
+            _mat1(static_cast<unsigned int>(::std::rand()) % 4, static_cast<unsigned int>(::std::rand()) % 4)
+                .store(static_cast<double>(::std::rand() % 4));
+            recorder.add(TimelineCounter::Writes);
+        }
+    });
+
+    // Calculations are repeated until they are correct.
+    Timeline::Recorder recorder = timeline.recorder();
+    unsigned long long reads = 0;
+    auto start = ::std::chrono::steady_clock::now();
+    while (::std::chrono::steady_clock::now() - start < ::std::chrono::milliseconds(100)) {
+        for (bool isFirst = true;; isFirst = false) {
+            if (!isFirst) recorder.add(TimelineCounter::Retries);
+            MultiplicationRecorder calculation(_mat1, _mat2, _mat1 * _mat2);
+            recorder.add(TimelineCounter::Reads);
+            reads++;
+            bool isCorrect = calculation.isCorrect();
+            recorder.add(isCorrect ? TimelineCounter::CorrectCalculations : TimelineCounter::IncorrectCalculations);
+            if (isCorrect) break;
+        }
+    }
+    shouldContinue.store(false);
+    writer.join();
+
+    ::std::vector<Timeline::Window> windows = timeline.windows();
+    GTEST_ASSERT_GE(windows.size(), 10u);
+    unsigned long long totalReads = 0, totalRetries = 0, totalIncorrect = 0;
+    for (const Timeline::Window& window : windows) {
+        totalReads += window.count(TimelineCounter::Reads);
+        totalRetries += window.count(TimelineCounter::Retries);
+        totalIncorrect += window.count(TimelineCounter::IncorrectCalculations);
+    }
+    GTEST_ASSERT_EQ(totalReads, reads);
+    GTEST_ASSERT_EQ(totalRetries, totalIncorrect);
+
+    ::std::ostringstream csv;
+    timeline.writeCsv(csv);
+    ::std::string text = csv.str();
+    GTEST_ASSERT_EQ(static_cast<::std::size_t>(::std::count(text.begin(), text.end(), '\n')), windows.size() + 1);
+    ::std::cout << "Timeline of calculations repeated until correct:\n" << text.substr(0, text.find('\n', 400)) << "\n";
+
+    // Events past the last window land in the overflow, and a window in progress only
+    // spans the time elapsed in it.
+    Timeline shortTimeline(::std::chrono::milliseconds(5), 2);
+    Timeline::Recorder shortRecorder = shortTimeline.recorder();
+    shortRecorder.add(TimelineCounter::Reads);
+    GTEST_ASSERT_LE(shortTimeline.windows().back().seconds, 0.005);
+    ::std::this_thread::sleep_for(::std::chrono::milliseconds(20));
+    shortRecorder.add(TimelineCounter::Reads, 3);
+    ::std::vector<Timeline::Window> shortWindows = shortTimeline.windows();
+    GTEST_ASSERT_EQ(shortWindows.size(), 2u);
+    GTEST_ASSERT_EQ(shortWindows[0].count(TimelineCounter::Reads) + shortWindows[1].count(TimelineCounter::Reads), 1ull);
+    GTEST_ASSERT_EQ(shortWindows[1].seconds, 0.005);
+    GTEST_ASSERT_EQ(shortTimeline.overflow().count(TimelineCounter::Reads), 3ull);
+    GTEST_ASSERT_GT(shortTimeline.overflow().seconds, 0.0);
+}
+
+TEST(WorkloadTest, verifyKeyDistributions) {
+    const ::std::size_t KEYS = 10000;
+    const int DRAWS = 200000;
+    ::std::mt19937_64 random(3);
+
+    KeyDistribution zipfian = KeyDistribution::zipfian(0.99);
+    zipfian.isScrambled = false;
+    KeyGenerator zipfianKeys(KEYS, zipfian);
+    ::std::vector<unsigned int> counts(KEYS, 0);
+    for (int i = 0; i < DRAWS; i++) counts[zipfianKeys.next(random)]++;
+    // The hottest key gets about 1 / zeta(n) of the accesses, some 10% here.
+    GTEST_ASSERT_GT(counts[0], static_cast<unsigned int>(DRAWS / 20));
+    GTEST_ASSERT_GT(counts[0], counts[1]);
+    GTEST_ASSERT_GT(counts[1], counts[100]);
+
+    KeyGenerator hotspotKeys(KEYS, KeyDistribution::hotspot(0.01, 0.9));
+    ::std::vector<bool> isHot(KEYS, false);
+    for (::std::size_t rank = 0; rank < KEYS / 100; rank++) isHot[hotspotKeys.scramble(rank)] = true;
+    int hotAccesses = 0;
+    for (int i = 0; i < DRAWS; i++) {
+        if (isHot[hotspotKeys.next(random)]) hotAccesses++;
+    }
+    GTEST_ASSERT_GT(hotAccesses, DRAWS * 88 / 100);
+    EXPECT_THROW(KeyGenerator(KEYS, KeyDistribution::zipfian(1.5)), ::std::invalid_argument);
+}
+
+TEST(WorkloadTest, runManyMatrixWorkloadWithSkew) {
+    const KeyDistribution distributions[] = {KeyDistribution::zipfian(), KeyDistribution::hotspot()};
+    const char* names[] = {"Zipfian", "hotspot"};
+    for (int distribution = 0; distribution < 2; distribution++) {
+        for (SyncStrategy strategy : {SyncStrategy::AtomicOnly, SyncStrategy::Mutex, SyncStrategy::SeqLock}) {
+            ManyMatrixWorkload workload(strategy, 10000, 0.9, distributions[distribution]);
+            MixedWorkloadResult result = workload.run(4, ::std::chrono::milliseconds(100));
+            ::std::cout << "Many matrices, " << names[distribution] << " keys, " << toString(strategy) << ": "
+                << result.operationRate() << " operations/s, " << result.inconsistentReads << " torn reads.\n";
+            GTEST_ASSERT_GT(result.reads, 0ull);
+            if (strategy != SyncStrategy::AtomicOnly) {
+                GTEST_ASSERT_EQ(result.inconsistentReads, 0ull);
+            }
+        }
+    }
+}
+
+TEST(RegistryTest, verifyRegistryImplementationCorrectness) {
+    MatrixRegistry<::std::string> registry(4);
+    Matrix4x4 value = Matrix4x4::identity();
+    for (int i = 0; i < 1000; i++) {
+        value.data[0] = i;
+        GTEST_ASSERT_TRUE(registry.insert("matrix" + ::std::to_string(i), value));
+    }
+    GTEST_ASSERT_FALSE(registry.insert("matrix7"));
+    GTEST_ASSERT_EQ(registry.size(), 1000u);
+    for (int i = 0; i < 1000; i++) GTEST_ASSERT_EQ(registry.load("matrix" + ::std::to_string(i)).data[0], i);
+
+    GTEST_ASSERT_TRUE(registry.erase("matrix7"));
+    GTEST_ASSERT_FALSE(registry.erase("matrix7"));
+    GTEST_ASSERT_FALSE(registry.contains("matrix7"));
+    EXPECT_THROW(registry.load("matrix7"), ::std::out_of_range);
+    EXPECT_THROW(registry.snapshot({"matrix1", "matrix7"}), ::std::out_of_range);
+    registry.store("matrix7", Matrix4x4::identity() * 2.0);
+    GTEST_ASSERT_EQ(registry.size(), 1000u);
+
+    ::std::uint64_t before = registry.epoch();
+    registry.update({{"matrix1", Matrix4x4::identity()}, {"matrix1000", Matrix4x4::identity()},
+        {"matrix1", Matrix4x4::identity() * 3.0}});
+    GTEST_ASSERT_EQ(registry.epoch(), before + 1);
+    GTEST_ASSERT_EQ(registry.size(), 1001u);
+    ::std::uint64_t epoch = 0;
+    ::std::vector<Matrix4x4> group = registry.snapshot({"matrix7", "matrix1", "matrix1000"}, &epoch);
+    GTEST_ASSERT_EQ(epoch, registry.epoch());
+    GTEST_ASSERT_TRUE(group[0] == Matrix4x4::identity() * 2.0);
+    GTEST_ASSERT_TRUE(group[1] == Matrix4x4::identity() * 3.0);
+    GTEST_ASSERT_TRUE(group[2] == Matrix4x4::identity());
+}
+
+TEST(RegistryTest, runBulkUpdatesWithConsistentGroupSnapshots) {
+    // Groups of keys are always updated together to the same value, while new keys keep
+    // growing the tables under the readers.
+    const unsigned long long GROUPS = 1000, GROUP_SIZE = 4;
+    MatrixRegistry<unsigned long long> registry;
+    for (unsigned long long key = 0; key < GROUPS * GROUP_SIZE; key++) registry.insert(key);
+
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::vector<::std::thread> writers;
+    for (int writer = 0; writer < 2; writer++) {
+        writers.emplace_back([&, writer]() {
+            ::std::mt19937 random(writer);
+            ::std::vector<MatrixRegistry<unsigned long long>::Update> batch(GROUP_SIZE);
+            for (double fill = 1.0; shouldContinue.load(); fill++) {
+                unsigned long long group = random() % GROUPS;
+                for (unsigned long long i = 0; i < GROUP_SIZE; i++) {
+                    batch[i].key = group * GROUP_SIZE + i;
+                    batch[i].value = Matrix4x4::identity() * fill;
+                }
+                registry.update(batch);
+            }
+        });
+    }
+    ::std::thread inserter([&]() {
+        for (unsigned long long key = GROUPS * GROUP_SIZE; key < 20 * GROUPS * GROUP_SIZE; key++) registry.insert(key);
+    });
+
+    ::std::mt19937 random(7);
+    unsigned long long snapshots = 0, inconsistent = 0;
+    ::std::vector<unsigned long long> keys(GROUP_SIZE);
+    auto start = ::std::chrono::steady_clock::now();
+    while (::std::chrono::steady_clock::now() - start < ::std::chrono::milliseconds(200)) {
+        unsigned long long group = random() % GROUPS;
+        // Read the group in reverse, to cross the order of the writers.
+        for (unsigned long long i = 0; i < GROUP_SIZE; i++) keys[i] = group * GROUP_SIZE + GROUP_SIZE - 1 - i;
+        ::std::vector<Matrix4x4> values = registry.snapshot(keys);
+        for (unsigned long long i = 1; i < GROUP_SIZE; i++) {
+            if (!(values[i] == values[0])) {
+                inconsistent++;
+                break;
+            }
+        }
+        snapshots++;
+    }
+    inserter.join();
+    shouldContinue.store(false);
+    for (::std::thread& writer : writers) writer.join();
+
+    ::std::cout << "Registry group snapshots: " << snapshots << " in 200 ms, " << registry.epoch() << " changes.\n";
+    GTEST_ASSERT_EQ(inconsistent, 0ull);
+    GTEST_ASSERT_EQ(registry.size(), 20 * GROUPS * GROUP_SIZE);
+    for (unsigned long long key = 0; key < 20 * GROUPS * GROUP_SIZE; key += 997) GTEST_ASSERT_TRUE(registry.contains(key));
+}
+
+TEST(ShardTest, runShardedUpdatesAgainstSharedMemory) {
+    // Every core adds the identity to random matrices and reads some back. Additions
+    // commute, so the sum of the traces is known at the end however they interleave.
+    const ::std::size_t MATRICES = 4096;
+    const unsigned int CORES = 4;
+    const int OPERATIONS = 20000;
+
+    // Both sides run the same operations, timed from when every thread is ready until
+    // the last one is done with them, which leaves out starting and pinning the threads.
+    ::std::atomic<unsigned int> readyThreads(0);
+    ::std::atomic<::std::int64_t> firstStart(0), lastEnd(0);
+    auto now = []() {
+        return static_cast<::std::int64_t>(::std::chrono::duration_cast<::std::chrono::nanoseconds>(
+            ::std::chrono::steady_clock::now().time_since_epoch()).count());
+    };
+    auto startLoop = [&]() {
+        readyThreads.fetch_add(1);
+        while (readyThreads.load() < CORES) ::std::this_thread::yield();
+        ::std::int64_t start = now(), first = firstStart.load();
+        while ((first == 0 || start < first) && !firstStart.compare_exchange_weak(first, start)) {}
+    };
+    auto endLoop = [&]() {
+        ::std::int64_t end = now(), last = lastEnd.load();
+        while (end > last && !lastEnd.compare_exchange_weak(last, end)) {}
+    };
+    auto loopSeconds = [&]() {
+        double seconds = static_cast<double>(lastEnd.load() - firstStart.load()) * 1e-9;
+        readyThreads.store(0);
+        firstStart.store(0);
+        lastEnd.store(0);
+        return seconds;
+    };
+
+    ShardedMatrixStore store(MATRICES, CORES, Matrix4x4());
+    ::std::atomic<unsigned long long> inconsistentLoads(0);
+    store.run([&](ShardedMatrixStore::Core& core) {
+        ::std::mt19937_64 random(core.index());
+        ::std::uint64_t keys[8];
+        Matrix4x4 values[8];
+        startLoop();
+        for (int operation = 0; operation < OPERATIONS; operation++) {
+            core.add(random() % MATRICES, Matrix4x4::identity());
+            if (operation % 64 == 0) {
+                for (::std::uint64_t& key : keys) key = random() % MATRICES;
+                core.loadBatch(keys, 8, values);
+                for (const Matrix4x4& value : values) {
+                    if (!(value == Matrix4x4::identity() * value.data[0])) inconsistentLoads++;
+                }
+            }
+        }
+        endLoop();
+    });
+    double shardedSeconds = loopSeconds();
+    double traceSum = 0.0;
+    for (::std::uint64_t key = 0; key < MATRICES; key++) traceSum += trace(store.matrix(key));
+    GTEST_ASSERT_EQ(traceSum, 4.0 * CORES * OPERATIONS);
+    GTEST_ASSERT_EQ(inconsistentLoads.load(), 0ull);
+    EXPECT_THROW(store.matrix(MATRICES), ::std::out_of_range);
+
+    // A batch with an invalid key sends no request, so no reply outlives it.
+    ShardedMatrixStore small(16, 2, Matrix4x4::identity());
+    ::std::atomic<int> rejectedBatches(0), correctLoads(0);
+    small.run([&](ShardedMatrixStore::Core& core) {
+        if (core.index() != 0) return;
+        ::std::uint64_t invalidKeys[3] = {1, 3, 16};
+        Matrix4x4 lost[3];
+        try {
+            core.loadBatch(invalidKeys, 3, lost);
+        } catch (const ::std::out_of_range&) {
+            rejectedBatches++;
+        }
+        ::std::uint64_t keys[2] = {1, 3};
+        Matrix4x4 values[2];
+        core.loadBatch(keys, 2, values);
+        for (const Matrix4x4& value : values) {
+            if (value == Matrix4x4::identity()) correctLoads++;
+        }
+    });
+    GTEST_ASSERT_EQ(rejectedBatches.load(), 1);
+    GTEST_ASSERT_EQ(correctLoads.load(), 2);
+
+    // The same operations on shared atomic matrices behind a mutex, as in the fixture.
+    ::std::vector<AtomicMatrix4x4> shared(MATRICES);
+    ::std::mutex sharedMutex;
+    ::std::vector<::std::thread> threads;
+    for (unsigned int core = 0; core < CORES; core++) {
+        threads.emplace_back([&, core]() {
+            ::std::mt19937_64 random(core);
+            ::std::uint64_t keys[8];
+            Matrix4x4 values[8];
+            startLoop();
+            for (int operation = 0; operation < OPERATIONS; operation++) {
+                ::std::size_t key = random() % MATRICES;
+                {
+                    ::std::lock_guard<::std::mutex> lock(sharedMutex);
+                    shared[key].store(shared[key].snapshot() + Matrix4x4::identity());
+                }
+                if (operation % 64 == 0) {
+                    for (::std::uint64_t& batchKey : keys) batchKey = random() % MATRICES;
+                    {
+                        ::std::lock_guard<::std::mutex> lock(sharedMutex);
+                        for (int i = 0; i < 8; i++) values[i] = shared[keys[i]].snapshot();
+                    }
+                    for (const Matrix4x4& value : values) {
+                        if (!(value == Matrix4x4::identity() * value.data[0])) inconsistentLoads++;
+                    }
+                }
+            }
+            endLoop();
+        });
+    }
+    for (::std::thread& thread : threads) thread.join();
+    double sharedSeconds = loopSeconds();
+    traceSum = 0.0;
+    for (const AtomicMatrix4x4& matrix : shared) traceSum += trace(matrix.snapshot());
+    GTEST_ASSERT_EQ(traceSum, 4.0 * CORES * OPERATIONS);
+    GTEST_ASSERT_EQ(inconsistentLoads.load(), 0ull);
+
+    ::std::cout << "Sharded across " << CORES << " cores: " << CORES * OPERATIONS / shardedSeconds
+        << " operations/s, shared behind a mutex: " << CORES * OPERATIONS / sharedSeconds << " operations/s.\n";
+}
+
+TEST(NodeReplicationTest, verifyCpuListParsingCorrectness) {
+    ::std::vector<unsigned int> expected = {0, 1, 2, 3, 8, 10, 11};
+    GTEST_ASSERT_EQ(parseCpuList("0-3,8,10-11\n"), expected);
+    GTEST_ASSERT_TRUE(parseCpuList("").empty());
+    EXPECT_THROW(parseCpuList("0-x"), ::std::invalid_argument);
+    GTEST_ASSERT_GE(NumaTopology::system().nodeCount(), 1u);
+    GTEST_ASSERT_LT(NumaTopology::system().currentNode(), NumaTopology::system().nodeCount());
+    for (unsigned int node = 0; node < NumaTopology::system().nodeCount(); node++) {
+        for (unsigned int cpu : NumaTopology::system().cpusOfNode(node)) {
+            GTEST_ASSERT_EQ(NumaTopology::system().nodeOfCpu(cpu), node);
+        }
+    }
+    GTEST_ASSERT_TRUE(NumaTopology::system().cpusOfNode(NumaTopology::system().nodeCount()).empty());
+}
+
+TEST(NodeReplicationTest, runReplicatedUpdatesAndNodeLocalReads) {
+    // Writers on every node add the identity, so each replica only ever holds the
+    // identity times the number of additions it replayed, and never goes back.
+    const unsigned int NODES = 4;
+    const int ADDITIONS = 5000;
+    ReplicatedMatrix4x4 replicated(ReplicableMatrix4x4{Matrix4x4()}, NODES);
+    const ReplicableMatrix4x4::Operation addIdentity = {ReplicableMatrix4x4::Kind::Add, Matrix4x4::identity()};
+    auto readValue = [](const ReplicableMatrix4x4& matrix) { return matrix.value; };
+
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::atomic<unsigned long long> reads(0), inconsistentReads(0);
+    ::std::vector<::std::thread> readers;
+    for (unsigned int node = 0; node < NODES; node++) {
+        readers.emplace_back([&, node]() {
+            double previous = 0.0;
+            while (shouldContinue.load()) {
+                Matrix4x4 value = replicated.read(node, readValue);
+                if (!(value == Matrix4x4::identity() * value.data[0]) || value.data[0] < previous) inconsistentReads++;
+                previous = value.data[0];
+                reads++;
+            }
+        });
+    }
+    ::std::vector<::std::thread> writers;
+    for (unsigned int node = 0; node < NODES; node++) {
+        writers.emplace_back([&, node]() {
+            for (int i = 0; i < ADDITIONS; i++) replicated.execute(node, addIdentity);
+        });
+    }
+    for (::std::thread& writer : writers) writer.join();
+    shouldContinue.store(false);
+    for (::std::thread& reader : readers) reader.join();
+
+    ::std::cout << "Replicated matrix: " << reads.load() << " node local reads during " << replicated.logSize()
+        << " logged additions.\n";
+    GTEST_ASSERT_EQ(inconsistentReads.load(), 0ull);
+    GTEST_ASSERT_EQ(replicated.logSize(), static_cast<::std::uint64_t>(NODES) * ADDITIONS);
+    for (unsigned int node = 0; node < NODES; node++) {
+        GTEST_ASSERT_TRUE(replicated.read(node, readValue) == Matrix4x4::identity() * (NODES * ADDITIONS));
+    }
+    replicated.execute({ReplicableMatrix4x4::Kind::Store, Matrix4x4::identity()});
+    GTEST_ASSERT_TRUE(replicated.read(readValue) == Matrix4x4::identity());
+    EXPECT_THROW(replicated.read(NODES, readValue), ::std::out_of_range);
+}
+
+TEST(DataflowTest, verifyIncrementalRecomputationCorrectness) {
+    ::std::mt19937 random(5);
+    ::std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+    auto randomMatrix = [&]() {
+        Matrix4x4 mat;
+        for (double& value : mat.data) value = distribution(random);
+        return mat;
+    };
+    Matrix4x4 a = randomMatrix() + Matrix4x4::identity() * 4.0, b = randomMatrix(), c = randomMatrix();
+    GTEST_ASSERT_LT(maxAbs(a * inverse(a) - Matrix4x4::identity()), 1e-12);
+    GTEST_ASSERT_LT(::std::fabs(determinant(a * b) - determinant(a) * determinant(b)), 1e-9);
+
+    DataflowGraph graph;
+    DataflowGraph::NodeId sourceA = graph.addSource(a), sourceB = graph.addSource(b), sourceC = graph.addSource(c);
+    DataflowGraph::NodeId product = graph.addProduct(sourceA, sourceB);
+    DataflowGraph::NodeId inverseA = graph.addInverse(sourceA);
+    DataflowGraph::NodeId sum = graph.addSum(product, sourceC);
+    DataflowGraph::NodeId result = graph.addProduct(inverseA, graph.addTranspose(sum));
+    GTEST_ASSERT_EQ(graph.recompute(), 8u);
+    GTEST_ASSERT_EQ(graph.recompute(), 0u);
+    DataflowGraph::Snapshot snapshot = graph.snapshot();
+    GTEST_ASSERT_EQ(snapshot.version(), 1u);
+    GTEST_ASSERT_TRUE(snapshot.value(result) == inverse(a) * transpose(a * b + c));
+
+    // Only the sum, the transpose and the result depend on C.
+    c = randomMatrix();
+    graph.set(sourceC, c);
+    GTEST_ASSERT_EQ(graph.recompute(), 4u);
+    GTEST_ASSERT_TRUE(graph.snapshot().value(result) == inverse(a) * transpose(a * b + c));
+    GTEST_ASSERT_TRUE(snapshot.value(result) != graph.snapshot().value(result));
+
+    graph.set(sourceA, Matrix4x4());
+    EXPECT_THROW(graph.recompute(), ::std::domain_error);
+    GTEST_ASSERT_EQ(graph.snapshot().version(), 2u);
+    graph.set(sourceA, a);
+    GTEST_ASSERT_EQ(graph.recompute(), 6u);
+    EXPECT_THROW(graph.set(product, a), ::std::invalid_argument);
+    EXPECT_THROW(graph.addSum(sum, 100), ::std::out_of_range);
+}
+
+TEST(DataflowTest, runRecomputationsWithConsistentSnapshots) {
+    // Dozens of products over two sources that keep changing. Readers check that every
+    // product they see comes from the sources of the same snapshot.
+    const int PRODUCTS = 48;
+    DataflowGraph graph;
+    DataflowGraph::NodeId left = graph.addSource(Matrix4x4::identity()), right = graph.addSource(Matrix4x4::identity());
+    ::std::vector<DataflowGraph::NodeId> products;
+    for (int i = 0; i < PRODUCTS; i++) products.push_back(graph.addProduct(i % 2 == 0 ? left : right, right));
+    graph.recompute();
+
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::atomic<unsigned long long> inconsistentSnapshots(0);
+    ::std::thread reader([&]() {
+        while (shouldContinue.load()) {
+            DataflowGraph::Snapshot snapshot = graph.snapshot();
+            for (int i = 0; i < PRODUCTS; i++) {
+                Matrix4x4 expected = snapshot.value(i % 2 == 0 ? left : right) * snapshot.value(right);
+                if (snapshot.value(products[i]) != expected) inconsistentSnapshots++;
+            }
+        }
+    });
+    ::std::size_t evaluated = 0;
+    for (int i = 1; i <= 2000; i++) {
+        graph.set(i % 2 == 0 ? left : right, Matrix4x4::identity() * i);
+        evaluated += graph.recompute();
+    }
+    shouldContinue.store(false);
+    reader.join();
+
+    GTEST_ASSERT_EQ(inconsistentSnapshots.load(), 0ull);
+    // Changing the left source only recomputes half of the products.
+    GTEST_ASSERT_EQ(evaluated, 1000u * (1 + PRODUCTS / 2) + 1000u * (1 + PRODUCTS));
+    GTEST_ASSERT_EQ(graph.snapshot().version(), 2001u);
+}
+
+TEST(CoalescingTest, runCoalescedElementWrites) {
+    // Two writers overwrite random elements, as the modifier does, with values that
+    // tell the writer and the order of the write. Each element ends up with the last
+    // write of one of them.
+    const int WRITES = 200000;
+    CoalescingMatrix4x4 matrix(Matrix4x4(), 64, ::std::chrono::milliseconds(1));
+    double lastWrites[2][16] = {};
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::atomic<unsigned long long> reads(0);
+    ::std::thread reader([&]() {
+        while (shouldContinue.load()) {
+            matrix.load();
+            reads++;
+        }
+    });
+    ::std::vector<::std::thread> writers;
+    for (int writer = 0; writer < 2; writer++) {
+        writers.emplace_back([&, writer]() {
+            CoalescingMatrix4x4::Writer buffer = matrix.writer();
+            ::std::mt19937 random(writer);
+            for (int i = 1; i <= WRITES; i++) {
+                unsigned int index = random() % 16;
+                double value = writer * 1e9 + i;
+                buffer.store(index / 4, index % 4, value);
+                lastWrites[writer][index] = value;
+            }
+            EXPECT_THROW(buffer.store(4, 0, 0.0), ::std::out_of_range);
+        });
+    }
+    for (::std::thread& writer : writers) writer.join();
+    Matrix4x4 latest = matrix.loadLatest();
+    shouldContinue.store(false);
+    reader.join();
+
+    for (int i = 0; i < 16; i++) {
+        GTEST_ASSERT_TRUE(latest.data[i] == lastWrites[0][i] || latest.data[i] == lastWrites[1][i]);
+    }
+    GTEST_ASSERT_TRUE(matrix.load() == latest);
+    GTEST_ASSERT_EQ(matrix.writes(), 2ull * WRITES);
+    GTEST_ASSERT_LE(matrix.publishedWrites(), 16 * matrix.flushes());
+    ::std::cout << "Coalesced writes: " << matrix.writes() << " element writes, " << matrix.publishedWrites()
+        << " published in " << matrix.flushes() << " versions, during " << reads.load() << " reads.\n";
+
+    // The writes of a writer gone idle reach readers on the background flushes.
+    CoalescingMatrix4x4::Writer idle = matrix.writer();
+    idle.store(2, 3, -1.0);
+    auto deadline = ::std::chrono::steady_clock::now() + ::std::chrono::seconds(5);
+    while (matrix.load().data[11] != -1.0 && ::std::chrono::steady_clock::now() < deadline) {
+        ::std::this_thread::sleep_for(::std::chrono::milliseconds(1));
+    }
+    GTEST_ASSERT_EQ(matrix.load().data[11], -1.0);
+}
+
+TEST(WriteAheadLogTest, verifyRecoveryCorrectness) {
+    GTEST_ASSERT_EQ(crc32cSoftware(0, "123456789", 9), 0xe3069283u);
+    GTEST_ASSERT_EQ(crc32c(0, "123456789", 9), 0xe3069283u);
+    GTEST_ASSERT_EQ(crc32c(crc32c(0, "1234", 4), "56789", 5), 0xe3069283u);
+
+    const ::std::string directory = ::testing::TempDir() + "wal_recovery";
+    WriteAheadLog::destroy(directory);
+    WalOptions options;
+    // Small segments, to recover across many of them.
+    options.segmentSize = 4096;
+    {
+        DurableMatrixRegistry<::std::string> durable(directory, options);
+        for (int i = 0; i < 100; i++) durable.store("matrix" + ::std::to_string(i % 10), Matrix4x4::identity() * i);
+        durable.update({{"left", Matrix4x4::identity()}, {"right", Matrix4x4::identity() * 2.0}});
+        GTEST_ASSERT_TRUE(durable.erase("matrix0"));
+        GTEST_ASSERT_GT(durable.log().segmentCount(), 1u);
+    }
+    {
+        DurableMatrixRegistry<::std::string> durable(directory, options);
+        GTEST_ASSERT_EQ(durable.recoveredRecords(), 102u);
+        GTEST_ASSERT_EQ(durable.registry().size(), 11u);
+        GTEST_ASSERT_FALSE(durable.registry().contains("matrix0"));
+        GTEST_ASSERT_TRUE(durable.registry().load("matrix9") == Matrix4x4::identity() * 99.0);
+        GTEST_ASSERT_TRUE(durable.registry().load("right") == Matrix4x4::identity() * 2.0);
+        durable.store("matrix0", Matrix4x4::identity());
+    }
+    ::std::uint64_t last = WriteAheadLog::replay(directory, 1, [](::std::uint64_t, const char*, ::std::size_t) {});
+    GTEST_ASSERT_EQ(last, 103u);
+    {
+        WriteAheadLog log(directory, options);
+        log.rotate();
+        log.append("torn record", 11);
+    }
+    ::std::vector<::std::uint64_t> lastSegment;
+    WriteAheadLog::replay(directory, 104, [&](::std::uint64_t sequence, const char*, ::std::size_t size) {
+        lastSegment.push_back(sequence);
+        GTEST_ASSERT_EQ(size, 11u);
+    });
+    GTEST_ASSERT_EQ(lastSegment, ::std::vector<::std::uint64_t>({104}));
+    // A record cut short by a crash.
+    char segmentName[40];
+    ::std::snprintf(segmentName, sizeof(segmentName), "/segment-%020llu.wal", 104ull);
+    ::truncate((directory + segmentName).c_str(), 20);
+    {
+        WriteAheadLog log(directory, options);
+        GTEST_ASSERT_EQ(log.lastSequence(), 103u);
+        GTEST_ASSERT_EQ(log.append("next", 4), 104u);
+        GTEST_ASSERT_GT(log.truncateBefore(100), 0u);
+    }
+    GTEST_ASSERT_EQ(WriteAheadLog::replay(directory, 100, [](::std::uint64_t, const char*, ::std::size_t) {}), 104u);
+    // A checkpoint past the end of the log, whose last records were lost, keeps their
+    // numbers from being handed out again.
+    {
+        WriteAheadLog log(directory, options, 110);
+        GTEST_ASSERT_EQ(log.lastSequence(), 110u);
+        GTEST_ASSERT_EQ(log.append("after", 5), 111u);
+    }
+    {
+        WriteAheadLog log(directory, options);
+        GTEST_ASSERT_EQ(log.lastSequence(), 111u);
+    }
+    ::std::vector<::std::uint64_t> replayed;
+    WriteAheadLog::replay(directory, 104, [&](::std::uint64_t sequence, const char*, ::std::size_t) {
+        replayed.push_back(sequence);
+    });
+    GTEST_ASSERT_EQ(replayed, ::std::vector<::std::uint64_t>({104, 111}));
+    WriteAheadLog::destroy(directory);
+}
+
+TEST(WriteAheadLogTest, runGroupCommitFromManyWriters) {
+    const ::std::string directory = ::testing::TempDir() + "wal_group_commit";
+    WriteAheadLog::destroy(directory);
+    const int WRITERS = 8, UPDATES = 500;
+    ::std::chrono::duration<double> elapsed;
+    unsigned long long syncs;
+    {
+        DurableMatrixRegistry<unsigned long long> durable(directory);
+        auto start = ::std::chrono::steady_clock::now();
+        ::std::vector<::std::thread> writers;
+        for (int writer = 0; writer < WRITERS; writer++) {
+            writers.emplace_back([&, writer]() {
+                for (int i = 1; i <= UPDATES; i++) durable.store(writer, Matrix4x4::identity() * i);
+            });
+        }
+        for (::std::thread& writer : writers) writer.join();
+        elapsed = ::std::chrono::steady_clock::now() - start;
+        syncs = durable.log().syncCount();
+        GTEST_ASSERT_EQ(durable.log().lastSequence(), static_cast<::std::uint64_t>(WRITERS * UPDATES));
+    }
+    ::std::cout << "Group commit: " << WRITERS * UPDATES / elapsed.count() << " durable updates/s, "
+        << static_cast<double>(WRITERS * UPDATES) / static_cast<double>(syncs) << " updates per sync.\n";
+    DurableMatrixRegistry<unsigned long long> recovered(directory);
+    for (int writer = 0; writer < WRITERS; writer++) {
+        GTEST_ASSERT_TRUE(recovered.registry().load(writer) == Matrix4x4::identity() * UPDATES);
+    }
+    WriteAheadLog::destroy(directory);
+}
+
+TEST(WriteAheadLogTest, runCheckpointsWhileWriting) {
+    // Writers keep storing pairs of keys to equal values in single updates. A checkpoint
+    // taken meanwhile has to hold both of a pair at the same value.
+    const ::std::string directory = ::testing::TempDir() + "wal_checkpoint";
+    WriteAheadLog::destroy(directory);
+    WalOptions options;
+    options.segmentSize = 64 * 1024;
+    options.isSyncing = false;
+    const unsigned long long PAIRS = 500;
+    ::std::vector<DurableMatrixRegistry<unsigned long long>::Update> image;
+    ::std::uint64_t lastSequence;
+    Matrix4x4 expected[2 * PAIRS];
+    {
+        DurableMatrixRegistry<unsigned long long> durable(directory, options);
+        for (unsigned long long key = 0; key < 2 * PAIRS; key++) durable.store(key, Matrix4x4());
+        ::std::atomic<bool> shouldContinue(true);
+        ::std::vector<::std::thread> writers;
+        for (int writer = 0; writer < 2; writer++) {
+            writers.emplace_back([&, writer]() {
+                ::std::mt19937 random(writer);
+                for (double fill = 1.0; shouldContinue.load(); fill++) {
+                    unsigned long long pair = random() % PAIRS;
+                    Matrix4x4 value = Matrix4x4::identity() * fill;
+                    durable.update({{2 * pair, value}, {2 * pair + 1, value}});
+                    if (random() % 50 == 0) durable.erase(2 * pair + 1);
+                    if (random() % 50 == 0) durable.erase(2 * pair);
+                }
+            });
+        }
+        ::std::this_thread::sleep_for(::std::chrono::milliseconds(50));
+        ::std::size_t segmentsBefore = durable.log().segmentCount();
+        ::std::uint64_t cut = durable.checkpointAsync().get();
+        GTEST_ASSERT_EQ(DurableMatrixRegistry<unsigned long long>::readCheckpoint(directory, image), cut);
+        ::std::this_thread::sleep_for(::std::chrono::milliseconds(20));
+        shouldContinue.store(false);
+        for (::std::thread& writer : writers) writer.join();
+        GTEST_ASSERT_GT(segmentsBefore, 1u);
+        GTEST_ASSERT_LT(durable.log().segmentCount(), segmentsBefore);
+        GTEST_ASSERT_EQ(durable.checkpointSequence(), cut);
+        lastSequence = durable.log().lastSequence();
+        for (unsigned long long key = 0; key < 2 * PAIRS; key++) {
+            // Removed keys compare as a value no writer stores.
+            if (!durable.registry().load(key, expected[key])) expected[key] = Matrix4x4::identity() * -1.0;
+        }
+        ::std::cout << "Checkpoint at record " << cut << " of " << lastSequence << ", " << image.size() << " matrices.\n";
+    }
+
+    ::std::map<unsigned long long, Matrix4x4> values;
+    for (const auto& entry : image) values[entry.key] = entry.value;
+    unsigned long long inconsistentPairs = 0;
+    for (unsigned long long pair = 0; pair < PAIRS; pair++) {
+        auto left = values.find(2 * pair), right = values.find(2 * pair + 1);
+        if (left != values.end() && right != values.end() && left->second != right->second) inconsistentPairs++;
+    }
+    GTEST_ASSERT_EQ(inconsistentPairs, 0ull);
+
+    DurableMatrixRegistry<unsigned long long> recovered(directory, options);
+    GTEST_ASSERT_LT(recovered.recoveredRecords(), lastSequence);
+    for (unsigned long long key = 0; key < 2 * PAIRS; key++) {
+        Matrix4x4 value;
+        if (!recovered.registry().load(key, value)) value = Matrix4x4::identity() * -1.0;
+        GTEST_ASSERT_TRUE(value == expected[key]);
+    }
+    WriteAheadLog::destroy(directory);
+}
+
+TEST(SharedLogTest, runFollowerProcessesAgainstLeader) {
+    const unsigned int FOLLOWERS = 2;
+    const ::std::uint64_t KEYS = 1000;
+    const ::std::uint64_t UPDATES = 200000;
+    const ::std::string name = "/necessity-shared-log-" + ::std::to_string(::getpid());
+    SharedLogLeader leader(name, 1024);
+
+    ::std::vector<pid_t> followers;
+    for (unsigned int i = 0; i < FOLLOWERS; i++) {
+        pid_t pid = ::fork();
+        GTEST_ASSERT_GE(pid, 0);
+        if (pid == 0) {
+            // Only async-signal-safe exits from here, the test framework belongs to the parent.
+            bool isCorrect = true;
+            try {
+                SharedLogFollower follower(name);
+                ::std::uint64_t maxLag = 0;
+                auto start = ::std::chrono::high_resolution_clock::now();
+                while (!follower.isDone()) {
+                    maxLag = ::std::max(maxLag, follower.lag());
+                    if (follower.poll() == 0) ::std::this_thread::yield();
+                }
+                auto end = ::std::chrono::high_resolution_clock::now();
+                for (::std::uint64_t key = 0; key < KEYS; key++) {
+                    Matrix4x4 value{};
+                    bool isPresent = follower.replica().load(key, value);
+                    if (key % 10 == 0) {
+                        isCorrect = isCorrect && !isPresent;
+                    } else {
+                        isCorrect = isCorrect && isPresent &&
+                            value == Matrix4x4::identity() * static_cast<double>(UPDATES - KEYS + key);
+                    }
+                }
+                ::std::ostringstream stream;
+                stream << "Follower " << i << " applied " << follower.applied() << " updates at "
+                    << static_cast<double>(follower.applied()) /
+                        ::std::chrono::duration<double>(end - start).count()
+                    << " updates per second, with a lag of at most " << maxLag << " updates.\n";
+                ::std::cout << stream.str() << ::std::flush;
+            } catch (...) {
+                isCorrect = false;
+            }
+            ::_exit(isCorrect ? 0 : 1);
+        }
+        followers.push_back(pid);
+    }
+    while (leader.followerCount() < FOLLOWERS) ::std::this_thread::yield();
+
+    ::std::uint64_t maxLag = 0;
+    auto start = ::std::chrono::high_resolution_clock::now();
+    for (::std::uint64_t i = 0; i < UPDATES; i++) {
+        leader.store(i % KEYS, Matrix4x4::identity() * static_cast<double>(i));
+        if (i % 1024 == 0) maxLag = ::std::max(maxLag, leader.maxLag());
+    }
+    for (::std::uint64_t key = 0; key < KEYS; key += 10) leader.erase(key);
+    auto end = ::std::chrono::high_resolution_clock::now();
+    leader.close();
+
+    for (pid_t pid : followers) {
+        int status = 0;
+        GTEST_ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+        GTEST_ASSERT_TRUE(WIFEXITED(status));
+        GTEST_ASSERT_EQ(WEXITSTATUS(status), 0);
+    }
+    GTEST_ASSERT_EQ(leader.tail(), UPDATES + KEYS / 10);
+    GTEST_ASSERT_LE(maxLag, leader.capacity());
+    GTEST_ASSERT_EQ(leader.followerCount(), 0u);
+    ::std::cout << "The leader appended " << leader.tail() << " updates at "
+        << static_cast<double>(leader.tail()) / ::std::chrono::duration<double>(end - start).count()
+        << " updates per second, waiting " << leader.backpressureWaits()
+        << " times for followers, with a lag of at most " << maxLag << " updates." << ::std::endl;
+
+    // A follower too many is refused.
+    ::std::vector<::std::unique_ptr<SharedLogFollower>> extra;
+    for (unsigned int i = 0; i < SharedLogMapping::MAX_FOLLOWERS; i++) {
+        extra.emplace_back(new SharedLogFollower(name));
+    }
+    EXPECT_THROW(SharedLogFollower follower(name), ::std::length_error);
+    extra.clear();
+
+    // A follower that exits without leaving does not hold the leader back.
+    pid_t crashed = ::fork();
+    GTEST_ASSERT_GE(crashed, 0);
+    if (crashed == 0) {
+        new SharedLogFollower(name);
+        ::_exit(0);
+    }
+    int status = 0;
+    GTEST_ASSERT_EQ(::waitpid(crashed, &status, 0), crashed);
+    GTEST_ASSERT_EQ(leader.followerCount(), 1u);
+    for (::std::uint64_t i = 0; i < 2 * leader.capacity(); i++) leader.erase(i % KEYS);
+    GTEST_ASSERT_EQ(leader.followerCount(), 0u);
+}
+
+TEST(RealtimeTest, runAllocationFreeReader) {
+    const ::std::size_t CYCLES = 100000;
+    const ::std::uint64_t KEYS = 256;
+    RealtimeOptions options;
+    options.readerPriority = 1;
+    RealtimeMode mode(options);
+
+    AtomicMatrix4x4 leftMat = {{1, 2, 3, 4}, {5, 6, 7, 8}, {9, 10, 11, 12}, {13, 14, 15, 16}};
+    AtomicMatrix4x4 rightMat = {{16, 15, 14, 13}, {12, 11, 10, 9}, {8, 7, 6, 5}, {4, 3, 2, 1}};
+    ColumnarRecorder columnar(CYCLES);
+    FailureRecorder failures(16);
+    MatrixRegistry<::std::uint64_t> registry;
+    for (::std::uint64_t key = 0; key < KEYS; key++) registry.insert(key, Matrix4x4::identity() * static_cast<double>(key));
+    SpscRing<Matrix4x4> ring(64);
+    ::std::vector<double> latencies(CYCLES);
+    columnar.prefault();
+    failures.prefault();
+    ring.prefault();
+    prefaultMemory(latencies.data(), latencies.size() * sizeof(double));
+
+    bool isFifo = false;
+    unsigned long long allocations = 0;
+    double checksum = 0.0;
+    ::std::thread reader([&]() {
+        isFifo = mode.enterReader(0);
+        unsigned long long before = threadAllocations;
+        for (::std::size_t i = 0; i < CYCLES; i++) {
+            auto start = ::std::chrono::steady_clock::now();
+            Matrix4x4 left = leftMat.snapshot(), right = rightMat.snapshot();
+            Matrix4x4 dotProduct = left * right;
+            columnar.record(left, right, dotProduct);
+            failures.record(left, right, dotProduct);
+            Matrix4x4 stored;
+            registry.load(i % KEYS, stored);
+            ring.tryPush(stored);
+            ring.publish();
+            ring.consume([&](const Matrix4x4& item) { checksum += item.data[0]; });
+            latencies[i] = ::std::chrono::duration<double, ::std::micro>(::std::chrono::steady_clock::now() - start).count();
+        }
+        allocations = threadAllocations - before;
+    });
+    reader.join();
+
+    GTEST_ASSERT_EQ(allocations, 0u);
+    GTEST_ASSERT_EQ(columnar.size(), CYCLES);
+    GTEST_ASSERT_EQ(columnar.verify(), CYCLES);
+    GTEST_ASSERT_EQ(failures.failed(), 0u);
+    GTEST_ASSERT_EQ(checksum, static_cast<double>((CYCLES / KEYS) * (KEYS * (KEYS - 1) / 2)) +
+        static_cast<double>(((CYCLES % KEYS) * (CYCLES % KEYS - 1)) / 2));
+    ::std::sort(latencies.begin(), latencies.end());
+    ::std::cout << "Memory locked: " << (mode.isMemoryLocked() ? "yes" : "no")
+        << ", reader under SCHED_FIFO: " << (isFifo ? "yes" : "no")
+        << ". Latency of a snapshot, multiply and record cycle: " << latencies[CYCLES / 2] << " us median, "
+        << latencies[CYCLES * 99 / 100] << " us at the 99th percentile, " << latencies.back() << " us at most."
+        << ::std::endl;
 }
\ No newline at end of file
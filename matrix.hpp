@@ -35,6 +35,446 @@ SOFTWARE.
 #include <initializer_list>
 #include <stdexcept>
 #include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+/// @brief A description of a 4x4 matrix containing plain values.
+/// Used as a snapshot of an `AtomicMatrix4x4` that can be worked on without atomics.
+struct alignas(32) Matrix4x4 {
+    /// @brief The row-major container for the matrix components.
+    double data[16];
+
+    /// @brief Get the reference to the element in the specified index.
+    /// @param rowIndex The row-index of the element to be accessed.
+    /// @param colIndex The column-index of the element to be accessed.
+    /// @return The reference at the specified index.
+    inline double& operator()(unsigned int rowIndex, unsigned int colIndex) {
+        if (rowIndex >= 4 || colIndex >= 4) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return data[rowIndex * 4 + colIndex];
+    }
+    /// @brief Get the value of the element in the specified index.
+    /// @param rowIndex The row-index of the element to be accessed.
+    /// @param colIndex The column-index of the element to be accessed.
+    /// @return The value at the specified index.
+    inline double operator()(unsigned int rowIndex, unsigned int colIndex) const {
+        if (rowIndex >= 4 || colIndex >= 4) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return data[rowIndex * 4 + colIndex];
+    }
+
+    /// @brief The identity matrix.
+    inline static Matrix4x4 identity() {
+        return {{1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0, 1.0}};
+    }
+};
+
+/// @brief The equality comparator.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The equality value.
+inline bool operator==(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    for (int i = 0; i < 16; i++) {
+        if (leftMat.data[i] != rightMat.data[i]) return false;
+    }
+    return true;
+}
+
+/// @brief The inequality comparator.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The inequality value.
+inline bool operator!=(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    return !(leftMat == rightMat);
+}
+
+/// @brief Elementwise addition, on single values or on 4-value vectors.
+struct ElementwiseSum {
+    inline double operator()(double left, double right) const { return left + right; }
+#if defined(__AVX__)
+    inline __m256d operator()(__m256d left, __m256d right) const { return _mm256_add_pd(left, right); }
+#endif
+};
+/// @brief Elementwise subtraction, on single values or on 4-value vectors.
+struct ElementwiseDifference {
+    inline double operator()(double left, double right) const { return left - right; }
+#if defined(__AVX__)
+    inline __m256d operator()(__m256d left, __m256d right) const { return _mm256_sub_pd(left, right); }
+#endif
+};
+/// @brief Elementwise multiplication, on single values or on 4-value vectors.
+struct ElementwiseProduct {
+    inline double operator()(double left, double right) const { return left * right; }
+#if defined(__AVX__)
+    inline __m256d operator()(__m256d left, __m256d right) const { return _mm256_mul_pd(left, right); }
+#endif
+};
+/// @brief Elementwise linear interpolation, `left + t (right - left)`.
+struct ElementwiseLerp {
+    /// @brief Construct with the interpolation parameter.
+    /// @param t The interpolation parameter. 0 gives `left` and 1 gives `right`.
+    inline explicit ElementwiseLerp(double t) : _t(t) {
+#if defined(__AVX__)
+        _broadcastT = _mm256_set1_pd(t);
+#endif
+    }
+    inline double operator()(double left, double right) const { return left + _t * (right - left); }
+#if defined(__AVX__)
+    inline __m256d operator()(__m256d left, __m256d right) const {
+        return _mm256_add_pd(left, _mm256_mul_pd(_broadcastT, _mm256_sub_pd(right, left)));
+    }
+#endif
+
+private:
+    /// @brief The interpolation parameter.
+    double _t;
+#if defined(__AVX__)
+    /// @brief The interpolation parameter in every lane.
+    __m256d _broadcastT;
+#endif
+};
+
+/// @brief Combine two matrices element by element.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param operation The elementwise operation, such as `ElementwiseSum`.
+/// @return The combined matrix.
+template <typename Operation>
+inline Matrix4x4 elementwise(const Matrix4x4& leftMat, const Matrix4x4& rightMat, const Operation& operation) {
+    Matrix4x4 result;
+#if defined(__AVX__)
+    for (int i = 0; i < 16; i += 4) {
+        _mm256_store_pd(result.data + i,
+            operation(_mm256_load_pd(leftMat.data + i), _mm256_load_pd(rightMat.data + i)));
+    }
+#else
+    for (int i = 0; i < 16; i++) result.data[i] = operation(leftMat.data[i], rightMat.data[i]);
+#endif
+    return result;
+}
+/// @brief Combine arrays of matrices element by element.
+/// @param leftMats The left hand-side matrices.
+/// @param rightMats The right hand-side matrices.
+/// @param results The combined matrices. May alias either input.
+/// @param count The number of matrices in each array.
+/// @param operation The elementwise operation, such as `ElementwiseSum`.
+template <typename Operation>
+inline void elementwiseBatch(const Matrix4x4* leftMats, const Matrix4x4* rightMats, Matrix4x4* results,
+    ::std::size_t count, const Operation& operation) {
+    for (::std::size_t i = 0; i < count; i++) {
+        results[i] = elementwise(leftMats[i], rightMats[i], operation);
+    }
+}
+
+/// @brief The elementwise sum.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The sum.
+inline Matrix4x4 operator+(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    return elementwise(leftMat, rightMat, ElementwiseSum());
+}
+/// @brief The elementwise difference.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The difference.
+inline Matrix4x4 operator-(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    return elementwise(leftMat, rightMat, ElementwiseDifference());
+}
+/// @brief The elementwise (Hadamard) product.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The Hadamard product.
+inline Matrix4x4 hadamard(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    return elementwise(leftMat, rightMat, ElementwiseProduct());
+}
+/// @brief The linear interpolation between two matrices.
+/// @param leftMat The matrix at `t = 0`.
+/// @param rightMat The matrix at `t = 1`.
+/// @param t The interpolation parameter.
+/// @return The interpolated matrix.
+inline Matrix4x4 lerp(const Matrix4x4& leftMat, const Matrix4x4& rightMat, double t) {
+    return elementwise(leftMat, rightMat, ElementwiseLerp(t));
+}
+
+/// @brief Scale every element of a matrix.
+/// @param scalar The scale factor.
+/// @param mat The matrix.
+/// @return The scaled matrix.
+inline Matrix4x4 operator*(double scalar, const Matrix4x4& mat) {
+    Matrix4x4 result;
+#if defined(__AVX__)
+    __m256d factor = _mm256_set1_pd(scalar);
+    for (int i = 0; i < 16; i += 4) {
+        _mm256_store_pd(result.data + i, _mm256_mul_pd(factor, _mm256_load_pd(mat.data + i)));
+    }
+#else
+    for (int i = 0; i < 16; i++) result.data[i] = scalar * mat.data[i];
+#endif
+    return result;
+}
+/// @brief Scale every element of a matrix.
+/// @param mat The matrix.
+/// @param scalar The scale factor.
+/// @return The scaled matrix.
+inline Matrix4x4 operator*(const Matrix4x4& mat, double scalar) {
+    return scalar * mat;
+}
+/// @brief Scale every element of an array of matrices.
+/// @param mats The matrices.
+/// @param scalar The scale factor.
+/// @param results The scaled matrices. May alias `mats`.
+/// @param count The number of matrices.
+inline void scaleBatch(const Matrix4x4* mats, double scalar, Matrix4x4* results, ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = scalar * mats[i];
+}
+/// @brief The transpose operation.
+/// @param mat The matrix.
+/// @return The transposed matrix.
+inline Matrix4x4 transpose(const Matrix4x4& mat) {
+    Matrix4x4 result;
+#if defined(__AVX__)
+    __m256d row0 = _mm256_load_pd(mat.data), row1 = _mm256_load_pd(mat.data + 4);
+    __m256d row2 = _mm256_load_pd(mat.data + 8), row3 = _mm256_load_pd(mat.data + 12);
+    __m256d low01 = _mm256_unpacklo_pd(row0, row1), high01 = _mm256_unpackhi_pd(row0, row1);
+    __m256d low23 = _mm256_unpacklo_pd(row2, row3), high23 = _mm256_unpackhi_pd(row2, row3);
+    _mm256_store_pd(result.data, _mm256_permute2f128_pd(low01, low23, 0x20));
+    _mm256_store_pd(result.data + 4, _mm256_permute2f128_pd(high01, high23, 0x20));
+    _mm256_store_pd(result.data + 8, _mm256_permute2f128_pd(low01, low23, 0x31));
+    _mm256_store_pd(result.data + 12, _mm256_permute2f128_pd(high01, high23, 0x31));
+#else
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) result.data[col * 4 + row] = mat.data[row * 4 + col];
+    }
+#endif
+    return result;
+}
+
+/// @brief The sum of the diagonal elements.
+/// @param mat The matrix.
+/// @return The trace.
+inline double trace(const Matrix4x4& mat) {
+    return (mat.data[0] + mat.data[5]) + (mat.data[10] + mat.data[15]);
+}
+/// @brief The square root of the sum of the squares of the elements.
+/// @param mat The matrix.
+/// @return The Frobenius norm.
+inline double frobeniusNorm(const Matrix4x4& mat) {
+#if defined(__AVX__)
+    __m256d squares = _mm256_setzero_pd();
+    for (int i = 0; i < 16; i += 4) {
+        __m256d row = _mm256_load_pd(mat.data + i);
+        squares = _mm256_add_pd(squares, _mm256_mul_pd(row, row));
+    }
+    __m128d halves = _mm_add_pd(_mm256_castpd256_pd128(squares), _mm256_extractf128_pd(squares, 1));
+    return ::std::sqrt(_mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves))));
+#else
+    double lanes[4] = {0.0, 0.0, 0.0, 0.0};
+    for (int i = 0; i < 16; i++) lanes[i % 4] += mat.data[i] * mat.data[i];
+    return ::std::sqrt((lanes[0] + lanes[2]) + (lanes[1] + lanes[3]));
+#endif
+}
+/// @brief The largest absolute value among the elements.
+/// @param mat The matrix.
+/// @return The max-abs norm.
+inline double maxAbs(const Matrix4x4& mat) {
+#if defined(__AVX__)
+    // Clearing the sign bit gives the absolute value.
+    __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d largest = _mm256_setzero_pd();
+    for (int i = 0; i < 16; i += 4) {
+        largest = _mm256_max_pd(largest, _mm256_andnot_pd(signMask, _mm256_load_pd(mat.data + i)));
+    }
+    __m128d halves = _mm_max_pd(_mm256_castpd256_pd128(largest), _mm256_extractf128_pd(largest, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(halves, _mm_unpackhi_pd(halves, halves)));
+#else
+    double largest = 0.0;
+    for (int i = 0; i < 16; i++) largest = ::std::fmax(largest, ::std::fabs(mat.data[i]));
+    return largest;
+#endif
+}
+
+/// @brief The determinant, by Laplace expansion along the top two rows.
+/// @param mat The matrix.
+/// @return The determinant.
+inline double determinant(const Matrix4x4& mat) {
+    const double* m = mat.data;
+    // The 2x2 minors of the top two rows and of the bottom two rows, by pair of columns.
+    double s0 = m[0] * m[5] - m[1] * m[4], s1 = m[0] * m[6] - m[2] * m[4], s2 = m[0] * m[7] - m[3] * m[4];
+    double s3 = m[1] * m[6] - m[2] * m[5], s4 = m[1] * m[7] - m[3] * m[5], s5 = m[2] * m[7] - m[3] * m[6];
+    double c0 = m[8] * m[13] - m[9] * m[12], c1 = m[8] * m[14] - m[10] * m[12], c2 = m[8] * m[15] - m[11] * m[12];
+    double c3 = m[9] * m[14] - m[10] * m[13], c4 = m[9] * m[15] - m[11] * m[13], c5 = m[10] * m[15] - m[11] * m[14];
+    return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+/// @brief The inverse, as the adjugate over the determinant.
+/// @param mat The matrix, which has to be invertible.
+/// @return The inverse.
+inline Matrix4x4 inverse(const Matrix4x4& mat) {
+    const double* m = mat.data;
+    double s0 = m[0] * m[5] - m[1] * m[4], s1 = m[0] * m[6] - m[2] * m[4], s2 = m[0] * m[7] - m[3] * m[4];
+    double s3 = m[1] * m[6] - m[2] * m[5], s4 = m[1] * m[7] - m[3] * m[5], s5 = m[2] * m[7] - m[3] * m[6];
+    double c0 = m[8] * m[13] - m[9] * m[12], c1 = m[8] * m[14] - m[10] * m[12], c2 = m[8] * m[15] - m[11] * m[12];
+    double c3 = m[9] * m[14] - m[10] * m[13], c4 = m[9] * m[15] - m[11] * m[13], c5 = m[10] * m[15] - m[11] * m[14];
+    double det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (det == 0.0 || !::std::isfinite(det)) {
+        throw ::std::domain_error("The matrix is singular.");
+    }
+    double scale = 1.0 / det;
+    Matrix4x4 result;
+    double* r = result.data;
+    r[0] = (m[5] * c5 - m[6] * c4 + m[7] * c3) * scale;
+    r[1] = (-m[1] * c5 + m[2] * c4 - m[3] * c3) * scale;
+    r[2] = (m[13] * s5 - m[14] * s4 + m[15] * s3) * scale;
+    r[3] = (-m[9] * s5 + m[10] * s4 - m[11] * s3) * scale;
+    r[4] = (-m[4] * c5 + m[6] * c2 - m[7] * c1) * scale;
+    r[5] = (m[0] * c5 - m[2] * c2 + m[3] * c1) * scale;
+    r[6] = (-m[12] * s5 + m[14] * s2 - m[15] * s1) * scale;
+    r[7] = (m[8] * s5 - m[10] * s2 + m[11] * s1) * scale;
+    r[8] = (m[4] * c4 - m[5] * c2 + m[7] * c0) * scale;
+    r[9] = (-m[0] * c4 + m[1] * c2 - m[3] * c0) * scale;
+    r[10] = (m[12] * s4 - m[13] * s2 + m[15] * s0) * scale;
+    r[11] = (-m[8] * s4 + m[9] * s2 - m[11] * s0) * scale;
+    r[12] = (-m[4] * c3 + m[5] * c1 - m[6] * c0) * scale;
+    r[13] = (m[0] * c3 - m[1] * c1 + m[2] * c0) * scale;
+    r[14] = (-m[12] * s3 + m[13] * s1 - m[14] * s0) * scale;
+    r[15] = (m[8] * s3 - m[9] * s1 + m[10] * s0) * scale;
+    return result;
+}
+
+/// @brief The traces of an array of matrices.
+/// @param mats The matrices.
+/// @param results The traces.
+/// @param count The number of matrices.
+inline void traceBatch(const Matrix4x4* mats, double* results, ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = trace(mats[i]);
+}
+/// @brief The Frobenius norms of an array of matrices.
+/// @param mats The matrices.
+/// @param results The Frobenius norms.
+/// @param count The number of matrices.
+inline void frobeniusNormBatch(const Matrix4x4* mats, double* results, ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = frobeniusNorm(mats[i]);
+}
+/// @brief The max-abs norms of an array of matrices.
+/// @param mats The matrices.
+/// @param results The max-abs norms.
+/// @param count The number of matrices.
+inline void maxAbsBatch(const Matrix4x4* mats, double* results, ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = maxAbs(mats[i]);
+}
+
+/// @brief The dot product operation.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @return The dot product.
+inline Matrix4x4 operator*(const Matrix4x4& leftMat, const Matrix4x4& rightMat) {
+    Matrix4x4 dotProductMatrix;
+#if defined(__AVX__)
+    // Each row of the product is a combination of the rows of rightMat, weighted
+    // by the elements of the same row of leftMat.
+    __m256d rightRows[4] = {
+        _mm256_load_pd(rightMat.data), _mm256_load_pd(rightMat.data + 4),
+        _mm256_load_pd(rightMat.data + 8), _mm256_load_pd(rightMat.data + 12)
+    };
+    for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+        const double* leftRow = leftMat.data + rowIndex * 4;
+        __m256d row = _mm256_mul_pd(_mm256_broadcast_sd(leftRow), rightRows[0]);
+        row = _mm256_add_pd(row, _mm256_mul_pd(_mm256_broadcast_sd(leftRow + 1), rightRows[1]));
+        row = _mm256_add_pd(row, _mm256_mul_pd(_mm256_broadcast_sd(leftRow + 2), rightRows[2]));
+        row = _mm256_add_pd(row, _mm256_mul_pd(_mm256_broadcast_sd(leftRow + 3), rightRows[3]));
+        _mm256_store_pd(dotProductMatrix.data + rowIndex * 4, row);
+    }
+#else
+    for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+        for (int colIndex = 0; colIndex < 4; colIndex++) {
+            double dotProduct = 0.0;
+            for (int i = 0; i < 4; i++) {
+                dotProduct += leftMat.data[rowIndex * 4 + i] * rightMat.data[i * 4 + colIndex];
+            }
+            dotProductMatrix.data[rowIndex * 4 + colIndex] = dotProduct;
+        }
+    }
+#endif
+    return dotProductMatrix;
+}
+/// @brief The dot products of arrays of matrices.
+/// @param leftMats The left hand-side matrices.
+/// @param rightMats The right hand-side matrices.
+/// @param results The dot products. May alias either input.
+/// @param count The number of matrices in each array.
+inline void multiplyBatch(const Matrix4x4* leftMats, const Matrix4x4* rightMats, Matrix4x4* results,
+    ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = leftMats[i] * rightMats[i];
+}
+
+/// @brief Raise a matrix to a power by repeated squaring.
+/// Takes O(log exponent) products instead of O(exponent).
+/// @param mat The base matrix.
+/// @param exponent The exponent. The zeroth power is the identity.
+/// @return The power.
+inline Matrix4x4 power(const Matrix4x4& mat, unsigned long long exponent) {
+    Matrix4x4 result = Matrix4x4::identity();
+    Matrix4x4 square = mat;
+    while (exponent != 0) {
+        if (exponent & 1ULL) result = result * square;
+        exponent >>= 1;
+        if (exponent != 0) square = square * square;
+    }
+    return result;
+}
+/// @brief Raise an array of matrices to powers.
+/// @param mats The base matrices.
+/// @param exponents The exponent for each matrix.
+/// @param results The powers. May alias `mats`.
+/// @param count The number of matrices.
+inline void powerBatch(const Matrix4x4* mats, const unsigned long long* exponents, Matrix4x4* results,
+    ::std::size_t count) {
+    for (::std::size_t i = 0; i < count; i++) results[i] = power(mats[i], exponents[i]);
+}
+
+/// @brief Raise a row-stochastic matrix, such as a Markov chain transition matrix, to a power.
+///
+/// Powers of a mixing chain converge to the matrix whose rows are all the stationary
+/// distribution. Once squaring no longer changes the matrix by more than `tolerance`,
+/// every further square is the same limit, so the remaining squarings are skipped.
+/// Chains that never converge, such as periodic ones, take the regular path.
+/// @param transition The row-stochastic matrix.
+/// @param exponent The exponent.
+/// @param tolerance The largest change of an element that counts as converged.
+/// @return The power.
+inline Matrix4x4 powerStochastic(const Matrix4x4& transition, unsigned long long exponent, double tolerance = 1e-15) {
+    for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+        const double* row = transition.data + rowIndex * 4;
+        if (row[0] < 0.0 || row[1] < 0.0 || row[2] < 0.0 || row[3] < 0.0 ||
+            ::std::fabs((row[0] + row[1]) + (row[2] + row[3]) - 1.0) > 1e-12) {
+            throw ::std::invalid_argument("The matrix is not row-stochastic.");
+        }
+    }
+
+    Matrix4x4 result = Matrix4x4::identity();
+    Matrix4x4 square = transition;
+    while (exponent != 0) {
+        if (exponent & 1ULL) result = result * square;
+        exponent >>= 1;
+        if (exponent == 0) break;
+
+        Matrix4x4 nextSquare = square * square;
+        if (maxAbs(nextSquare - square) <= tolerance) {
+            // Every remaining square equals the limit, and the limit is idempotent.
+            return result * nextSquare;
+        }
+        square = nextSquare;
+    }
+    return result;
+}
 
 /// @brief A description of a 4x4 matrix containing atomic values.
 class AtomicMatrix4x4 final {
@@ -96,6 +536,34 @@ public:
         return _data[rowIndex][colIndex];
     }
 
+    /// @brief Construct from a plain matrix.
+    /// @param values The plain matrix where data is being copied from.
+    inline explicit AtomicMatrix4x4(const Matrix4x4& values) {
+        store(values);
+    }
+
+    /// @brief Load every element into a plain matrix.
+    /// Each element is loaded atomically, but not all of them at the same instant.
+    /// @return The plain matrix.
+    inline Matrix4x4 snapshot() const {
+        Matrix4x4 values;
+        for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+            for (int colIndex = 0; colIndex < 4; colIndex++) {
+                values.data[rowIndex * 4 + colIndex] = _data[rowIndex][colIndex].load();
+            }
+        }
+        return values;
+    }
+    /// @brief Store every element of a plain matrix.
+    /// @param values The plain matrix where data is being copied from.
+    inline void store(const Matrix4x4& values) {
+        for (int rowIndex = 0; rowIndex < 4; rowIndex++) {
+            for (int colIndex = 0; colIndex < 4; colIndex++) {
+                _data[rowIndex][colIndex].store(values.data[rowIndex * 4 + colIndex]);
+            }
+        }
+    }
+
     /// @brief Copy constructor.
     /// @param other The other instance where data is being copied from.
     inline AtomicMatrix4x4(const AtomicMatrix4x4& other) {
@@ -170,6 +638,159 @@ inline bool operator!=(const AtomicMatrix4x4& leftMat, const AtomicMatrix4x4& ri
     return !(leftMat == rightMat);
 }
 
+/// @brief Probabilistic verification of matrix products with Freivalds' algorithm.
+///
+/// Instead of recomputing `C = A B`, each trial checks `A (B x) == C x` for a random
+/// vector `x`, which takes O(n^2) instead of O(n^3) operations. With a vector of zeros and
+/// ones, a wrong product passes a trial with a probability of at most 1/2, so the number
+/// of trials follows from the accepted probability of missing a wrong product. 4x4
+/// matrices, where that many trials would cost more than the product, get a single trial
+/// with a vector of random reals instead, which a wrong product only passes if its error
+/// happens to map the vector to zero.
+class FreivaldsVerifier final {
+public:
+    /// @brief Construct the verifier.
+    /// @param errorBound The accepted probability of accepting a wrong n x n product.
+    /// @param tolerance The accepted difference between `A (B x)` and `C x`, relative to their
+    /// magnitude. Zero rejects correct products whose rounding differs.
+    /// @param seed The seed of the random vectors.
+    inline explicit FreivaldsVerifier(double errorBound = 1e-6, double tolerance = 1e-12,
+        ::std::uint64_t seed = ::std::random_device()()) :
+    _trials(trialsFor(errorBound)), _tolerance(tolerance), _engine(seed), _element(1.0, 2.0) {
+        if (!(tolerance >= 0.0)) {
+            throw ::std::invalid_argument("The tolerance cannot be negative.");
+        }
+    }
+
+    /// @brief The number of trials needed for an error bound.
+    /// @param errorBound The accepted probability of accepting a wrong product, in (0, 1).
+    /// @return The number of trials.
+    inline static unsigned int trialsFor(double errorBound) {
+        if (!(errorBound > 0.0 && errorBound < 1.0)) {
+            throw ::std::invalid_argument("The error bound must be between 0 and 1.");
+        }
+        return static_cast<unsigned int>(::std::ceil(-::std::log2(errorBound)));
+    }
+    /// @brief The number of trials per verification of n x n matrices.
+    inline unsigned int trials() const { return _trials; }
+
+    /// @brief Determines if `dotProduct` is, with high probability, `leftMat * rightMat`.
+    /// Takes 48 multiplications, against the 64 of recomputing the product.
+    /// @param leftMat The left hand-side matrix.
+    /// @param rightMat The right hand-side matrix.
+    /// @param dotProduct The dot product to be verified.
+    /// @return False if the product is certainly wrong.
+    inline bool verify(const Matrix4x4& leftMat, const Matrix4x4& rightMat, const Matrix4x4& dotProduct) {
+        // Only 15 vectors of zeros and ones tell products apart, so repeated trials would
+        // mostly repeat each other.
+        alignas(32) double x[4];
+        for (double& element : x) element = _element(_engine);
+        return verifyTrial(leftMat, rightMat, dotProduct, x);
+    }
+    /// @brief Verify arrays of products.
+    /// @param leftMats The left hand-side matrices.
+    /// @param rightMats The right hand-side matrices.
+    /// @param dotProducts The dot products to be verified.
+    /// @param results Whether each product passed.
+    /// @param count The number of products.
+    /// @return The number of products that passed.
+    inline ::std::size_t verifyBatch(const Matrix4x4* leftMats, const Matrix4x4* rightMats,
+        const Matrix4x4* dotProducts, bool* results, ::std::size_t count) {
+        ::std::size_t passed = 0;
+        for (::std::size_t i = 0; i < count; i++) {
+            results[i] = verify(leftMats[i], rightMats[i], dotProducts[i]);
+            if (results[i]) passed++;
+        }
+        return passed;
+    }
+    /// @brief Determines if `dotProduct` is, with high probability, `leftMat * rightMat` for n x n matrices.
+    /// @param size The dimension n.
+    /// @param leftMat The row-major left hand-side matrix.
+    /// @param rightMat The row-major right hand-side matrix.
+    /// @param dotProduct The row-major dot product to be verified.
+    /// @return False if the product is certainly wrong.
+    inline bool verify(::std::size_t size, const double* leftMat, const double* rightMat, const double* dotProduct) {
+        ::std::vector<double> x(size), rightX(size);
+        ::std::bernoulli_distribution coin(0.5);
+        for (unsigned int trial = 0; trial < _trials; trial++) {
+            for (double& element : x) element = coin(_engine) ? 1.0 : 0.0;
+            multiplyVector(size, rightMat, x.data(), rightX.data());
+            for (::std::size_t row = 0; row < size; row++) {
+                double leftRightX = dot(size, leftMat + row * size, rightX.data());
+                double productX = dot(size, dotProduct + row * size, x.data());
+                if (!isClose(leftRightX, productX)) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    /// @brief Determines if two results are equal within the tolerance.
+    inline bool isClose(double left, double right) const {
+        if (left == right) return true;
+        double scale = ::std::fmax(1.0, ::std::fmax(::std::fabs(left), ::std::fabs(right)));
+        return ::std::fabs(left - right) <= _tolerance * scale;
+    }
+
+    /// @brief One trial on 4x4 matrices.
+    inline bool verifyTrial(const Matrix4x4& leftMat, const Matrix4x4& rightMat, const Matrix4x4& dotProduct,
+        const double* x) const {
+        alignas(32) double rightX[4], leftRightX[4], productX[4];
+        multiplyVector(rightMat, x, rightX);
+        multiplyVector(leftMat, rightX, leftRightX);
+        multiplyVector(dotProduct, x, productX);
+        for (int i = 0; i < 4; i++) {
+            if (!isClose(leftRightX[i], productX[i])) return false;
+        }
+        return true;
+    }
+    /// @brief The 4x4 matrix-vector product.
+    inline static void multiplyVector(const Matrix4x4& mat, const double* x, double* result) {
+#if defined(__AVX__)
+        __m256d vector = _mm256_load_pd(x);
+        __m256d row0 = _mm256_mul_pd(_mm256_load_pd(mat.data), vector);
+        __m256d row1 = _mm256_mul_pd(_mm256_load_pd(mat.data + 4), vector);
+        __m256d row2 = _mm256_mul_pd(_mm256_load_pd(mat.data + 8), vector);
+        __m256d row3 = _mm256_mul_pd(_mm256_load_pd(mat.data + 12), vector);
+        // Pairwise sums: [r0 01, r1 01, r0 23, r1 23] and [r2 01, r3 01, r2 23, r3 23].
+        __m256d sums01 = _mm256_hadd_pd(row0, row1);
+        __m256d sums23 = _mm256_hadd_pd(row2, row3);
+        __m256d low = _mm256_permute2f128_pd(sums01, sums23, 0x20);
+        __m256d high = _mm256_permute2f128_pd(sums01, sums23, 0x31);
+        _mm256_store_pd(result, _mm256_add_pd(low, high));
+#else
+        for (int row = 0; row < 4; row++) {
+            const double* values = mat.data + row * 4;
+            result[row] = (values[0] * x[0] + values[1] * x[1]) + (values[2] * x[2] + values[3] * x[3]);
+        }
+#endif
+    }
+    /// @brief The n x n matrix-vector product.
+    inline static void multiplyVector(::std::size_t size, const double* mat, const double* x, double* result) {
+        for (::std::size_t row = 0; row < size; row++) result[row] = dot(size, mat + row * size, x);
+    }
+    /// @brief The dot product of two n-vectors.
+    inline static double dot(::std::size_t size, const double* left, const double* right) {
+        double sums[4] = {0.0, 0.0, 0.0, 0.0};
+        ::std::size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            for (int lane = 0; lane < 4; lane++) sums[lane] += left[i + lane] * right[i + lane];
+        }
+        for (; i < size; i++) sums[0] += left[i] * right[i];
+        return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    }
+
+private:
+    /// @brief The number of trials per verification.
+    unsigned int _trials;
+    /// @brief The accepted relative difference.
+    double _tolerance;
+    /// @brief The source of the random vectors.
+    ::std::mt19937_64 _engine;
+    /// @brief The distribution of the elements of the real vectors.
+    ::std::uniform_real_distribution<double> _element;
+};
+
 /// @brief The object that records and evaluates a matrix multiplication..
 class MultiplicationRecorder {
 public:
@@ -185,6 +806,12 @@ public:
     inline bool isCorrect() const {
         return _dotProduct == _leftMat * _rightMat;
     }
+    /// @brief Determines if the calculation is correct with Freivalds' algorithm, within
+    /// the tolerance of the verifier. 48 multiplications against the 64 of `isCorrect`.
+    /// @param verifier The verifier to be used.
+    inline bool isProbablyCorrect(FreivaldsVerifier& verifier) const {
+        return verifier.verify(_leftMat.snapshot(), _rightMat.snapshot(), _dotProduct.snapshot());
+    }
 
     /// @brief Copy constructor. 
     /// @param other The other instance where data is being copied from.
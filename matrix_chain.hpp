@@ -0,0 +1,214 @@
+/*
+
+File: matrix_chain.hpp
+Author: Aldhinn Espinas
+Description: This file contains the declarations for multiplying chains of dense matrices
+    in the order that needs the fewest operations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(MATRIX_CHAIN_HEADER_FILE)
+#define MATRIX_CHAIN_HEADER_FILE
+
+#include <cstddef>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "dense_matrix.hpp"
+
+/// @brief The order a chain of matrices is multiplied in.
+struct ChainPlan {
+    /// @brief A product of two operands. Operands below `count` are the matrices of the
+    /// chain, and operand `count + i` is the result of `products[i]`.
+    struct Product {
+        /// @brief The left hand-side operand.
+        ::std::size_t left;
+        /// @brief The right hand-side operand.
+        ::std::size_t right;
+    };
+
+    /// @brief The number of matrices of the chain.
+    ::std::size_t count;
+    /// @brief The products, each after the products it uses. The last one is the whole chain.
+    ::std::vector<Product> products;
+    /// @brief The number of scalar multiplications of the plan.
+    double multiplications;
+
+    /// @brief The operand holding the product of the whole chain.
+    inline ::std::size_t root() const {
+        return products.empty() ? 0 : count + products.size() - 1;
+    }
+    /// @brief The parenthesization, such as `((A0 A1) A2)`.
+    inline ::std::string toString() const {
+        return count == 0 ? "" : toString(root());
+    }
+
+private:
+    /// @brief The parenthesization of an operand.
+    inline ::std::string toString(::std::size_t operand) const {
+        if (operand < count) return "A" + ::std::to_string(operand);
+        const Product& product = products[operand - count];
+        return "(" + toString(product.left) + " " + toString(product.right) + ")";
+    }
+};
+
+/// @brief The chains up to this length are planned optimally, longer ones with a heuristic.
+constexpr ::std::size_t CHAIN_OPTIMAL_LIMIT = 256;
+
+/// @brief Find the parenthesization needing the fewest scalar multiplications, by dynamic
+/// programming in O(n^3).
+/// @param dims The dimensions, matrix `i` being `dims[i]` x `dims[i + 1]`.
+/// @return The plan.
+inline ChainPlan planChainOptimal(const ::std::vector<::std::size_t>& dims) {
+    const ::std::size_t count = dims.empty() ? 0 : dims.size() - 1;
+    ChainPlan plan = {count, {}, 0.0};
+    if (count < 2) return plan;
+    // cost[i * count + j] is the cheapest product of the matrices i to j, split after split[i * count + j].
+    ::std::vector<double> cost(count * count, 0.0);
+    ::std::vector<::std::size_t> split(count * count, 0);
+    for (::std::size_t length = 2; length <= count; length++) {
+        for (::std::size_t i = 0; i + length <= count; i++) {
+            ::std::size_t j = i + length - 1;
+            double best = ::std::numeric_limits<double>::infinity();
+            for (::std::size_t k = i; k < j; k++) {
+                double candidate = cost[i * count + k] + cost[(k + 1) * count + j] +
+                    static_cast<double>(dims[i]) * static_cast<double>(dims[k + 1]) * static_cast<double>(dims[j + 1]);
+                if (candidate < best) {
+                    best = candidate;
+                    split[i * count + j] = k;
+                }
+            }
+            cost[i * count + j] = best;
+        }
+    }
+    plan.multiplications = cost[count - 1];
+
+    // Products are emitted after their operands.
+    auto build = [&](auto&& self, ::std::size_t i, ::std::size_t j) -> ::std::size_t {
+        if (i == j) return i;
+        ::std::size_t k = split[i * count + j];
+        ::std::size_t left = self(self, i, k);
+        ::std::size_t right = self(self, k + 1, j);
+        plan.products.push_back({left, right});
+        return count + plan.products.size() - 1;
+    };
+    build(build, 0, count - 1);
+    return plan;
+}
+
+/// @brief Find a cheap parenthesization in O(n^2), by repeatedly multiplying the
+/// adjacent pair that costs the least.
+/// @param dims The dimensions, matrix `i` being `dims[i]` x `dims[i + 1]`.
+/// @return The plan.
+inline ChainPlan planChainGreedy(const ::std::vector<::std::size_t>& dims) {
+    const ::std::size_t count = dims.empty() ? 0 : dims.size() - 1;
+    ChainPlan plan = {count, {}, 0.0};
+    ::std::vector<::std::size_t> operands(count);
+    for (::std::size_t i = 0; i < count; i++) operands[i] = i;
+    ::std::vector<::std::size_t> bounds(dims);
+    while (operands.size() > 1) {
+        ::std::size_t best = 0;
+        double bestCost = ::std::numeric_limits<double>::infinity();
+        for (::std::size_t i = 0; i + 1 < operands.size(); i++) {
+            double candidate = static_cast<double>(bounds[i]) * static_cast<double>(bounds[i + 1]) *
+                static_cast<double>(bounds[i + 2]);
+            if (candidate < bestCost) {
+                bestCost = candidate;
+                best = i;
+            }
+        }
+        plan.products.push_back({operands[best], operands[best + 1]});
+        plan.multiplications += bestCost;
+        operands[best] = count + plan.products.size() - 1;
+        operands.erase(operands.begin() + static_cast<::std::ptrdiff_t>(best) + 1);
+        bounds.erase(bounds.begin() + static_cast<::std::ptrdiff_t>(best) + 1);
+    }
+    return plan;
+}
+
+/// @brief Plan a chain, optimally if it is short enough.
+/// @param dims The dimensions, matrix `i` being `dims[i]` x `dims[i + 1]`.
+/// @return The plan.
+inline ChainPlan planChain(const ::std::vector<::std::size_t>& dims) {
+    return dims.size() <= CHAIN_OPTIMAL_LIMIT + 1 ? planChainOptimal(dims) : planChainGreedy(dims);
+}
+
+/// @brief Evaluate an operand of a plan. Both sides of a product run in parallel while
+/// `parallelDepth` allows, as neither depends on the other.
+inline DenseMatrix evaluateChain(const ::std::vector<DenseMatrix>& mats, const ChainPlan& plan,
+    ::std::size_t operand, unsigned int parallelDepth) {
+    if (operand < plan.count) return mats[operand];
+    const ChainPlan::Product& product = plan.products[operand - plan.count];
+    const bool isLeftLeaf = product.left < plan.count;
+    const bool isRightLeaf = product.right < plan.count;
+    if (isLeftLeaf && isRightLeaf) return mats[product.left] * mats[product.right];
+    if (isLeftLeaf) return mats[product.left] * evaluateChain(mats, plan, product.right, parallelDepth);
+    if (isRightLeaf) return evaluateChain(mats, plan, product.left, parallelDepth) * mats[product.right];
+
+    const unsigned int childDepth = parallelDepth == 0 ? 0 : parallelDepth - 1;
+    if (parallelDepth == 0) {
+        DenseMatrix left = evaluateChain(mats, plan, product.left, childDepth);
+        return left * evaluateChain(mats, plan, product.right, childDepth);
+    }
+    ::std::future<DenseMatrix> left = ::std::async(::std::launch::async,
+        [&]() { return evaluateChain(mats, plan, product.left, childDepth); });
+    DenseMatrix right;
+    try {
+        right = evaluateChain(mats, plan, product.right, childDepth);
+    } catch (...) {
+        left.wait();
+        throw;
+    }
+    return left.get() * right;
+}
+
+/// @brief Multiply a chain of matrices in the order needing the fewest operations.
+/// Each product runs on the blocked kernel.
+/// @param mats The matrices, at least one.
+/// @param parallelDepth The number of levels of the plan whose independent subproducts
+/// run in parallel.
+/// @return The product of the chain.
+inline DenseMatrix multiplyChain(const ::std::vector<DenseMatrix>& mats, unsigned int parallelDepth = 3) {
+    if (mats.empty()) {
+        throw ::std::invalid_argument("The chain is empty.");
+    }
+    ::std::vector<::std::size_t> dims;
+    dims.push_back(mats[0].rows());
+    for (::std::size_t i = 0; i < mats.size(); i++) {
+        if (mats[i].rows() != dims.back()) {
+            throw ::std::invalid_argument("The number of columns of the left matrix does not match the rows of the right.");
+        }
+        dims.push_back(mats[i].cols());
+    }
+    ChainPlan plan = planChain(dims);
+    return evaluateChain(mats, plan, plan.root(), parallelDepth);
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
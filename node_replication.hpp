@@ -0,0 +1,371 @@
+/*
+
+File: node_replication.hpp
+Author: Aldhinn Espinas
+Description: This file contains the replication of a structure on every NUMA node,
+    kept in sync through a shared log of operations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(NODE_REPLICATION_HEADER_FILE)
+#define NODE_REPLICATION_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+
+/// @brief The NUMA nodes of the machine and the CPUs on each.
+class NumaTopology final {
+public:
+    /// @brief The topology of this machine, read once from `/sys`. A single node where
+    /// it cannot be read.
+    inline static const NumaTopology& system() {
+        static const NumaTopology topology = detect();
+        return topology;
+    }
+
+    /// @brief The number of nodes.
+    inline unsigned int nodeCount() const { return _nodeCount; }
+    /// @brief The node of a CPU, 0 for an unknown CPU.
+    inline unsigned int nodeOfCpu(unsigned int cpu) const {
+        return cpu < _nodeOfCpu.size() ? _nodeOfCpu[cpu] : 0;
+    }
+    /// @brief The CPUs of a node, empty for an unknown node.
+    inline const ::std::vector<unsigned int>& cpusOfNode(unsigned int node) const {
+        static const ::std::vector<unsigned int> none;
+        return node < _cpusOfNode.size() ? _cpusOfNode[node] : none;
+    }
+    /// @brief The node of the CPU the calling thread runs on.
+    inline unsigned int currentNode() const {
+#if defined(__linux__)
+        int cpu = sched_getcpu();
+        if (cpu >= 0) return nodeOfCpu(static_cast<unsigned int>(cpu));
+#endif
+        return 0;
+    }
+
+private:
+    inline NumaTopology() : _nodeCount(1) {}
+
+    /// @brief Read the CPU list of each node. Nodes are numbered in order of their
+    /// number in `/sys`, without gaps.
+    inline static NumaTopology detect() {
+        NumaTopology topology;
+        unsigned int found = 0;
+        for (unsigned int node = 0; node < 1024; node++) {
+            ::std::ifstream file("/sys/devices/system/node/node" + ::std::to_string(node) + "/cpulist");
+            if (!file) continue;
+            ::std::string text;
+            ::std::getline(file, text);
+            topology._cpusOfNode.push_back(parseCpuList(text));
+            for (unsigned int cpu : topology._cpusOfNode.back()) {
+                if (cpu >= topology._nodeOfCpu.size()) topology._nodeOfCpu.resize(cpu + 1, 0);
+                topology._nodeOfCpu[cpu] = found;
+            }
+            found++;
+        }
+        topology._nodeCount = ::std::max(found, 1u);
+        return topology;
+    }
+
+    /// @brief The number of nodes.
+    unsigned int _nodeCount;
+    /// @brief The node of each CPU.
+    ::std::vector<unsigned int> _nodeOfCpu;
+    /// @brief The CPUs of each node.
+    ::std::vector<::std::vector<unsigned int>> _cpusOfNode;
+};
+
+/// @brief A structure replicated on every NUMA node, in the manner of node replication.
+///
+/// Writers append their operations to a log shared by every node, and each node keeps a
+/// replica of its own that replays the log. Reads run on the replica of the node of the
+/// reader, after it caught up with the log, so they only touch node local memory: each
+/// replica is allocated and copied by a thread running on its node, which places its
+/// pages there on first touch. The
+/// writers of a node are combined: one of them appends the operations of all the others
+/// in a single reservation of the log.
+/// @tparam Structure The replicated type, with an `Operation` type and an
+/// `execute(const Operation&)` method. Only the operations change it.
+template <typename Structure>
+class NodeReplicated final {
+public:
+    /// @brief The operation type.
+    using Operation = typename Structure::Operation;
+
+    /// @brief The number of entries of the log. A writer may have to wait for the
+    /// slowest replica to be this close.
+    static constexpr ::std::uint64_t LOG_CAPACITY = 1024;
+
+    /// @brief Construct a replica of an initial structure on each node.
+    /// @param initial The initial structure.
+    /// @param nodeCount The number of replicas.
+    inline explicit NodeReplicated(const Structure& initial = Structure(),
+        unsigned int nodeCount = NumaTopology::system().nodeCount()) :
+    _log(new Entry[LOG_CAPACITY]), _tail(0) {
+        if (nodeCount == 0) {
+            throw ::std::invalid_argument("There has to be a node at least.");
+        }
+        for (::std::uint64_t i = 0; i < LOG_CAPACITY; i++) _log[i].sequence.store(0, ::std::memory_order_relaxed);
+        for (unsigned int node = 0; node < nodeCount; node++) _replicas.emplace_back(allocateOn(node, initial));
+    }
+
+    NodeReplicated(const NodeReplicated&) = delete;
+    NodeReplicated& operator=(const NodeReplicated&) = delete;
+
+    /// @brief The number of replicas.
+    inline unsigned int nodeCount() const { return static_cast<unsigned int>(_replicas.size()); }
+    /// @brief The number of operations appended to the log so far.
+    inline ::std::uint64_t logSize() const { return _tail.load(::std::memory_order_acquire); }
+
+    /// @brief Run an operation from the node of the calling thread.
+    inline void execute(const Operation& operation) { execute(localNode(), operation); }
+    /// @brief Run an operation from a node. Returns once the replica of the node has it.
+    /// @param node The node.
+    /// @param operation The operation.
+    inline void execute(unsigned int node, const Operation& operation) {
+        Replica& replica = replicaOf(node);
+        ::std::uint64_t ticket;
+        {
+            ::std::lock_guard<::std::mutex> lock(replica.pendingMutex);
+            replica.pending.push_back(operation);
+            ticket = replica.enqueued++;
+        }
+        ::std::lock_guard<::std::mutex> combiner(replica.combinerMutex);
+        // An earlier combiner of the node appended it already.
+        if (replica.appended > ticket) return;
+        ::std::vector<Operation> batch;
+        {
+            ::std::lock_guard<::std::mutex> lock(replica.pendingMutex);
+            batch.swap(replica.pending);
+        }
+        ::std::uint64_t end = 0;
+        for (::std::size_t first = 0; first < batch.size(); first += LOG_CAPACITY) {
+            ::std::size_t count = ::std::min<::std::size_t>(LOG_CAPACITY, batch.size() - first);
+            end = append(batch.data() + first, count);
+        }
+        catchUp(replica, end);
+        replica.appended += batch.size();
+    }
+
+    /// @brief Read from the replica of the node of the calling thread.
+    template <typename Reader>
+    inline auto read(Reader&& reader) { return read(localNode(), ::std::forward<Reader>(reader)); }
+    /// @brief Read from the replica of a node, once it has every operation appended
+    /// before the read started.
+    /// @param node The node.
+    /// @param reader The callable taking the structure as a constant.
+    /// @return The result of the reader.
+    template <typename Reader>
+    inline auto read(unsigned int node, Reader&& reader) {
+        Replica& replica = replicaOf(node);
+        catchUp(replica, _tail.load(::std::memory_order_acquire));
+        ::std::shared_lock<::std::shared_mutex> lock(replica.mutex);
+        return reader(static_cast<const Structure&>(replica.structure));
+    }
+
+private:
+    /// @brief An entry of the log.
+    struct Entry {
+        /// @brief The operation.
+        Operation operation;
+        /// @brief One past the index of the operation once it is written, since the
+        /// entries are reused round the log.
+        ::std::atomic<::std::uint64_t> sequence;
+    };
+    /// @brief The replica of a node, on cache lines of its own.
+    struct alignas(64) Replica {
+        inline explicit Replica(const Structure& initial) : structure(initial), applied(0), enqueued(0), appended(0) {}
+
+        /// @brief Taken shared by readers and exclusive to replay the log.
+        ::std::shared_mutex mutex;
+        /// @brief The structure.
+        Structure structure;
+        /// @brief The number of operations of the log replayed.
+        ::std::atomic<::std::uint64_t> applied;
+        /// @brief Taken by the writer combining the operations of the node.
+        ::std::mutex combinerMutex;
+        /// @brief Guards the operations waiting for a combiner.
+        ::std::mutex pendingMutex;
+        /// @brief The operations waiting for a combiner.
+        ::std::vector<Operation> pending;
+        /// @brief The number of operations handed to the node.
+        ::std::uint64_t enqueued;
+        /// @brief The number of operations of the node appended. Under the combiner.
+        ::std::uint64_t appended;
+    };
+
+    /// @brief Allocate and initialize a replica from a thread running on a node, so that
+    /// its memory is local to the node. Replicas beyond the nodes of the machine, or on a
+    /// machine of a single node, are allocated by the calling thread.
+    inline static Replica* allocateOn(unsigned int node, const Structure& initial) {
+        const NumaTopology& topology = NumaTopology::system();
+        if (topology.nodeCount() < 2 || topology.cpusOfNode(node).empty()) return new Replica(initial);
+        Replica* replica = nullptr;
+        ::std::exception_ptr error;
+        ::std::thread allocator([&]() {
+#if defined(__linux__)
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            for (unsigned int cpu : topology.cpusOfNode(node)) {
+                if (cpu < CPU_SETSIZE) CPU_SET(cpu, &cpus);
+            }
+            // Best effort: the replica is still correct wherever its memory ends up.
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+            try {
+                replica = new Replica(initial);
+            } catch (...) {
+                error = ::std::current_exception();
+            }
+        });
+        allocator.join();
+        if (error) ::std::rethrow_exception(error);
+        return replica;
+    }
+    inline unsigned int localNode() const { return NumaTopology::system().currentNode() % nodeCount(); }
+    inline Replica& replicaOf(unsigned int node) {
+        if (node >= _replicas.size()) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return *_replicas[node];
+    }
+
+    /// @brief The number of operations every replica replayed.
+    inline ::std::uint64_t minimumApplied() const {
+        ::std::uint64_t minimum = _replicas[0]->applied.load(::std::memory_order_acquire);
+        for (const ::std::unique_ptr<Replica>& replica : _replicas) {
+            minimum = ::std::min(minimum, replica->applied.load(::std::memory_order_acquire));
+        }
+        return minimum;
+    }
+
+    /// @brief Append operations to the log.
+    /// @return The end of the appended operations.
+    inline ::std::uint64_t append(const Operation* operations, ::std::size_t count) {
+        ::std::uint64_t first = _tail.fetch_add(count, ::std::memory_order_acq_rel);
+        ::std::uint64_t end = first + count;
+        // Entries are reused once every replica replayed them. Lagging replicas are
+        // brought along rather than waited for, since their node may have no reader.
+        while (end > minimumApplied() + LOG_CAPACITY) {
+            bool isProgressing = false;
+            for (const ::std::unique_ptr<Replica>& replica : _replicas) {
+                if (replica->applied.load(::std::memory_order_acquire) + LOG_CAPACITY < end) {
+                    isProgressing |= replayWritten(*replica);
+                }
+            }
+            if (!isProgressing) ::std::this_thread::yield();
+        }
+        for (::std::size_t i = 0; i < count; i++) {
+            Entry& entry = _log[(first + i) % LOG_CAPACITY];
+            entry.operation = operations[i];
+            entry.sequence.store(first + i + 1, ::std::memory_order_release);
+        }
+        return end;
+    }
+
+    /// @brief Replay the log on a replica up to the first entry not written yet.
+    /// @return Whether anything was replayed.
+    inline bool replayWritten(Replica& replica) {
+        ::std::unique_lock<::std::shared_mutex> lock(replica.mutex);
+        ::std::uint64_t applied = replica.applied.load(::std::memory_order_relaxed);
+        ::std::uint64_t start = applied;
+        ::std::uint64_t tail = _tail.load(::std::memory_order_acquire);
+        for (; applied < tail; applied++) {
+            const Entry& entry = _log[applied % LOG_CAPACITY];
+            if (entry.sequence.load(::std::memory_order_acquire) != applied + 1) break;
+            replica.structure.execute(entry.operation);
+        }
+        replica.applied.store(applied, ::std::memory_order_release);
+        return applied != start;
+    }
+
+    /// @brief Replay the log on a replica up to an index. Never waits for a writer while
+    /// holding the replica, since that writer may be waiting for the replica itself.
+    inline void catchUp(Replica& replica, ::std::uint64_t end) {
+        while (replica.applied.load(::std::memory_order_acquire) < end) {
+            if (!replayWritten(replica)) ::std::this_thread::yield();
+        }
+    }
+
+private:
+    /// @brief The log.
+    ::std::unique_ptr<Entry[]> _log;
+    /// @brief The number of entries reserved by writers.
+    alignas(64) ::std::atomic<::std::uint64_t> _tail;
+    /// @brief The replica of each node.
+    ::std::vector<::std::unique_ptr<Replica>> _replicas;
+};
+
+/// @brief A 4x4 matrix to replicate with `NodeReplicated`.
+struct ReplicableMatrix4x4 {
+    /// @brief The kinds of operations.
+    enum class Kind { Store, Add, Multiply };
+    /// @brief An operation on the matrix.
+    struct Operation {
+        /// @brief The kind.
+        Kind kind;
+        /// @brief The new value, the addend or the right operand.
+        Matrix4x4 operand;
+    };
+
+    /// @brief The matrix.
+    Matrix4x4 value = Matrix4x4::identity();
+
+    /// @brief Run an operation.
+    inline void execute(const Operation& operation) {
+        switch (operation.kind) {
+        case Kind::Store: value = operation.operand; break;
+        case Kind::Add: value = value + operation.operand; break;
+        case Kind::Multiply: value = value * operation.operand; break;
+        }
+    }
+};
+
+/// @brief A 4x4 matrix with a replica on every NUMA node.
+using ReplicatedMatrix4x4 = NodeReplicated<ReplicableMatrix4x4>;
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,487 @@
+/*
+
+File: out_of_core.hpp
+Author: Aldhinn Espinas
+Description: This file contains the declarations for multiplying matrices stored in
+    memory-mapped files that may be larger than the available memory.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(OUT_OF_CORE_HEADER_FILE)
+#define OUT_OF_CORE_HEADER_FILE
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dense_matrix.hpp"
+#include "parallel.hpp"
+
+/// @brief A description of a row-major matrix stored in a memory-mapped file.
+///
+/// The file starts with a header holding the dimensions, and the elements follow at
+/// a page-aligned offset.
+class MappedMatrix final {
+public:
+    /// @brief The offset of the elements in the file.
+    static constexpr ::std::size_t DATA_OFFSET = 4096;
+
+    /// @brief Create a matrix file, replacing any existing one, and map it for writing.
+    /// @param path The path of the file.
+    /// @param rows The number of rows.
+    /// @param cols The number of columns.
+    inline static MappedMatrix create(const ::std::string& path, ::std::size_t rows, ::std::size_t cols) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throwSystemError("Cannot create the matrix file " + path);
+        Header header = {{'M', 'A', 'T', 'R', 'I', 'X', '6', '4'}, rows, cols};
+        if (::pwrite(fd, &header, sizeof(header), 0) != static_cast<::ssize_t>(sizeof(header)) ||
+            ::ftruncate(fd, static_cast<::off_t>(DATA_OFFSET + rows * cols * sizeof(double))) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw ::std::system_error(error, ::std::generic_category(), "Cannot size the matrix file " + path);
+        }
+        return MappedMatrix(fd, rows, cols, true, path);
+    }
+    /// @brief Open and map an existing matrix file.
+    /// @param path The path of the file.
+    /// @param writable Whether the elements may be written.
+    inline static MappedMatrix open(const ::std::string& path, bool writable = false) {
+        int fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd < 0) throwSystemError("Cannot open the matrix file " + path);
+        Header header;
+        struct stat status;
+        if (::pread(fd, &header, sizeof(header), 0) != static_cast<::ssize_t>(sizeof(header)) ||
+            ::fstat(fd, &status) != 0 ||
+            ::std::memcmp(header.magic, "MATRIX64", sizeof(header.magic)) != 0 ||
+            static_cast<::std::uint64_t>(status.st_size) < DATA_OFFSET + header.rows * header.cols * sizeof(double)) {
+            ::close(fd);
+            throw ::std::runtime_error("The file " + path + " is not a matrix file.");
+        }
+        return MappedMatrix(fd, header.rows, header.cols, writable, path);
+    }
+
+    inline MappedMatrix(MappedMatrix&& other) noexcept :
+    _fd(other._fd), _mapping(other._mapping), _mappingSize(other._mappingSize),
+    _rows(other._rows), _cols(other._cols) {
+        other._fd = -1;
+        other._mapping = nullptr;
+    }
+    inline MappedMatrix& operator=(MappedMatrix&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            _fd = other._fd;
+            _mapping = other._mapping;
+            _mappingSize = other._mappingSize;
+            _rows = other._rows;
+            _cols = other._cols;
+            other._fd = -1;
+            other._mapping = nullptr;
+        }
+        return *this;
+    }
+    MappedMatrix(const MappedMatrix&) = delete;
+    MappedMatrix& operator=(const MappedMatrix&) = delete;
+    inline ~MappedMatrix() {
+        unmap();
+    }
+
+    /// @brief The number of rows.
+    inline ::std::size_t rows() const { return _rows; }
+    /// @brief The number of columns.
+    inline ::std::size_t cols() const { return _cols; }
+    /// @brief The row-major elements.
+    inline const double* data() const {
+        return reinterpret_cast<const double*>(static_cast<const char*>(_mapping) + DATA_OFFSET);
+    }
+    /// @brief The row-major elements. Only writable if mapped for writing.
+    inline double* data() {
+        return reinterpret_cast<double*>(static_cast<char*>(_mapping) + DATA_OFFSET);
+    }
+
+    /// @brief Give the kernel a paging hint for a range of rows.
+    /// @param rowBegin The first row.
+    /// @param rowEnd One past the last row.
+    /// @param advice The `madvise` advice, such as `MADV_WILLNEED`.
+    inline void advise(::std::size_t rowBegin, ::std::size_t rowEnd, int advice) const {
+        char* begin;
+        ::std::size_t length;
+        if (!pageRange(rowBegin, rowEnd, begin, length)) return;
+        // Only a hint. Failing to follow it does not affect correctness.
+        ::madvise(begin, length, advice);
+    }
+    /// @brief Drop a range of rows from memory once they are no longer needed.
+    /// Written rows are scheduled for write-back first.
+    /// @param rowBegin The first row.
+    /// @param rowEnd One past the last row.
+    inline void evict(::std::size_t rowBegin, ::std::size_t rowEnd) const {
+        char* begin;
+        ::std::size_t length;
+        if (!pageRange(rowBegin, rowEnd, begin, length)) return;
+        ::msync(begin, length, MS_ASYNC);
+        ::madvise(begin, length, MADV_DONTNEED);
+        ::posix_fadvise(_fd, static_cast<::off_t>(begin - static_cast<char*>(_mapping)),
+            static_cast<::off_t>(length), POSIX_FADV_DONTNEED);
+    }
+    /// @brief Write every modified row back to the file.
+    inline void flush() const {
+        if (::msync(_mapping, _mappingSize, MS_SYNC) != 0) throwSystemError("Cannot write the matrix file back");
+    }
+
+private:
+    /// @brief The file header.
+    struct Header {
+        /// @brief Identifies matrix files.
+        char magic[8];
+        /// @brief The number of rows.
+        ::std::uint64_t rows;
+        /// @brief The number of columns.
+        ::std::uint64_t cols;
+    };
+
+    inline MappedMatrix(int fd, ::std::size_t rows, ::std::size_t cols, bool writable, const ::std::string& path) :
+    _fd(fd), _mapping(nullptr), _mappingSize(DATA_OFFSET + rows * cols * sizeof(double)), _rows(rows), _cols(cols) {
+        _mapping = ::mmap(nullptr, _mappingSize, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+        if (_mapping == MAP_FAILED) {
+            int error = errno;
+            ::close(fd);
+            _mapping = nullptr;
+            throw ::std::system_error(error, ::std::generic_category(), "Cannot map the matrix file " + path);
+        }
+    }
+
+    /// @brief Throw the error in `errno`.
+    [[noreturn]] inline static void throwSystemError(const ::std::string& message) {
+        throw ::std::system_error(errno, ::std::generic_category(), message);
+    }
+
+    /// @brief The page-aligned address range covering a range of rows.
+    inline bool pageRange(::std::size_t rowBegin, ::std::size_t rowEnd, char*& begin, ::std::size_t& length) const {
+        if (rowEnd <= rowBegin || _mapping == nullptr) return false;
+        ::std::size_t pageSize = static_cast<::std::size_t>(::sysconf(_SC_PAGESIZE));
+        ::std::size_t first = DATA_OFFSET + rowBegin * _cols * sizeof(double);
+        ::std::size_t last = DATA_OFFSET + rowEnd * _cols * sizeof(double);
+        first -= first % pageSize;
+        begin = static_cast<char*>(_mapping) + first;
+        length = last - first;
+        return true;
+    }
+
+    /// @brief Unmap and close the file.
+    inline void unmap() {
+        if (_mapping != nullptr) ::munmap(_mapping, _mappingSize);
+        if (_fd >= 0) ::close(_fd);
+        _mapping = nullptr;
+        _fd = -1;
+    }
+
+private:
+    /// @brief The file descriptor.
+    int _fd;
+    /// @brief The mapping of the whole file.
+    void* _mapping;
+    /// @brief The size of the mapping.
+    ::std::size_t _mappingSize;
+    /// @brief The number of rows.
+    ::std::size_t _rows;
+    /// @brief The number of columns.
+    ::std::size_t _cols;
+};
+
+/// @brief Write a matrix to a matrix file.
+/// @param path The path of the file.
+/// @param values The matrix.
+inline void writeMatrixFile(const ::std::string& path, const DenseMatrix& values) {
+    MappedMatrix file = MappedMatrix::create(path, values.rows(), values.cols());
+    ::std::copy(values.data(), values.data() + values.rows() * values.cols(), file.data());
+    file.flush();
+}
+/// @brief Read a whole matrix file into memory.
+/// @param path The path of the file.
+/// @return The matrix.
+inline DenseMatrix readMatrixFile(const ::std::string& path) {
+    MappedMatrix file = MappedMatrix::open(path);
+    DenseMatrix values(file.rows(), file.cols());
+    ::std::copy(file.data(), file.data() + file.rows() * file.cols(), values.data());
+    return values;
+}
+
+/// @brief A pipeline that copies row panels of mapped matrices into a bounded pool of
+/// buffers on a background thread, in a fixed order, while the consumer computes.
+class PanelPipeline final {
+public:
+    /// @brief A row panel to be loaded.
+    struct Job {
+        /// @brief The matrix the panel is copied from.
+        const MappedMatrix* source;
+        /// @brief The first row of the panel.
+        ::std::size_t rowBegin;
+        /// @brief One past the last row of the panel.
+        ::std::size_t rowEnd;
+        /// @brief The buffer pool the panel is loaded into.
+        unsigned int pool;
+        /// @brief Whether the rows are dropped from memory once copied.
+        bool evictAfter;
+    };
+    /// @brief A loaded panel.
+    struct Panel {
+        /// @brief The job that loaded the panel.
+        const Job* job;
+        /// @brief The row-major elements of the panel.
+        double* data;
+        /// @brief The pool buffer holding the elements.
+        ::std::size_t buffer;
+    };
+
+    /// @brief Start loading panels.
+    /// @param jobs The panels, in the order they will be consumed.
+    /// @param poolBuffers The number of buffers of each pool.
+    /// @param poolBufferSizes The number of elements of the buffers of each pool.
+    inline PanelPipeline(::std::vector<Job> jobs, const ::std::vector<::std::size_t>& poolBuffers,
+        const ::std::vector<::std::size_t>& poolBufferSizes) :
+    _jobs(::std::move(jobs)), _freeBuffers(poolBuffers.size()), _shouldStop(false) {
+        for (::std::size_t pool = 0; pool < poolBuffers.size(); pool++) {
+            for (::std::size_t i = 0; i < poolBuffers[pool]; i++) {
+                _freeBuffers[pool].push_back(_buffers.size());
+                _buffers.emplace_back(poolBufferSizes[pool]);
+            }
+        }
+        _producer = ::std::thread(&PanelPipeline::produce, this);
+    }
+    PanelPipeline(const PanelPipeline&) = delete;
+    PanelPipeline& operator=(const PanelPipeline&) = delete;
+    inline ~PanelPipeline() {
+        {
+            ::std::lock_guard<::std::mutex> lock(_mutex);
+            _shouldStop = true;
+        }
+        _condition.notify_all();
+        _producer.join();
+    }
+
+    /// @brief Wait for the next panel.
+    inline Panel next() {
+        ::std::unique_lock<::std::mutex> lock(_mutex);
+        _condition.wait(lock, [this]() { return !_ready.empty() || _error; });
+        if (_ready.empty()) ::std::rethrow_exception(_error);
+        Panel panel = _ready.front();
+        _ready.pop_front();
+        return panel;
+    }
+    /// @brief Hand the buffer of a consumed panel back to its pool.
+    inline void release(const Panel& panel) {
+        {
+            ::std::lock_guard<::std::mutex> lock(_mutex);
+            _freeBuffers[panel.job->pool].push_back(panel.buffer);
+        }
+        _condition.notify_all();
+    }
+
+private:
+    /// @brief Load the panels, staying at most a pool's worth of buffers ahead of the consumer.
+    inline void produce() {
+        try {
+            for (::std::size_t index = 0; index < _jobs.size(); index++) {
+                const Job& job = _jobs[index];
+                // Start the read-ahead of the following panel while this one is copied.
+                if (index + 1 < _jobs.size()) {
+                    const Job& nextJob = _jobs[index + 1];
+                    nextJob.source->advise(nextJob.rowBegin, nextJob.rowEnd, MADV_WILLNEED);
+                }
+
+                ::std::size_t buffer;
+                {
+                    ::std::unique_lock<::std::mutex> lock(_mutex);
+                    _condition.wait(lock, [&]() { return _shouldStop || !_freeBuffers[job.pool].empty(); });
+                    if (_shouldStop) return;
+                    buffer = _freeBuffers[job.pool].back();
+                    _freeBuffers[job.pool].pop_back();
+                }
+
+                const MappedMatrix& source = *job.source;
+                ::std::copy(source.data() + job.rowBegin * source.cols(), source.data() + job.rowEnd * source.cols(),
+                    _buffers[buffer].data());
+                if (job.evictAfter) source.evict(job.rowBegin, job.rowEnd);
+
+                {
+                    ::std::lock_guard<::std::mutex> lock(_mutex);
+                    _ready.push_back({&job, _buffers[buffer].data(), buffer});
+                }
+                _condition.notify_all();
+            }
+        } catch (...) {
+            {
+                ::std::lock_guard<::std::mutex> lock(_mutex);
+                _error = ::std::current_exception();
+            }
+            _condition.notify_all();
+        }
+    }
+
+private:
+    /// @brief The panels, in the order they are consumed.
+    ::std::vector<Job> _jobs;
+    /// @brief The buffers of every pool.
+    ::std::vector<::std::vector<double>> _buffers;
+    /// @brief The free buffers of each pool.
+    ::std::vector<::std::vector<::std::size_t>> _freeBuffers;
+    /// @brief The loaded panels that were not consumed yet.
+    ::std::deque<Panel> _ready;
+    /// @brief The error that stopped the producer.
+    ::std::exception_ptr _error;
+    /// @brief Whether the producer should stop.
+    bool _shouldStop;
+    /// @brief Guards the pools and the ready panels.
+    ::std::mutex _mutex;
+    /// @brief Signals ready panels and free buffers.
+    ::std::condition_variable _condition;
+    /// @brief The thread loading the panels.
+    ::std::thread _producer;
+};
+
+/// @brief The options of an out-of-core multiplication.
+struct OutOfCoreOptions {
+    /// @brief The bytes of memory the panel buffers may use.
+    ::std::size_t memoryBudget = ::std::size_t(256) << 20;
+    /// @brief The number of panels of the right matrix loaded ahead of the computation.
+    ::std::size_t prefetchDepth = 2;
+};
+
+/// @brief Multiply two mapped matrices that may not fit in memory, `C = A B`.
+///
+/// C is produced one block of rows at a time. For each block, its row panel of A is
+/// loaded once, and B is streamed through in panels of rows, which are contiguous in
+/// the file. A background thread loads the panels ahead of the computation into a
+/// bounded pool of buffers, so reading overlaps with computing, and the rows that were
+/// consumed are dropped from the page cache instead of pushing out the ones still needed.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param dotProduct The mapped, writable dot product.
+/// @param options The memory budget and the prefetch depth.
+inline void multiplyOutOfCore(const MappedMatrix& leftMat, const MappedMatrix& rightMat, MappedMatrix& dotProduct,
+    const OutOfCoreOptions& options = OutOfCoreOptions()) {
+    if (leftMat.cols() != rightMat.rows() ||
+        dotProduct.rows() != leftMat.rows() || dotProduct.cols() != rightMat.cols()) {
+        throw ::std::invalid_argument("The dimensions of the matrices do not match.");
+    }
+    const ::std::size_t rows = leftMat.rows();
+    const ::std::size_t depth = leftMat.cols();
+    const ::std::size_t cols = rightMat.cols();
+    if (rows == 0 || cols == 0) return;
+    if (depth == 0) {
+        // An empty sum: the product is all zeros, whatever the file held before.
+        ::std::fill(dotProduct.data(), dotProduct.data() + rows * cols, 0.0);
+        dotProduct.flush();
+        return;
+    }
+    const ::std::size_t prefetchDepth = ::std::max<::std::size_t>(1, options.prefetchDepth);
+
+    // Half of the budget goes to the panels of B, the rest to two panels of A and a block of C.
+    ::std::size_t budget = options.memoryBudget / sizeof(double);
+    ::std::size_t depthBlock = ::std::min(depth, ::std::max<::std::size_t>(1, budget / 2 / (prefetchDepth * cols)));
+    ::std::size_t remaining = budget > prefetchDepth * depthBlock * cols ? budget - prefetchDepth * depthBlock * cols : 0;
+    ::std::size_t rowBlock = ::std::min(rows, remaining / (2 * depth + cols));
+    if (rowBlock == 0) {
+        throw ::std::invalid_argument("The memory budget is too small for a single row of the matrices.");
+    }
+
+    // Streaming access: read-ahead on, and no point in keeping pages behind.
+    leftMat.advise(0, rows, MADV_SEQUENTIAL);
+    rightMat.advise(0, depth, MADV_SEQUENTIAL);
+
+    const unsigned int LEFT_POOL = 0;
+    const unsigned int RIGHT_POOL = 1;
+    ::std::vector<PanelPipeline::Job> jobs;
+    for (::std::size_t rowBegin = 0; rowBegin < rows; rowBegin += rowBlock) {
+        // Each panel of A is used by a single block, B is read again by the next one.
+        jobs.push_back({&leftMat, rowBegin, ::std::min(rows, rowBegin + rowBlock), LEFT_POOL, true});
+        for (::std::size_t depthBegin = 0; depthBegin < depth; depthBegin += depthBlock) {
+            jobs.push_back({&rightMat, depthBegin, ::std::min(depth, depthBegin + depthBlock), RIGHT_POOL, false});
+        }
+    }
+    PanelPipeline pipeline(::std::move(jobs), {2, prefetchDepth}, {rowBlock * depth, depthBlock * cols});
+
+    ::std::vector<double> productBlock(rowBlock * cols);
+    for (::std::size_t rowBegin = 0; rowBegin < rows; rowBegin += rowBlock) {
+        ::std::size_t blockRows = ::std::min(rows, rowBegin + rowBlock) - rowBegin;
+        PanelPipeline::Panel leftPanel = pipeline.next();
+        ::std::fill(productBlock.begin(), productBlock.begin() + blockRows * cols, 0.0);
+
+        for (::std::size_t depthBegin = 0; depthBegin < depth; depthBegin += depthBlock) {
+            PanelPipeline::Panel rightPanel = pipeline.next();
+            ::std::size_t panelDepth = rightPanel.job->rowEnd - rightPanel.job->rowBegin;
+            parallelFor(0, (blockRows + 3) / 4, 16, [&](::std::size_t groupBegin, ::std::size_t groupEnd) {
+                ::std::size_t first = groupBegin * 4;
+                ::std::size_t last = ::std::min(blockRows, groupEnd * 4);
+                gemmAccumulate(last - first, cols, panelDepth,
+                    leftPanel.data + first * depth + depthBegin, depth,
+                    rightPanel.data, cols,
+                    productBlock.data() + first * cols, cols);
+            });
+            pipeline.release(rightPanel);
+        }
+        pipeline.release(leftPanel);
+
+        ::std::copy(productBlock.begin(), productBlock.begin() + blockRows * cols,
+            dotProduct.data() + rowBegin * cols);
+        dotProduct.evict(rowBegin, rowBegin + blockRows);
+    }
+    dotProduct.flush();
+}
+
+/// @brief Multiply two matrix files that may not fit in memory into a new matrix file.
+/// @param leftPath The path of the left hand-side matrix.
+/// @param rightPath The path of the right hand-side matrix.
+/// @param resultPath The path of the dot product, replaced if it exists.
+/// @param options The memory budget and the prefetch depth.
+inline void multiplyOutOfCore(const ::std::string& leftPath, const ::std::string& rightPath,
+    const ::std::string& resultPath, const OutOfCoreOptions& options = OutOfCoreOptions()) {
+    MappedMatrix leftMat = MappedMatrix::open(leftPath);
+    MappedMatrix rightMat = MappedMatrix::open(rightPath);
+    // Checked before the result file is replaced, so a failed call leaves it alone.
+    if (leftMat.cols() != rightMat.rows()) {
+        throw ::std::invalid_argument("The dimensions of the matrices do not match.");
+    }
+    MappedMatrix dotProduct = MappedMatrix::create(resultPath, leftMat.rows(), rightMat.cols());
+    multiplyOutOfCore(leftMat, rightMat, dotProduct, options);
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
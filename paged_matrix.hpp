@@ -0,0 +1,358 @@
+/*
+
+File: paged_matrix.hpp
+Author: Aldhinn Espinas
+Description: This file contains the copy-on-write paged matrix declarations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(PAGED_MATRIX_HEADER_FILE)
+#define PAGED_MATRIX_HEADER_FILE
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "dense_matrix.hpp"
+
+/// @brief A description of a large matrix stored in 64x64 tiles behind a copy-on-write tile directory.
+///
+/// The directory is a tree with 64 children per node whose leaves are the tiles. A writer
+/// copies the tiles it modifies and the directory nodes on their paths, then publishes
+/// the new root with a compare-and-swap, retrying if another writer published first.
+/// A snapshot pins a root, which takes O(1), and keeps seeing that version for as long
+/// as it is held.
+class PagedMatrix final {
+public:
+    /// @brief The number of rows and columns of a tile.
+    static constexpr ::std::size_t TILE_SIZE = 64;
+    /// @brief The number of children of a directory node.
+    static constexpr ::std::size_t FANOUT = 64;
+    /// @brief A row-major tile.
+    using Tile = ::std::array<double, TILE_SIZE * TILE_SIZE>;
+
+    /// @brief An element update.
+    struct ElementUpdate {
+        /// @brief The row-index of the element.
+        ::std::size_t row;
+        /// @brief The column-index of the element.
+        ::std::size_t col;
+        /// @brief The new value.
+        double value;
+    };
+
+private:
+    /// @brief A directory node. Inner nodes have children, the last level has tiles.
+    struct Node {
+        /// @brief The child nodes.
+        ::std::vector<::std::shared_ptr<const Node>> children;
+        /// @brief The tiles.
+        ::std::vector<::std::shared_ptr<const Tile>> tiles;
+    };
+    /// @brief A published version of the directory.
+    struct Root {
+        /// @brief The number of updates published before this one.
+        ::std::uint64_t version;
+        /// @brief The top directory node.
+        ::std::shared_ptr<const Node> node;
+    };
+
+public:
+    /// @brief A consistent, immutable view of a version of the matrix.
+    class Snapshot final {
+    public:
+        /// @brief The number of rows.
+        inline ::std::size_t rows() const { return _matrix->_rows; }
+        /// @brief The number of columns.
+        inline ::std::size_t cols() const { return _matrix->_cols; }
+        /// @brief The version of the matrix this snapshot shows.
+        inline ::std::uint64_t version() const { return _root->version; }
+
+        /// @brief Get the value of the element in the specified index.
+        /// @param rowIndex The row-index of the element to be accessed.
+        /// @param colIndex The column-index of the element to be accessed.
+        inline double operator()(::std::size_t rowIndex, ::std::size_t colIndex) const {
+            _matrix->checkIndex(rowIndex, colIndex);
+            return (*tile(rowIndex / TILE_SIZE, colIndex / TILE_SIZE))
+                [(rowIndex % TILE_SIZE) * TILE_SIZE + colIndex % TILE_SIZE];
+        }
+        /// @brief Get a tile. Elements past the edges of the matrix are zero.
+        /// @param tileRow The row-index of the tile.
+        /// @param tileCol The column-index of the tile.
+        inline const Tile* tile(::std::size_t tileRow, ::std::size_t tileCol) const {
+            return _matrix->findTile(*_root, tileRow * _matrix->_tileCols + tileCol);
+        }
+
+        /// @brief Copy the whole matrix out.
+        inline DenseMatrix toDense() const {
+            DenseMatrix result(rows(), cols());
+            for (::std::size_t tileRow = 0; tileRow < _matrix->_tileRows; tileRow++) {
+                for (::std::size_t tileCol = 0; tileCol < _matrix->_tileCols; tileCol++) {
+                    const Tile& values = *tile(tileRow, tileCol);
+                    ::std::size_t rowEnd = ::std::min(TILE_SIZE, rows() - tileRow * TILE_SIZE);
+                    ::std::size_t colEnd = ::std::min(TILE_SIZE, cols() - tileCol * TILE_SIZE);
+                    for (::std::size_t row = 0; row < rowEnd; row++) {
+                        ::std::copy(values.begin() + row * TILE_SIZE, values.begin() + row * TILE_SIZE + colEnd,
+                            result.data() + (tileRow * TILE_SIZE + row) * cols() + tileCol * TILE_SIZE);
+                    }
+                }
+            }
+            return result;
+        }
+
+    private:
+        friend class PagedMatrix;
+        inline Snapshot(const PagedMatrix* matrix, ::std::shared_ptr<const Root> root) :
+        _matrix(matrix), _root(::std::move(root)) {}
+
+        /// @brief The matrix this is a snapshot of. Needs to outlive the snapshot.
+        const PagedMatrix* _matrix;
+        /// @brief The pinned version.
+        ::std::shared_ptr<const Root> _root;
+    };
+
+    /// @brief Construct a matrix filled with zeros.
+    /// @param rows The number of rows.
+    /// @param cols The number of columns.
+    inline PagedMatrix(::std::size_t rows, ::std::size_t cols) :
+    _rows(rows), _cols(cols),
+    _tileRows((rows + TILE_SIZE - 1) / TILE_SIZE), _tileCols((cols + TILE_SIZE - 1) / TILE_SIZE), _depth(1) {
+        ::std::size_t capacity = FANOUT;
+        while (capacity < _tileRows * _tileCols) {
+            capacity *= FANOUT;
+            _depth++;
+        }
+        // Every tile starts out as the same zero tile, and every node of a level as the same node.
+        ::std::shared_ptr<Tile> zeroTile = ::std::make_shared<Tile>();
+        zeroTile->fill(0.0);
+        _zeroTile = zeroTile;
+        _zeroNodes.resize(_depth);
+        ::std::shared_ptr<Node> node = ::std::make_shared<Node>();
+        node->tiles.assign(FANOUT, _zeroTile);
+        _zeroNodes[_depth - 1] = node;
+        for (unsigned int level = _depth - 1; level > 0; level--) {
+            ::std::shared_ptr<Node> parent = ::std::make_shared<Node>();
+            parent->children.assign(FANOUT, node);
+            node = parent;
+            _zeroNodes[level - 1] = node;
+        }
+        _root = ::std::make_shared<const Root>(Root{0, node});
+    }
+
+    PagedMatrix(const PagedMatrix&) = delete;
+    PagedMatrix& operator=(const PagedMatrix&) = delete;
+
+    /// @brief The number of rows.
+    inline ::std::size_t rows() const { return _rows; }
+    /// @brief The number of columns.
+    inline ::std::size_t cols() const { return _cols; }
+    /// @brief The number of updates published so far.
+    inline ::std::uint64_t version() const { return ::std::atomic_load(&_root)->version; }
+
+    /// @brief Pin the current version.
+    inline Snapshot snapshot() const {
+        return Snapshot(this, ::std::atomic_load(&_root));
+    }
+
+    /// @brief Set the element in the specified index.
+    /// @param rowIndex The row-index of the element.
+    /// @param colIndex The column-index of the element.
+    /// @param value The new value.
+    inline void set(::std::size_t rowIndex, ::std::size_t colIndex, double value) {
+        update({{rowIndex, colIndex, value}});
+    }
+
+    /// @brief Set several elements as a single new version.
+    /// Only the touched tiles and their directory paths are copied.
+    /// @param updates The element updates. A repeated element keeps the last value.
+    inline void update(const ::std::vector<ElementUpdate>& updates) {
+        ::std::vector<TileUpdate> tileUpdates;
+        tileUpdates.reserve(updates.size());
+        for (const ElementUpdate& update : updates) {
+            checkIndex(update.row, update.col);
+            tileUpdates.push_back({
+                (update.row / TILE_SIZE) * _tileCols + update.col / TILE_SIZE,
+                (update.row % TILE_SIZE) * TILE_SIZE + update.col % TILE_SIZE,
+                update.value
+            });
+        }
+        ::std::stable_sort(tileUpdates.begin(), tileUpdates.end(),
+            [](const TileUpdate& left, const TileUpdate& right) { return left.tile < right.tile; });
+        publish([&](const Root& root) {
+            return applyUpdates(root.node, 0, 0, tileUpdates.data(), tileUpdates.data() + tileUpdates.size());
+        });
+    }
+
+    /// @brief Replace the whole matrix as a single new version.
+    /// @param values The new values, with the same dimensions as this matrix.
+    inline void store(const DenseMatrix& values) {
+        if (values.rows() != _rows || values.cols() != _cols) {
+            throw ::std::invalid_argument("The dimensions of the matrices do not match.");
+        }
+        ::std::shared_ptr<const Node> node = buildFrom(values, 0, 0);
+        publish([&](const Root&) { return node; });
+    }
+
+private:
+    /// @brief An element update, addressed by tile.
+    struct TileUpdate {
+        /// @brief The index of the tile.
+        ::std::size_t tile;
+        /// @brief The index of the element within the tile.
+        ::std::size_t offset;
+        /// @brief The new value.
+        double value;
+    };
+
+    /// @brief Throw if the index is outside of the matrix.
+    inline void checkIndex(::std::size_t rowIndex, ::std::size_t colIndex) const {
+        if (rowIndex >= _rows || colIndex >= _cols) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+    }
+
+    /// @brief The number of tiles under a node of a level.
+    inline ::std::size_t tilesUnder(unsigned int level) const {
+        ::std::size_t count = FANOUT;
+        for (unsigned int i = level + 1; i < _depth; i++) count *= FANOUT;
+        return count;
+    }
+
+    /// @brief Find a tile in a version.
+    inline const Tile* findTile(const Root& root, ::std::size_t tileIndex) const {
+        const Node* node = root.node.get();
+        for (unsigned int level = 0; level + 1 < _depth; level++) {
+            ::std::size_t span = tilesUnder(level + 1);
+            node = node->children[tileIndex / span].get();
+            tileIndex %= span;
+        }
+        return node->tiles[tileIndex].get();
+    }
+
+    /// @brief Publish a new root built from the current one, retrying on concurrent publishes.
+    template <typename Builder>
+    inline void publish(Builder&& buildNode) {
+        ::std::shared_ptr<const Root> current = ::std::atomic_load(&_root);
+        for (;;) {
+            ::std::shared_ptr<const Root> next =
+                ::std::make_shared<const Root>(Root{current->version + 1, buildNode(*current)});
+            // On failure `current` is reloaded and the copies are rebuilt from it.
+            if (::std::atomic_compare_exchange_weak(&_root, &current, next)) return;
+        }
+    }
+
+    /// @brief Path-copy the nodes and tiles touched by sorted updates.
+    /// @param node The node to be copied.
+    /// @param level The level of the node.
+    /// @param firstTile The index of the first tile under the node.
+    /// @param begin The first update under the node.
+    /// @param end One past the last update under the node.
+    inline ::std::shared_ptr<const Node> applyUpdates(const ::std::shared_ptr<const Node>& node, unsigned int level,
+        ::std::size_t firstTile, const TileUpdate* begin, const TileUpdate* end) const {
+        ::std::shared_ptr<Node> copy = ::std::make_shared<Node>(*node);
+        if (level + 1 == _depth) {
+            // Copy each touched tile once, then apply all of its updates.
+            while (begin != end) {
+                ::std::size_t tileIndex = begin->tile;
+                ::std::shared_ptr<Tile> tile = ::std::make_shared<Tile>(*copy->tiles[tileIndex - firstTile]);
+                for (; begin != end && begin->tile == tileIndex; begin++) (*tile)[begin->offset] = begin->value;
+                copy->tiles[tileIndex - firstTile] = tile;
+            }
+            return copy;
+        }
+        ::std::size_t span = tilesUnder(level + 1);
+        while (begin != end) {
+            ::std::size_t child = (begin->tile - firstTile) / span;
+            const TileUpdate* childEnd = begin;
+            while (childEnd != end && (childEnd->tile - firstTile) / span == child) childEnd++;
+            copy->children[child] = applyUpdates(copy->children[child], level + 1, firstTile + child * span,
+                begin, childEnd);
+            begin = childEnd;
+        }
+        return copy;
+    }
+
+    /// @brief Build the nodes and tiles of a dense matrix.
+    /// @param values The dense matrix.
+    /// @param level The level of the node to build.
+    /// @param firstTile The index of the first tile under the node.
+    inline ::std::shared_ptr<const Node> buildFrom(const DenseMatrix& values, unsigned int level,
+        ::std::size_t firstTile) const {
+        // Nothing but padding under this node.
+        if (firstTile >= _tileRows * _tileCols) return _zeroNodes[level];
+
+        ::std::shared_ptr<Node> node = ::std::make_shared<Node>();
+        if (level + 1 == _depth) {
+            node->tiles.assign(FANOUT, _zeroTile);
+            for (::std::size_t i = 0; i < FANOUT && firstTile + i < _tileRows * _tileCols; i++) {
+                ::std::shared_ptr<Tile> tile = ::std::make_shared<Tile>();
+                tile->fill(0.0);
+                ::std::size_t rowBegin = ((firstTile + i) / _tileCols) * TILE_SIZE;
+                ::std::size_t colBegin = ((firstTile + i) % _tileCols) * TILE_SIZE;
+                ::std::size_t rowEnd = ::std::min(TILE_SIZE, _rows - rowBegin);
+                ::std::size_t colEnd = ::std::min(TILE_SIZE, _cols - colBegin);
+                for (::std::size_t row = 0; row < rowEnd; row++) {
+                    const double* source = values.data() + (rowBegin + row) * _cols + colBegin;
+                    ::std::copy(source, source + colEnd, tile->begin() + row * TILE_SIZE);
+                }
+                node->tiles[i] = tile;
+            }
+            return node;
+        }
+        ::std::size_t span = tilesUnder(level + 1);
+        node->children.resize(FANOUT);
+        for (::std::size_t i = 0; i < FANOUT; i++) {
+            node->children[i] = buildFrom(values, level + 1, firstTile + i * span);
+        }
+        return node;
+    }
+
+private:
+    /// @brief The number of rows.
+    ::std::size_t _rows;
+    /// @brief The number of columns.
+    ::std::size_t _cols;
+    /// @brief The number of rows of tiles.
+    ::std::size_t _tileRows;
+    /// @brief The number of columns of tiles.
+    ::std::size_t _tileCols;
+    /// @brief The number of directory levels.
+    unsigned int _depth;
+    /// @brief The tile shared by every tile that was never written.
+    ::std::shared_ptr<const Tile> _zeroTile;
+    /// @brief The node of each level shared by every subtree that was never written.
+    ::std::vector<::std::shared_ptr<const Node>> _zeroNodes;
+    /// @brief The published version. Accessed with the atomic `shared_ptr` functions.
+    ::std::shared_ptr<const Root> _root;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
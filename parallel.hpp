@@ -0,0 +1,122 @@
+/*
+
+File: parallel.hpp
+Author: Aldhinn Espinas
+Description: This file contains the helpers used to split work across threads and
+    to read the cores they may run on.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(PARALLEL_HEADER_FILE)
+#define PARALLEL_HEADER_FILE
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief The number of threads worth running compute work on.
+/// @return The hardware concurrency, at least 1.
+inline unsigned int workerCount() {
+    unsigned int count = ::std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+/// @brief Parse a CPU list of the kernel, such as "0-3,8,10-11".
+/// @return The CPUs.
+inline ::std::vector<unsigned int> parseCpuList(const ::std::string& text) {
+    ::std::vector<unsigned int> cpus;
+    ::std::size_t position = 0;
+    while (position < text.size()) {
+        ::std::size_t end = text.find(',', position);
+        if (end == ::std::string::npos) end = text.size();
+        ::std::string range = text.substr(position, end - position);
+        position = end + 1;
+        if (range.find_first_not_of(" \n") == ::std::string::npos) continue;
+        ::std::size_t dash = range.find('-');
+        try {
+            unsigned int first = static_cast<unsigned int>(::std::stoul(range.substr(0, dash)));
+            unsigned int last = dash == ::std::string::npos ? first :
+                static_cast<unsigned int>(::std::stoul(range.substr(dash + 1)));
+            for (unsigned int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        } catch (const ::std::logic_error&) {
+            throw ::std::invalid_argument("Invalid CPU list.");
+        }
+    }
+    return cpus;
+}
+
+/// @brief Run `task(chunkBegin, chunkEnd)` over contiguous chunks of `[begin, end)` in parallel.
+/// @param begin The first index.
+/// @param end One past the last index.
+/// @param grainSize The minimum number of indices handed to a thread.
+/// @param task The callable that processes a chunk of indices.
+template <typename Task>
+inline void parallelFor(::std::size_t begin, ::std::size_t end, ::std::size_t grainSize, Task&& task) {
+    if (end <= begin) return;
+    ::std::size_t count = end - begin;
+    if (grainSize == 0) grainSize = 1;
+    ::std::size_t threadCount = ::std::min<::std::size_t>(workerCount(), (count + grainSize - 1) / grainSize);
+    // Not worth spawning threads for.
+    if (threadCount <= 1) {
+        task(begin, end);
+        return;
+    }
+
+    ::std::size_t chunkSize = (count + threadCount - 1) / threadCount;
+    ::std::vector<::std::exception_ptr> errors(threadCount);
+    ::std::vector<::std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (::std::size_t threadIndex = 1; threadIndex < threadCount; threadIndex++) {
+        ::std::size_t chunkBegin = begin + threadIndex * chunkSize;
+        ::std::size_t chunkEnd = ::std::min(end, chunkBegin + chunkSize);
+        if (chunkBegin >= chunkEnd) break;
+        threads.emplace_back([&task, &errors, threadIndex, chunkBegin, chunkEnd]() {
+            try {
+                task(chunkBegin, chunkEnd);
+            } catch (...) {
+                errors[threadIndex] = ::std::current_exception();
+            }
+        });
+    }
+    // The calling thread takes the first chunk.
+    try {
+        task(begin, ::std::min(end, begin + chunkSize));
+    } catch (...) {
+        errors[0] = ::std::current_exception();
+    }
+    for (::std::thread& thread : threads) thread.join();
+
+    for (const ::std::exception_ptr& error : errors) {
+        if (error) ::std::rethrow_exception(error);
+    }
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
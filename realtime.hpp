@@ -0,0 +1,211 @@
+/*
+
+File: realtime.hpp
+Author: Aldhinn Espinas
+Description: This file contains the setup of latency-critical runs: locked and
+    prefaulted memory, and readers scheduled first-in first-out on isolated cores.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(REALTIME_HEADER_FILE)
+#define REALTIME_HEADER_FILE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <alloca.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "parallel.hpp"
+
+/// @brief Fault in the pages of a range of memory, so that the first access of a hot
+/// path does not take a page fault, and optionally lock them in memory.
+/// @param data The start of the range.
+/// @param size The number of bytes of the range.
+/// @param isLocking Determines if the pages are locked too.
+/// @return Whether the pages are locked, false if not asked to or if not permitted.
+inline bool prefaultMemory(const void* data, ::std::size_t size, bool isLocking = true) {
+    if (data == nullptr || size == 0) return false;
+#if defined(__linux__)
+    const ::std::uintptr_t pageSize = static_cast<::std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    ::std::uintptr_t begin = reinterpret_cast<::std::uintptr_t>(data) & ~(pageSize - 1);
+    ::std::uintptr_t end = reinterpret_cast<::std::uintptr_t>(data) + size;
+    bool isPopulated = false;
+#if defined(MADV_POPULATE_WRITE)
+    // Maps the pages writable without touching their content, which others may be using.
+    isPopulated = ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_POPULATE_WRITE) == 0;
+#endif
+    if (!isPopulated) {
+        // A read still maps the page, leaving at most a minor fault for the first write.
+        for (::std::uintptr_t page = reinterpret_cast<::std::uintptr_t>(data); page < end; page += pageSize) {
+            (void)*reinterpret_cast<const volatile char*>(page);
+        }
+    }
+    return isLocking && ::mlock(reinterpret_cast<void*>(begin), end - begin) == 0;
+#else
+    const volatile char* bytes = static_cast<const volatile char*>(data);
+    for (::std::size_t i = 0; i < size; i += 4096) (void)bytes[i];
+    (void)isLocking;
+    return false;
+#endif
+}
+
+/// @brief The choices of a real-time setup.
+struct RealtimeOptions {
+    /// @brief Determines if all memory of the process, current and future, is locked, and
+    /// the allocator kept from handing memory back to the system. The allocator keeps
+    /// that setting for the rest of the process.
+    bool isLockingMemory = true;
+    /// @brief The number of bytes of stack faulted in for the setting up thread and
+    /// each reader.
+    ::std::size_t stackPrefaultSize = 256 * 1024;
+    /// @brief The `SCHED_FIFO` priority of readers, or 0 to leave them to the default
+    /// scheduler.
+    int readerPriority = 0;
+    /// @brief Determines if readers are pinned to the cores isolated from the scheduler,
+    /// when there are any, rather than to any core.
+    bool isUsingIsolatedCpus = true;
+};
+
+/// @brief The setup of a latency-critical run, for as long as it lives.
+///
+/// Locking and prefaulting keep page faults out of the hot path, and readers scheduled
+/// first-in first-out on isolated cores are not preempted by the rest of the system.
+/// Structures with rings or arenas fault them in with their own `prefault()`, after
+/// which their snapshot, multiply and record paths allocate nothing. Every step is best
+/// effort, since it takes privileges a process may lack, and reports whether it took.
+class RealtimeMode final {
+public:
+    /// @brief Set up the process.
+    /// @param options The choices of the setup.
+    inline explicit RealtimeMode(const RealtimeOptions& options = RealtimeOptions()) :
+    _options(options), _isMemoryLocked(false) {
+#if defined(__linux__)
+        if (options.isLockingMemory) {
+#if defined(__GLIBC__)
+            // Freed memory stays in the heap, locked, and large blocks come from it too.
+            ::mallopt(M_TRIM_THRESHOLD, -1);
+            ::mallopt(M_MMAP_MAX, 0);
+#endif
+            _isMemoryLocked = ::mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+        }
+#endif
+        prefaultStack(options.stackPrefaultSize);
+        ::std::vector<unsigned int> isolated = options.isUsingIsolatedCpus ? isolatedCpus() : ::std::vector<unsigned int>();
+        if (isolated.empty()) {
+            for (unsigned int cpu = 0; cpu < ::std::max(1u, ::std::thread::hardware_concurrency()); cpu++) {
+                _readerCpus.push_back(cpu);
+            }
+        } else {
+            _readerCpus = isolated;
+        }
+    }
+    /// @brief Undo the setup of the process. Readers keep their scheduling, and the
+    /// allocator its settings, since glibc cannot tell what they were before.
+    inline ~RealtimeMode() {
+#if defined(__linux__)
+        if (_isMemoryLocked) ::munlockall();
+#endif
+    }
+
+    RealtimeMode(const RealtimeMode&) = delete;
+    RealtimeMode& operator=(const RealtimeMode&) = delete;
+
+    /// @brief Determines if all memory of the process is locked.
+    inline bool isMemoryLocked() const { return _isMemoryLocked; }
+    /// @brief The cores readers are pinned to, in order.
+    inline const ::std::vector<unsigned int>& readerCpus() const { return _readerCpus; }
+
+    /// @brief Make the calling thread a reader: pin it to a core, schedule it first-in
+    /// first-out if asked, and fault in its stack.
+    /// @param index The index of the reader, picking its core round-robin.
+    /// @return Whether the thread runs under `SCHED_FIFO`.
+    inline bool enterReader(unsigned int index) const {
+        prefaultStack(_options.stackPrefaultSize);
+        bool isFifo = false;
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(_readerCpus[index % _readerCpus.size()], &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (_options.readerPriority > 0) {
+            sched_param parameters = {};
+            parameters.sched_priority = _options.readerPriority;
+            isFifo = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters) == 0;
+        }
+#else
+        (void)index;
+#endif
+        return isFifo;
+    }
+
+    /// @brief Fault in the stack of the calling thread below the current frame.
+    /// @param size The number of bytes.
+    inline static void prefaultStack(::std::size_t size) {
+#if defined(__linux__)
+        if (size == 0) return;
+        volatile char* bytes = static_cast<volatile char*>(alloca(size));
+        for (::std::size_t i = 0; i < size; i += 4096) bytes[i] = 0;
+#else
+        (void)size;
+#endif
+    }
+
+    /// @brief The cores isolated from the scheduler, from the kernel's `isolcpus`.
+    inline static ::std::vector<unsigned int> isolatedCpus() {
+        ::std::ifstream file("/sys/devices/system/cpu/isolated");
+        ::std::string text;
+        if (!file || !::std::getline(file, text)) return {};
+        try {
+            return parseCpuList(text);
+        } catch (const ::std::invalid_argument&) {
+            return {};
+        }
+    }
+
+private:
+    /// @brief The choices of the setup.
+    const RealtimeOptions _options;
+    /// @brief Determines if all memory of the process is locked.
+    bool _isMemoryLocked;
+    /// @brief The cores readers are pinned to.
+    ::std::vector<unsigned int> _readerCpus;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
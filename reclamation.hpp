@@ -0,0 +1,179 @@
+/*
+
+File: reclamation.hpp
+Author: Aldhinn Espinas
+Description: This file contains the deferred freeing of objects that readers
+    without thread locks may still be reading.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(RECLAMATION_HEADER_FILE)
+#define RECLAMATION_HEADER_FILE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Defers the freeing of unpublished objects until no reader can still hold them.
+///
+/// Readers announce their read sections on counters striped by thread, which costs them
+/// an increment and a decrement on a cache line mostly their own, and no lock. Writers
+/// unpublish an object, then retire it. Retired objects are freed in batches, once every
+/// read section that was in progress has ended. Each batch moves new readers over to
+/// the other set of counters, so that they cannot hold it back. Objects have to be
+/// unpublished and loaded with sequentially consistent atomics.
+class EpochReclaimer final {
+public:
+    /// @brief The number of counters readers are striped over.
+    static constexpr unsigned int STRIPES = 16;
+    /// @brief The number of retired objects freed at once.
+    static constexpr ::std::size_t BATCH_SIZE = 64;
+
+    inline EpochReclaimer() : _parity(0) {
+        for (Stripe& stripe : _stripes) {
+            stripe.readers[0].store(0, ::std::memory_order_relaxed);
+            stripe.readers[1].store(0, ::std::memory_order_relaxed);
+        }
+    }
+    /// @brief Free the objects retired so far. No reader may be left.
+    inline ~EpochReclaimer() {
+        for (const Retired& retired : _retired) retired.destroy(retired.object);
+    }
+
+    EpochReclaimer(const EpochReclaimer&) = delete;
+    EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+    /// @brief Announce the start of a read section.
+    /// @return The counter to be handed to `endRead`.
+    inline ::std::atomic<::std::uint64_t>* beginRead() const noexcept {
+        ::std::atomic<::std::uint64_t>* counter =
+            &_stripes[stripeOfThread()].readers[_parity.load(::std::memory_order_relaxed)];
+        counter->fetch_add(1, ::std::memory_order_seq_cst);
+        return counter;
+    }
+    /// @brief Announce the end of a read section.
+    /// @param counter The counter returned by `beginRead`.
+    inline void endRead(::std::atomic<::std::uint64_t>* counter) const noexcept {
+        counter->fetch_sub(1, ::std::memory_order_release);
+    }
+
+    /// @brief Free an object once the readers that may hold it are done.
+    /// @param object The object, no longer reachable by new readers.
+    template <typename T>
+    inline void retire(const T* object) {
+        if (object == nullptr) return;
+        ::std::vector<Retired> batch;
+        {
+            ::std::lock_guard<::std::mutex> lock(_retiredMutex);
+            _retired.push_back({object, &destroy<T>});
+            if (_retired.size() < BATCH_SIZE) return;
+            batch.swap(_retired);
+        }
+        synchronize();
+        for (const Retired& retired : batch) retired.destroy(retired.object);
+    }
+
+    /// @brief Wait until every read section in progress has ended. It must not be
+    /// called from a read section.
+    inline void synchronize() {
+        // One at a time, or a flip could send new readers back to the counters drained.
+        ::std::lock_guard<::std::mutex> lock(_synchronizeMutex);
+        unsigned int parity = _parity.load(::std::memory_order_relaxed);
+        for (int round = 0; round < 2; round++) {
+            _parity.store(parity ^ 1, ::std::memory_order_seq_cst);
+            while (readersOf(parity) != 0) ::std::this_thread::yield();
+            parity ^= 1;
+        }
+    }
+
+private:
+    /// @brief The read sections of a group of threads, per parity.
+    struct alignas(64) Stripe {
+        /// @brief The number of read sections in progress.
+        ::std::atomic<::std::uint64_t> readers[2];
+    };
+    /// @brief An object waiting to be freed.
+    struct Retired {
+        /// @brief The object.
+        const void* object;
+        /// @brief Frees the object.
+        void (*destroy)(const void*);
+    };
+
+    template <typename T>
+    inline static void destroy(const void* object) { delete static_cast<const T*>(object); }
+    /// @brief The stripe of the calling thread, picked round-robin.
+    inline static unsigned int stripeOfThread() noexcept {
+        static ::std::atomic<unsigned int> nextStripe(0);
+        thread_local unsigned int stripe = nextStripe.fetch_add(1, ::std::memory_order_relaxed) % STRIPES;
+        return stripe;
+    }
+    /// @brief The number of read sections in progress on a parity.
+    inline ::std::uint64_t readersOf(unsigned int parity) const noexcept {
+        ::std::uint64_t count = 0;
+        for (const Stripe& stripe : _stripes) count += stripe.readers[parity].load(::std::memory_order_seq_cst);
+        return count;
+    }
+
+    /// @brief The read sections in progress.
+    mutable Stripe _stripes[STRIPES];
+    /// @brief The parity of the counters new readers announce themselves on.
+    ::std::atomic<unsigned int> _parity;
+    /// @brief Guards the objects retired.
+    ::std::mutex _retiredMutex;
+    /// @brief The objects retired and not freed yet.
+    ::std::vector<Retired> _retired;
+    /// @brief Serializes the waits for readers.
+    ::std::mutex _synchronizeMutex;
+};
+
+/// @brief Scoped read section of an `EpochReclaimer`.
+class EpochReadGuard final {
+public:
+    /// @brief Begin the read section.
+    /// @param reclaimer The reclaimer of the objects read.
+    inline explicit EpochReadGuard(const EpochReclaimer& reclaimer) noexcept :
+    _reclaimer(reclaimer), _counter(reclaimer.beginRead()) {}
+    /// @brief End the read section.
+    inline ~EpochReadGuard() {
+        _reclaimer.endRead(_counter);
+    }
+
+    EpochReadGuard(const EpochReadGuard&) = delete;
+    EpochReadGuard& operator=(const EpochReadGuard&) = delete;
+
+private:
+    /// @brief The reclaimer of the objects read.
+    const EpochReclaimer& _reclaimer;
+    /// @brief The counter the read section is announced on.
+    ::std::atomic<::std::uint64_t>* _counter;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
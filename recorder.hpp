@@ -0,0 +1,330 @@
+/*
+
+File: recorder.hpp
+Author: Aldhinn Espinas
+Description: This file contains the column-oriented storage of recorded multiplications
+    and its vectorized verification.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(RECORDER_HEADER_FILE)
+#define RECORDER_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "realtime.hpp"
+
+/// @brief A recording of multiplications that keeps each of the 48 elements of a record,
+/// 16 of each operand and 16 of the product, in an array of its own over all records.
+///
+/// The same element of consecutive records is contiguous, so verification runs over
+/// several records per instruction and streams through memory.
+class ColumnarRecorder final {
+public:
+    /// @brief The number of elements of a record.
+    static constexpr unsigned int SLOTS = 48;
+    /// @brief The first slot of the left hand-side matrix.
+    static constexpr unsigned int LEFT = 0;
+    /// @brief The first slot of the right hand-side matrix.
+    static constexpr unsigned int RIGHT = 16;
+    /// @brief The first slot of the dot product.
+    static constexpr unsigned int PRODUCT = 32;
+
+    /// @brief Construct an empty recording.
+    /// @param capacity The number of records to reserve memory for.
+    inline explicit ColumnarRecorder(::std::size_t capacity = 0) {
+        for (::std::vector<double>& column : _columns) column.reserve(capacity);
+    }
+
+    /// @brief Record a multiplication.
+    /// @param leftMat The left hand-side matrix.
+    /// @param rightMat The right hand-side matrix.
+    /// @param dotProduct The dot product.
+    inline void record(const Matrix4x4& leftMat, const Matrix4x4& rightMat, const Matrix4x4& dotProduct) {
+        for (unsigned int i = 0; i < 16; i++) {
+            _columns[LEFT + i].push_back(leftMat.data[i]);
+            _columns[RIGHT + i].push_back(rightMat.data[i]);
+            _columns[PRODUCT + i].push_back(dotProduct.data[i]);
+        }
+    }
+    /// @brief Record a multiplication of matrices containing atomic values, element by
+    /// element like `MultiplicationRecorder` copies them.
+    /// @param leftMat The left hand-side matrix.
+    /// @param rightMat The right hand-side matrix.
+    /// @param dotProduct The dot product.
+    inline void record(const AtomicMatrix4x4& leftMat, const AtomicMatrix4x4& rightMat,
+        const AtomicMatrix4x4& dotProduct) {
+        record(leftMat.snapshot(), rightMat.snapshot(), dotProduct.snapshot());
+    }
+
+    /// @brief The number of records.
+    inline ::std::size_t size() const { return _columns[0].size(); }
+    /// @brief The number of records that fit without allocating.
+    inline ::std::size_t capacity() const { return _columns[0].capacity(); }
+    /// @brief Fault in the memory reserved for records, and lock it in memory if asked.
+    /// Recording allocates nothing until the capacity is reached.
+    /// @return Whether the memory is locked.
+    inline bool prefault(bool isLocking = true) {
+        bool isLocked = true;
+        for (::std::vector<double>& column : _columns) {
+            // Growing within the capacity writes every page, shrinking back frees nothing.
+            ::std::size_t size = column.size();
+            column.resize(column.capacity());
+            isLocked = prefaultMemory(column.data(), column.size() * sizeof(double), isLocking) && isLocked;
+            column.resize(size);
+        }
+        return isLocked;
+    }
+    /// @brief Remove every record.
+    inline void clear() {
+        for (::std::vector<double>& column : _columns) column.clear();
+    }
+    /// @brief The array of an element over all records.
+    /// @param slot The element, from `LEFT`, `RIGHT` or `PRODUCT` plus the row-major index.
+    inline const double* column(unsigned int slot) const {
+        if (slot >= SLOTS) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        return _columns[slot].data();
+    }
+    /// @brief Gather a matrix of a record.
+    /// @param recordIndex The record.
+    /// @param firstSlot `LEFT`, `RIGHT` or `PRODUCT`.
+    inline Matrix4x4 matrix(::std::size_t recordIndex, unsigned int firstSlot) const {
+        if (recordIndex >= size() || firstSlot > PRODUCT || firstSlot % 16 != 0) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+        Matrix4x4 result;
+        for (unsigned int i = 0; i < 16; i++) result.data[i] = _columns[firstSlot + i][recordIndex];
+        return result;
+    }
+
+    /// @brief Verify every record exactly, like `MultiplicationRecorder::isCorrect`.
+    /// @param results Set to 1 for each correct record and 0 otherwise, if not null.
+    /// @return The number of correct records.
+    inline ::std::size_t verify(::std::uint8_t* results = nullptr) const {
+        const double* columns[SLOTS];
+        for (unsigned int slot = 0; slot < SLOTS; slot++) columns[slot] = _columns[slot].data();
+        // Chunks big enough for the threads to stream through memory.
+        const ::std::size_t CHUNK = 1 << 14;
+        ::std::vector<::std::size_t> chunkCounts((size() + CHUNK - 1) / CHUNK, 0);
+        parallelFor(0, chunkCounts.size(), 1, [&](::std::size_t chunkBegin, ::std::size_t chunkEnd) {
+            for (::std::size_t chunk = chunkBegin; chunk < chunkEnd; chunk++) {
+                ::std::size_t begin = chunk * CHUNK;
+                chunkCounts[chunk] = verifyRange(columns, begin, ::std::min(size(), begin + CHUNK), results);
+            }
+        });
+        ::std::size_t correct = 0;
+        for (::std::size_t count : chunkCounts) correct += count;
+        return correct;
+    }
+    /// @brief The percentage of correct records.
+    inline double accuracy() const {
+        return (static_cast<double>(verify()) * 100.0) / static_cast<double>(size());
+    }
+
+    /// @brief Verify a range of records, `PRODUCT == LEFT * RIGHT` with the summation
+    /// order of `AtomicMatrix4x4`.
+    /// @param columns The arrays of the 48 elements.
+    /// @param begin The first record.
+    /// @param end One past the last record.
+    /// @param results Set to 1 for each correct record and 0 otherwise, if not null.
+    /// @return The number of correct records.
+    inline static ::std::size_t verifyRange(const double* const* columns, ::std::size_t begin, ::std::size_t end,
+        ::std::uint8_t* results) {
+        ::std::size_t correct = 0;
+        ::std::size_t i = begin;
+#if defined(__AVX__)
+        for (; i + 4 <= end; i += 4) {
+            __m256d mismatch = _mm256_setzero_pd();
+            for (unsigned int row = 0; row < 4; row++) {
+                __m256d left[4];
+                for (unsigned int k = 0; k < 4; k++) left[k] = _mm256_loadu_pd(columns[LEFT + row * 4 + k] + i);
+                for (unsigned int col = 0; col < 4; col++) {
+                    __m256d sum = _mm256_mul_pd(left[0], _mm256_loadu_pd(columns[RIGHT + col] + i));
+                    for (unsigned int k = 1; k < 4; k++) {
+                        __m256d right = _mm256_loadu_pd(columns[RIGHT + k * 4 + col] + i);
+                        sum = _mm256_add_pd(sum, _mm256_mul_pd(left[k], right));
+                    }
+                    // Unordered compares as unequal, like NaN != NaN.
+                    mismatch = _mm256_or_pd(mismatch,
+                        _mm256_cmp_pd(sum, _mm256_loadu_pd(columns[PRODUCT + row * 4 + col] + i), _CMP_NEQ_UQ));
+                }
+            }
+            int mask = _mm256_movemask_pd(mismatch);
+            for (int lane = 0; lane < 4; lane++) {
+                bool isCorrect = (mask & (1 << lane)) == 0;
+                if (results != nullptr) results[i + lane] = isCorrect ? 1 : 0;
+                if (isCorrect) correct++;
+            }
+        }
+#endif
+        for (; i < end; i++) {
+            bool isCorrect = true;
+            for (unsigned int row = 0; row < 4 && isCorrect; row++) {
+                for (unsigned int col = 0; col < 4; col++) {
+                    double sum = columns[LEFT + row * 4][i] * columns[RIGHT + col][i];
+                    for (unsigned int k = 1; k < 4; k++) {
+                        sum += columns[LEFT + row * 4 + k][i] * columns[RIGHT + k * 4 + col][i];
+                    }
+                    if (sum != columns[PRODUCT + row * 4 + col][i]) {
+                        isCorrect = false;
+                        break;
+                    }
+                }
+            }
+            if (results != nullptr) results[i] = isCorrect ? 1 : 0;
+            if (isCorrect) correct++;
+        }
+        return correct;
+    }
+
+private:
+    /// @brief The array of each element over all records.
+    ::std::vector<double> _columns[SLOTS];
+};
+
+/// @brief A multiplication that failed verification.
+struct FailureRecord {
+    /// @brief The left hand-side matrix.
+    Matrix4x4 leftMat;
+    /// @brief The right hand-side matrix.
+    Matrix4x4 rightMat;
+    /// @brief The recorded dot product.
+    Matrix4x4 dotProduct;
+    /// @brief The position of the multiplication among all recorded ones.
+    unsigned long long sequence;
+};
+
+/// @brief A recording that verifies multiplications as they are recorded and only keeps
+/// counters, plus a uniform sample of the failures in a bounded reservoir.
+///
+/// Memory stays bounded whatever the length of the run, and correct multiplications
+/// only cost their verification and two relaxed counter increments.
+class FailureRecorder final {
+public:
+    /// @brief Construct an empty recording.
+    /// @param reservoirCapacity The number of failures kept at most.
+    /// @param seed The seed of the reservoir sampling.
+    inline explicit FailureRecorder(::std::size_t reservoirCapacity = 64, ::std::uint64_t seed = 1) :
+    _recorded(0), _failed(0), _reservoirCapacity(reservoirCapacity), _random(seed) {
+        _reservoir.reserve(reservoirCapacity);
+    }
+
+    FailureRecorder(const FailureRecorder&) = delete;
+    FailureRecorder& operator=(const FailureRecorder&) = delete;
+
+    /// @brief Verify and record a multiplication, exactly like `MultiplicationRecorder::isCorrect`.
+    /// May be called from several threads.
+    /// @param leftMat The left hand-side matrix.
+    /// @param rightMat The right hand-side matrix.
+    /// @param dotProduct The dot product.
+    /// @return Whether the multiplication is correct.
+    inline bool record(const Matrix4x4& leftMat, const Matrix4x4& rightMat, const Matrix4x4& dotProduct) {
+        unsigned long long sequence = _recorded.fetch_add(1, ::std::memory_order_relaxed);
+        if (leftMat * rightMat == dotProduct) return true;
+
+        unsigned long long failures = _failed.fetch_add(1, ::std::memory_order_relaxed) + 1;
+        // Algorithm R: the n-th failure replaces a random slot with probability capacity / n.
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        if (_reservoir.size() < _reservoirCapacity) {
+            _reservoir.push_back({leftMat, rightMat, dotProduct, sequence});
+        } else if (_reservoirCapacity > 0) {
+            unsigned long long slot = ::std::uniform_int_distribution<unsigned long long>(0, failures - 1)(_random);
+            if (slot < _reservoirCapacity) _reservoir[slot] = {leftMat, rightMat, dotProduct, sequence};
+        }
+        return false;
+    }
+    /// @brief Verify and record a multiplication of matrices containing atomic values.
+    /// @param leftMat The left hand-side matrix.
+    /// @param rightMat The right hand-side matrix.
+    /// @param dotProduct The dot product.
+    /// @return Whether the multiplication is correct.
+    inline bool record(const AtomicMatrix4x4& leftMat, const AtomicMatrix4x4& rightMat,
+        const AtomicMatrix4x4& dotProduct) {
+        return record(leftMat.snapshot(), rightMat.snapshot(), dotProduct.snapshot());
+    }
+
+    /// @brief Fault in the reservoir, and lock it in memory if asked. Recording allocates
+    /// nothing, the reservoir being reserved up front.
+    /// @return Whether the reservoir is locked.
+    inline bool prefault(bool isLocking = true) {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        return prefaultMemory(_reservoir.data(), _reservoir.capacity() * sizeof(FailureRecord), isLocking);
+    }
+
+    /// @brief The number of recorded multiplications.
+    inline unsigned long long recorded() const { return _recorded.load(::std::memory_order_relaxed); }
+    /// @brief The number of multiplications that failed verification.
+    inline unsigned long long failed() const { return _failed.load(::std::memory_order_relaxed); }
+    /// @brief The percentage of correct multiplications.
+    inline double accuracy() const {
+        unsigned long long total = recorded();
+        return (static_cast<double>(total - failed()) * 100.0) / static_cast<double>(total);
+    }
+    /// @brief A copy of the sampled failures.
+    inline ::std::vector<FailureRecord> failures() const {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        return _reservoir;
+    }
+    /// @brief Reset the counters and drop the sampled failures.
+    inline void clear() {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        _reservoir.clear();
+        _recorded.store(0);
+        _failed.store(0);
+    }
+
+private:
+    /// @brief The number of recorded multiplications.
+    ::std::atomic<unsigned long long> _recorded;
+    /// @brief The number of multiplications that failed verification.
+    ::std::atomic<unsigned long long> _failed;
+    /// @brief The number of failures kept at most.
+    const ::std::size_t _reservoirCapacity;
+    /// @brief The sampled failures.
+    ::std::vector<FailureRecord> _reservoir;
+    /// @brief The random number generator of the sampling.
+    ::std::mt19937_64 _random;
+    /// @brief Guards the reservoir. Only taken on failures.
+    mutable ::std::mutex _mutex;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
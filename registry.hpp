@@ -0,0 +1,352 @@
+/*
+
+File: registry.hpp
+Author: Aldhinn Espinas
+Description: This file contains a concurrent registry of matrices by key, with
+    consistent snapshots of groups of keys.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(REGISTRY_HEADER_FILE)
+#define REGISTRY_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.hpp"
+#include "reclamation.hpp"
+#include "seqlock.hpp"
+
+/// @brief A concurrent map from keys to matrices.
+///
+/// The keys are spread over shards, each a hash table whose lookups take no lock and
+/// write no shared cache line: buckets, tables and values are published with plain
+/// atomic pointers, and a growing table is rebuilt on the side and swapped in. Each
+/// matrix is an immutable value replaced as a whole. Replaced values and tables are
+/// freed by an `EpochReclaimer` once the lookups that may hold them are done.
+///
+/// Every change runs as a write section of a single registry-wide epoch. A group
+/// snapshot reads the values of its keys and checks that the epoch did not move in
+/// between, so it sees a state the registry really had, and a bulk update is seen
+/// either entirely or not at all.
+/// @tparam Key The key type, such as a string or an integer.
+/// @tparam Hash The hash of the keys.
+template <typename Key, typename Hash = ::std::hash<Key>>
+class MatrixRegistry final {
+public:
+    /// @brief A change of a bulk update.
+    struct Update {
+        /// @brief The key, inserted if missing.
+        Key key;
+        /// @brief The new value.
+        Matrix4x4 value;
+    };
+
+    /// @brief Construct an empty registry.
+    /// @param shardCount The number of shards, rounded up to a power of 2.
+    inline explicit MatrixRegistry(unsigned int shardCount = 64) :
+    _shards(roundUpToPowerOf2(shardCount)), _shardMask(_shards.size() - 1), _size(0) {}
+    inline ~MatrixRegistry() {
+        for (Shard& shard : _shards) {
+            delete shard.table.load(::std::memory_order_relaxed);
+            for (const ::std::unique_ptr<Slot>& slot : shard.slots) delete slot->value.load(::std::memory_order_relaxed);
+        }
+    }
+
+    MatrixRegistry(const MatrixRegistry&) = delete;
+    MatrixRegistry& operator=(const MatrixRegistry&) = delete;
+
+    /// @brief The number of keys.
+    inline ::std::size_t size() const { return _size.load(::std::memory_order_relaxed); }
+    /// @brief The number of changes so far.
+    inline ::std::uint64_t epoch() const { return _epoch.version(); }
+
+    /// @brief The keys present. Each shard is read at a different moment.
+    inline ::std::vector<Key> keys() const {
+        ::std::vector<Key> result;
+        for (const Shard& shard : _shards) {
+            ::std::lock_guard<::std::mutex> lock(shard.mutex);
+            for (const ::std::unique_ptr<Slot>& slot : shard.slots) {
+                if (slot->value.load(::std::memory_order_relaxed) != nullptr) result.push_back(slot->key);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Determines if a key is present.
+    inline bool contains(const Key& key) const {
+        EpochReadGuard guard(_reclaimer);
+        const Slot* slot = find(key, hashOf(key));
+        return slot != nullptr && slot->value.load(::std::memory_order_seq_cst) != nullptr;
+    }
+    /// @brief Get the matrix of a key.
+    /// @param key The key.
+    /// @param value Set to the matrix if the key is present.
+    /// @return Whether the key is present.
+    inline bool load(const Key& key, Matrix4x4& value) const {
+        EpochReadGuard guard(_reclaimer);
+        const Slot* slot = find(key, hashOf(key));
+        if (slot == nullptr) return false;
+        const Matrix4x4* current = slot->value.load(::std::memory_order_seq_cst);
+        if (current == nullptr) return false;
+        value = *current;
+        return true;
+    }
+    /// @brief Get the matrix of a key.
+    /// @param key The key, which has to be present.
+    inline Matrix4x4 load(const Key& key) const {
+        Matrix4x4 value;
+        if (!load(key, value)) {
+            throw ::std::out_of_range("Unknown key.");
+        }
+        return value;
+    }
+
+    /// @brief Add a key if it is missing.
+    /// @param key The key.
+    /// @param value The matrix of the key.
+    /// @return Whether the key was added.
+    inline bool insert(const Key& key, const Matrix4x4& value = Matrix4x4::identity()) {
+        ::std::size_t hash = hashOf(key);
+        Shard& shard = shardOf(hash);
+        ::std::unique_ptr<const Matrix4x4> newValue(new Matrix4x4(value));
+        ::std::lock_guard<::std::mutex> lock(shard.mutex);
+        Slot* slot = findOrAdd(shard, key, hash);
+        if (slot->value.load(::std::memory_order_relaxed) != nullptr) return false;
+        SeqLockWriteGuard guard(_epoch);
+        slot->value.store(newValue.release(), ::std::memory_order_seq_cst);
+        _size.fetch_add(1, ::std::memory_order_relaxed);
+        return true;
+    }
+    /// @brief Set the matrix of a key, adding the key if it is missing.
+    /// @param key The key.
+    /// @param value The new matrix.
+    inline void store(const Key& key, const Matrix4x4& value) {
+        update({{key, value}});
+    }
+    /// @brief Remove a key.
+    /// @param key The key.
+    /// @return Whether the key was present.
+    inline bool erase(const Key& key) {
+        ::std::size_t hash = hashOf(key);
+        Shard& shard = shardOf(hash);
+        const Matrix4x4* previous = nullptr;
+        {
+            ::std::lock_guard<::std::mutex> lock(shard.mutex);
+            Slot* slot = find(key, hash);
+            if (slot == nullptr || slot->value.load(::std::memory_order_relaxed) == nullptr) return false;
+            // The slot stays for lookups in flight, and for the key to come back.
+            SeqLockWriteGuard guard(_epoch);
+            previous = slot->value.exchange(nullptr, ::std::memory_order_seq_cst);
+            _size.fetch_sub(1, ::std::memory_order_relaxed);
+        }
+        // Out of the write section, which snapshots may be waiting on.
+        _reclaimer.retire(previous);
+        return true;
+    }
+
+    /// @brief Apply a batch of changes as one, adding the missing keys. A group snapshot
+    /// sees either none or all of the batch.
+    /// @param updates The changes. A key changed twice ends up with its last value.
+    inline void update(const ::std::vector<Update>& updates) {
+        if (updates.empty()) return;
+        ::std::vector<::std::size_t> hashes(updates.size());
+        ::std::vector<::std::unique_ptr<const Matrix4x4>> values(updates.size());
+        ::std::vector<bool> isShardUsed(_shards.size(), false);
+        for (::std::size_t i = 0; i < updates.size(); i++) {
+            hashes[i] = hashOf(updates[i].key);
+            values[i].reset(new Matrix4x4(updates[i].value));
+            isShardUsed[hashes[i] & _shardMask] = true;
+        }
+        ::std::vector<const Matrix4x4*> previous(updates.size());
+        {
+            // In increasing order of shard, so that concurrent batches cannot deadlock.
+            ::std::vector<::std::unique_lock<::std::mutex>> locks;
+            for (::std::size_t shard = 0; shard < _shards.size(); shard++) {
+                if (isShardUsed[shard]) locks.emplace_back(_shards[shard].mutex);
+            }
+            ::std::vector<Slot*> slots(updates.size());
+            for (::std::size_t i = 0; i < updates.size(); i++) {
+                slots[i] = findOrAdd(shardOf(hashes[i]), updates[i].key, hashes[i]);
+            }
+
+            SeqLockWriteGuard guard(_epoch);
+            for (::std::size_t i = 0; i < updates.size(); i++) {
+                previous[i] = slots[i]->value.exchange(values[i].release(), ::std::memory_order_seq_cst);
+                if (previous[i] == nullptr) _size.fetch_add(1, ::std::memory_order_relaxed);
+            }
+        }
+        // Out of the write section, which snapshots may be waiting on.
+        for (const Matrix4x4* value : previous) _reclaimer.retire(value);
+    }
+
+    /// @brief Read the matrices of a group of keys as they were at a single moment.
+    /// @param keys The keys, which have to be present.
+    /// @param epoch Set to the epoch the snapshot was taken at, if not null.
+    /// @return The matrices, in the order of the keys.
+    inline ::std::vector<Matrix4x4> snapshot(const ::std::vector<Key>& keys, ::std::uint64_t* epoch = nullptr) const {
+        EpochReadGuard guard(_reclaimer);
+        ::std::vector<const Slot*> slots(keys.size());
+        for (::std::size_t i = 0; i < keys.size(); i++) {
+            slots[i] = find(keys[i], hashOf(keys[i]));
+            if (slots[i] == nullptr) {
+                throw ::std::out_of_range("Unknown key.");
+            }
+        }
+        ::std::vector<const Matrix4x4*> values(keys.size());
+        ::std::uint64_t version = _epoch.read([&]() {
+            for (::std::size_t i = 0; i < slots.size(); i++) values[i] = slots[i]->value.load(::std::memory_order_seq_cst);
+        });
+        ::std::vector<Matrix4x4> result(keys.size());
+        for (::std::size_t i = 0; i < keys.size(); i++) {
+            if (values[i] == nullptr) {
+                throw ::std::out_of_range("Unknown key.");
+            }
+            result[i] = *values[i];
+        }
+        if (epoch != nullptr) *epoch = version;
+        return result;
+    }
+
+private:
+    /// @brief A key and its matrix. Never freed before the registry, so lookups can
+    /// hold on to it without a lock, unlike the matrix.
+    struct Slot {
+        /// @brief The key.
+        Key key;
+        /// @brief The mixed hash of the key.
+        ::std::size_t hash;
+        /// @brief The matrix, null if the key was removed.
+        ::std::atomic<const Matrix4x4*> value;
+    };
+    /// @brief An entry of a bucket chain.
+    struct Link {
+        /// @brief The slot.
+        Slot* slot;
+        /// @brief The next entry of the chain.
+        ::std::atomic<Link*> next;
+    };
+    /// @brief The buckets of a shard. Replaced as a whole when growing.
+    struct Table {
+        /// @brief The first entry of each bucket chain.
+        ::std::unique_ptr<::std::atomic<Link*>[]> heads;
+        /// @brief The number of buckets minus 1.
+        ::std::size_t mask;
+        /// @brief Owns the entries of the chains.
+        ::std::vector<::std::unique_ptr<Link>> links;
+    };
+    /// @brief A shard, on cache lines of its own.
+    struct alignas(64) Shard {
+        /// @brief Serializes the changes of the shard.
+        mutable ::std::mutex mutex;
+        /// @brief The current buckets, null until the first key.
+        ::std::atomic<Table*> table{nullptr};
+        /// @brief Owns the slots of the shard.
+        ::std::vector<::std::unique_ptr<Slot>> slots;
+    };
+
+    inline static ::std::size_t roundUpToPowerOf2(unsigned int count) {
+        ::std::size_t result = 1;
+        while (result < count) result *= 2;
+        return result;
+    }
+    /// @brief Mix the hash, since the standard hash of integers is the identity.
+    inline static ::std::size_t hashOf(const Key& key) {
+        ::std::uint64_t hash = static_cast<::std::uint64_t>(Hash()(key));
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return static_cast<::std::size_t>(hash);
+    }
+    inline Shard& shardOf(::std::size_t hash) { return _shards[hash & _shardMask]; }
+    inline const Shard& shardOf(::std::size_t hash) const { return _shards[hash & _shardMask]; }
+    /// @brief The bucket of a hash. The low bits already picked the shard.
+    inline static ::std::size_t bucketOf(::std::size_t hash, ::std::size_t mask) { return (hash >> 16) & mask; }
+
+    /// @brief Find the slot of a key, without a lock. Readers have to be in a read
+    /// section of the reclaimer, writers hold the lock of the shard.
+    inline Slot* find(const Key& key, ::std::size_t hash) const {
+        const Table* table = shardOf(hash).table.load(::std::memory_order_seq_cst);
+        if (table == nullptr) return nullptr;
+        Link* link = table->heads[bucketOf(hash, table->mask)].load(::std::memory_order_acquire);
+        for (; link != nullptr; link = link->next.load(::std::memory_order_acquire)) {
+            if (link->slot->hash == hash && link->slot->key == key) return link->slot;
+        }
+        return nullptr;
+    }
+    /// @brief Find the slot of a key, or add an empty one. The shard needs to be locked.
+    inline Slot* findOrAdd(Shard& shard, const Key& key, ::std::size_t hash) {
+        Slot* slot = find(key, hash);
+        if (slot != nullptr) return slot;
+        shard.slots.emplace_back(new Slot{key, hash, nullptr});
+        slot = shard.slots.back().get();
+
+        Table* table = shard.table.load(::std::memory_order_relaxed);
+        if (table == nullptr || shard.slots.size() > 2 * (table->mask + 1)) {
+            // Chains are only ever prepended to, so the new table gets chains of its own
+            // and lookups still walking the old one are not disturbed.
+            ::std::size_t bucketCount = table == nullptr ? 16 : 4 * (table->mask + 1);
+            ::std::unique_ptr<Table> grown(new Table());
+            grown->heads.reset(new ::std::atomic<Link*>[bucketCount]);
+            grown->mask = bucketCount - 1;
+            for (::std::size_t i = 0; i < bucketCount; i++) grown->heads[i].store(nullptr, ::std::memory_order_relaxed);
+            for (const ::std::unique_ptr<Slot>& existing : shard.slots) link(*grown, existing.get());
+            shard.table.store(grown.release(), ::std::memory_order_seq_cst);
+            _reclaimer.retire(table);
+        } else {
+            link(*table, slot);
+        }
+        return slot;
+    }
+    /// @brief Prepend a slot to its bucket chain.
+    inline static void link(Table& table, Slot* slot) {
+        ::std::atomic<Link*>& head = table.heads[bucketOf(slot->hash, table.mask)];
+        table.links.emplace_back(new Link{slot, {head.load(::std::memory_order_relaxed)}});
+        head.store(table.links.back().get(), ::std::memory_order_release);
+    }
+
+private:
+    /// @brief The shards.
+    ::std::vector<Shard> _shards;
+    /// @brief The number of shards minus 1.
+    ::std::size_t _shardMask;
+    /// @brief The number of keys.
+    ::std::atomic<::std::size_t> _size;
+    /// @brief The epoch of the changes, checked by group snapshots.
+    SeqLock _epoch;
+    /// @brief Frees the values and tables replaced.
+    EpochReclaimer _reclaimer;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+
+File: seqlock.hpp
+Author: Aldhinn Espinas
+Description: This file contains the sequence lock used to take consistent
+    snapshots of data that is written concurrently without thread locks.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(SEQLOCK_HEADER_FILE)
+#define SEQLOCK_HEADER_FILE
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+/// @brief A sequence lock that allows concurrent writers of disjoint data.
+///
+/// Writers only announce the start and the end of their write section, and do not
+/// exclude each other: two writers of the same data would leave a mix of both writes,
+/// which readers accept once both sections ended. Writers of overlapping data have to
+/// be serialized by the caller. Readers read optimistically and retry when a write
+/// section overlapped their read. A reader that keeps failing may ask for priority,
+/// which makes new writers yield until that reader is done.
+class SeqLock final {
+public:
+    /// @brief The version type handed to readers.
+    using Version = ::std::uint64_t;
+
+    inline SeqLock() : _started(0), _finished(0), _priorityReaders(0) {}
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    /// @brief Announce the start of a write section.
+    inline void beginWrite() noexcept {
+        // Let a starving reader finish before starting a new write section.
+        while (_priorityReaders.load(::std::memory_order_relaxed) != 0) {
+            ::std::this_thread::yield();
+        }
+        // Sequentially consistent so that the announcement is globally visible
+        // before any of the stores of the write section.
+        _started.fetch_add(1, ::std::memory_order_seq_cst);
+        ::std::atomic_thread_fence(::std::memory_order_release);
+    }
+    /// @brief Announce the end of a write section.
+    inline void endWrite() noexcept {
+        _finished.fetch_add(1, ::std::memory_order_release);
+    }
+
+    /// @brief Wait until no write section is in progress and start reading.
+    /// @return The version to be validated with `readRetry`.
+    inline Version readBegin() const noexcept {
+        for (;;) {
+            Version started = _started.load(::std::memory_order_acquire);
+            if (_finished.load(::std::memory_order_acquire) == started) return started;
+            ::std::this_thread::yield();
+        }
+    }
+    /// @brief Determines if the data read since `readBegin` may be inconsistent.
+    /// @param version The version returned by `readBegin`.
+    /// @return Whether the read has to be repeated.
+    inline bool readRetry(Version version) const noexcept {
+        ::std::atomic_thread_fence(::std::memory_order_acquire);
+        return _started.load(::std::memory_order_relaxed) != version;
+    }
+
+    /// @brief Run `reader` until it observed a state that no writer was modifying.
+    /// @param reader The callable that reads the protected data.
+    /// @param optimisticAttempts The number of attempts before writers are held back.
+    /// @return The version at which the data was read.
+    template <typename Reader>
+    inline Version read(Reader&& reader, unsigned int optimisticAttempts = 64) const {
+        for (unsigned int attempt = 0; attempt < optimisticAttempts; attempt++) {
+            Version version = readBegin();
+            reader();
+            if (!readRetry(version)) return version;
+        }
+        // Too many overlapping writes. Hold new writers back until the read succeeds.
+        _priorityReaders.fetch_add(1, ::std::memory_order_seq_cst);
+        Version version;
+        do {
+            version = readBegin();
+            reader();
+        } while (readRetry(version));
+        _priorityReaders.fetch_sub(1, ::std::memory_order_release);
+        return version;
+    }
+
+    /// @brief Wait until every write section that has been started is finished.
+    inline void waitForWriters() const noexcept {
+        while (_finished.load(::std::memory_order_seq_cst) != _started.load(::std::memory_order_seq_cst)) {
+            ::std::this_thread::yield();
+        }
+    }
+
+    /// @brief The number of write sections started so far.
+    inline Version version() const noexcept {
+        return _started.load(::std::memory_order_acquire);
+    }
+
+private:
+    /// @brief The number of write sections started.
+    ::std::atomic<Version> _started;
+    /// @brief The number of write sections finished.
+    ::std::atomic<Version> _finished;
+    /// @brief The number of readers that asked for priority over writers.
+    mutable ::std::atomic<unsigned int> _priorityReaders;
+};
+
+/// @brief Scoped write section of a `SeqLock`.
+class SeqLockWriteGuard final {
+public:
+    /// @brief Begin the write section.
+    /// @param seqLock The sequence lock to write under.
+    inline explicit SeqLockWriteGuard(SeqLock& seqLock) noexcept : _seqLock(seqLock) {
+        _seqLock.beginWrite();
+    }
+    /// @brief End the write section.
+    inline ~SeqLockWriteGuard() {
+        _seqLock.endWrite();
+    }
+
+    SeqLockWriteGuard(const SeqLockWriteGuard&) = delete;
+    SeqLockWriteGuard& operator=(const SeqLockWriteGuard&) = delete;
+
+private:
+    /// @brief The sequence lock being written under.
+    SeqLock& _seqLock;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,426 @@
+/*
+
+File: shard.hpp
+Author: Aldhinn Espinas
+Description: This file contains a store of matrices partitioned across cores, where
+    each core owns its shard and other cores reach it through message rings.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(SHARD_HEADER_FILE)
+#define SHARD_HEADER_FILE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "matrix.hpp"
+#include "parallel.hpp"
+#include "realtime.hpp"
+
+/// @brief A bounded queue from a single producer thread to a single consumer thread.
+///
+/// Pushes are staged and only made visible by `publish()`, and a consumer takes every
+/// visible item at once, so each side touches the shared indices once per batch rather
+/// than once per item.
+/// @tparam T The item type.
+template <typename T>
+class SpscRing final {
+public:
+    /// @brief Construct an empty ring.
+    /// @param capacity The number of items, rounded up to a power of 2.
+    inline explicit SpscRing(::std::size_t capacity) : _mask(0), _tail(0), _cachedHead(0),
+    _publishedTail(0), _head(0), _cachedTail(0) {
+        ::std::size_t size = 1;
+        while (size < capacity) size *= 2;
+        _items.reset(new T[size]);
+        _mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /// @brief Stage an item. Producer only.
+    /// @return Whether there was room.
+    inline bool tryPush(const T& item) {
+        if (_tail - _cachedHead > _mask) {
+            _cachedHead = _head.load(::std::memory_order_acquire);
+            if (_tail - _cachedHead > _mask) return false;
+        }
+        _items[_tail & _mask] = item;
+        _tail++;
+        return true;
+    }
+    /// @brief Make the staged items visible to the consumer. Producer only.
+    inline void publish() {
+        _publishedTail.store(_tail, ::std::memory_order_release);
+    }
+
+    /// @brief Take every visible item. Consumer only.
+    /// @param consumer The callable run on each item, in order.
+    /// @return The number of items taken.
+    template <typename Consumer>
+    inline ::std::size_t consume(Consumer&& consumer) {
+        ::std::size_t head = _head.load(::std::memory_order_relaxed);
+        if (head == _cachedTail) {
+            _cachedTail = _publishedTail.load(::std::memory_order_acquire);
+            if (head == _cachedTail) return 0;
+        }
+        ::std::size_t count = _cachedTail - head;
+        for (::std::size_t i = head; i != _cachedTail; i++) consumer(_items[i & _mask]);
+        _head.store(_cachedTail, ::std::memory_order_release);
+        return count;
+    }
+
+    /// @brief Fault in the items, and lock them in memory if asked.
+    /// @return Whether the items are locked.
+    inline bool prefault(bool isLocking = true) const {
+        return prefaultMemory(_items.get(), (_mask + 1) * sizeof(T), isLocking);
+    }
+
+private:
+    /// @brief The items.
+    ::std::unique_ptr<T[]> _items;
+    /// @brief The capacity minus 1.
+    ::std::size_t _mask;
+    /// @brief The next item to stage. Producer only.
+    alignas(64) ::std::size_t _tail;
+    /// @brief The last head seen by the producer.
+    ::std::size_t _cachedHead;
+    /// @brief One past the last published item.
+    alignas(64) ::std::atomic<::std::size_t> _publishedTail;
+    /// @brief The next item to consume.
+    alignas(64) ::std::atomic<::std::size_t> _head;
+    /// @brief The last published tail seen by the consumer.
+    alignas(64) ::std::size_t _cachedTail;
+};
+
+/// @brief A store of matrices partitioned across cores, without shared mutable data.
+///
+/// Each core runs a thread that owns the matrices whose key modulo the core count is
+/// its index, in plain storage. Operations on the matrices of another core are sent as
+/// messages through a ring for each ordered pair of cores, and answered the same way.
+/// A core serves the requests of others whenever it waits, so cores never block on
+/// each other.
+class ShardedMatrixStore final {
+public:
+    /// @brief The number of messages of a ring.
+    static constexpr ::std::size_t RING_CAPACITY = 64;
+    /// @brief The number of messages staged before a ring is published.
+    static constexpr ::std::size_t BATCH_SIZE = 16;
+
+    /// @brief The view of the store from one core, handed to the task of that core.
+    class Core final {
+    public:
+        /// @brief The index of the core.
+        inline unsigned int index() const { return _index; }
+        /// @brief Determines if a matrix belongs to this core.
+        inline bool isLocal(::std::uint64_t key) const { return _store->ownerOf(key) == _index; }
+
+        /// @brief Read a matrix.
+        inline Matrix4x4 load(::std::uint64_t key) {
+            Matrix4x4 result;
+            loadBatch(&key, 1, &result);
+            return result;
+        }
+        /// @brief Read matrices, with the requests to each core sent together.
+        /// @param keys The keys.
+        /// @param count The number of keys.
+        /// @param results Receives the matrices.
+        inline void loadBatch(const ::std::uint64_t* keys, ::std::size_t count, Matrix4x4* results) {
+            // Checked up front, since the replies of requests already sent would land in
+            // results that are gone once this throws.
+            for (::std::size_t i = 0; i < count; i++) _store->checkKey(keys[i]);
+            _results = results;
+            for (::std::size_t i = 0; i < count; i++) {
+                if (isLocal(keys[i])) {
+                    results[i] = local(keys[i]);
+                } else {
+                    _pendingReplies++;
+                    send(_store->ownerOf(keys[i]), {Matrix4x4(), keys[i], i, MessageKind::Load, _index});
+                }
+            }
+            while (_pendingReplies != 0) {
+                flush();
+                if (poll() == 0) ::std::this_thread::yield();
+            }
+            _results = nullptr;
+        }
+        /// @brief Overwrite a matrix. Remote writes are sent without waiting.
+        inline void store(::std::uint64_t key, const Matrix4x4& value) {
+            apply({value, key, 0, MessageKind::Store, _index});
+        }
+        /// @brief Add to a matrix. Remote additions are sent without waiting.
+        inline void add(::std::uint64_t key, const Matrix4x4& delta) {
+            apply({delta, key, 0, MessageKind::Add, _index});
+        }
+        /// @brief Multiply a matrix on the right. Remote products are sent without waiting.
+        inline void multiply(::std::uint64_t key, const Matrix4x4& operand) {
+            apply({operand, key, 0, MessageKind::Multiply, _index});
+        }
+
+        /// @brief Publish every message sent so far.
+        inline void flush() {
+            for (unsigned int target = 0; target < _backlogs.size(); target++) {
+                ::std::deque<Message>& backlog = _backlogs[target];
+                if (backlog.empty() && _staged[target] == 0) continue;
+                SpscRing<Message>& ring = _store->ring(_index, target);
+                while (!backlog.empty() && ring.tryPush(backlog.front())) backlog.pop_front();
+                ring.publish();
+                _staged[target] = 0;
+            }
+        }
+        /// @brief Serve the messages received so far.
+        /// @return The number of messages served.
+        inline ::std::size_t poll() {
+            ::std::size_t served = 0;
+            for (unsigned int source = 0; source < _store->_coreCount; source++) {
+                if (source == _index) continue;
+                served += _store->ring(source, _index).consume([this](const Message& message) { serve(message); });
+            }
+            return served;
+        }
+
+    private:
+        friend class ShardedMatrixStore;
+
+        /// @brief The kinds of messages.
+        enum class MessageKind : unsigned int { Load, Store, Add, Multiply, Reply };
+        /// @brief A request to the owner of a matrix, or its reply.
+        struct Message {
+            /// @brief The operand, or the matrix read.
+            Matrix4x4 value;
+            /// @brief The key.
+            ::std::uint64_t key;
+            /// @brief The index of the result a reply is for.
+            ::std::size_t tag;
+            /// @brief The kind.
+            MessageKind kind;
+            /// @brief The core that sent the message.
+            unsigned int from;
+        };
+
+        inline Core(ShardedMatrixStore* store, unsigned int index, const Matrix4x4& values) :
+        _store(store), _index(index), _backlogs(store->_coreCount), _staged(store->_coreCount, 0),
+        _results(nullptr), _pendingReplies(0) {
+            ::std::size_t count = store->_matrixCount / store->_coreCount
+                + (index < store->_matrixCount % store->_coreCount ? 1 : 0);
+            _matrices.assign(count, values);
+        }
+
+        inline Matrix4x4& local(::std::uint64_t key) { return _matrices[key / _store->_coreCount]; }
+
+        /// @brief Run an update here, or send it to the owner.
+        inline void apply(const Message& message) {
+            _store->checkKey(message.key);
+            if (isLocal(message.key)) {
+                serve(message);
+            } else {
+                send(_store->ownerOf(message.key), message);
+            }
+        }
+        /// @brief Stage a message, keeping it aside while the ring is full.
+        inline void send(unsigned int target, const Message& message) {
+            ::std::deque<Message>& backlog = _backlogs[target];
+            if (!backlog.empty() || !_store->ring(_index, target).tryPush(message)) {
+                backlog.push_back(message);
+                return;
+            }
+            if (++_staged[target] >= BATCH_SIZE) {
+                _store->ring(_index, target).publish();
+                _staged[target] = 0;
+            }
+        }
+        /// @brief Run a message on the matrices of this core.
+        inline void serve(const Message& message) {
+            switch (message.kind) {
+            case MessageKind::Load:
+                send(message.from, {local(message.key), message.key, message.tag, MessageKind::Reply, _index});
+                break;
+            case MessageKind::Store: local(message.key) = message.value; break;
+            case MessageKind::Add: local(message.key) = local(message.key) + message.value; break;
+            case MessageKind::Multiply: local(message.key) = local(message.key) * message.value; break;
+            case MessageKind::Reply:
+                _results[message.tag] = message.value;
+                _pendingReplies--;
+                break;
+            }
+        }
+        /// @brief Determines if every message sent has made it into a ring.
+        inline bool isBacklogEmpty() const {
+            for (const ::std::deque<Message>& backlog : _backlogs) {
+                if (!backlog.empty()) return false;
+            }
+            return true;
+        }
+
+        /// @brief The store.
+        ShardedMatrixStore* _store;
+        /// @brief The index of the core.
+        const unsigned int _index;
+        /// @brief The matrices owned by the core, by key divided by the core count.
+        ::std::vector<Matrix4x4> _matrices;
+        /// @brief The messages to each core that did not fit its ring yet.
+        ::std::vector<::std::deque<Message>> _backlogs;
+        /// @brief The number of unpublished messages to each core.
+        ::std::vector<::std::size_t> _staged;
+        /// @brief Receives the matrices of the current `loadBatch`.
+        Matrix4x4* _results;
+        /// @brief The number of replies the current `loadBatch` waits for.
+        ::std::size_t _pendingReplies;
+    };
+
+    /// @brief Construct the store.
+    /// @param matrixCount The number of matrices, with keys from 0.
+    /// @param coreCount The number of cores to partition over.
+    /// @param values The initial value of every matrix.
+    inline explicit ShardedMatrixStore(::std::size_t matrixCount, unsigned int coreCount = workerCount(),
+        const Matrix4x4& values = Matrix4x4::identity()) : _matrixCount(matrixCount), _coreCount(coreCount) {
+        if (coreCount == 0) {
+            throw ::std::invalid_argument("There has to be a core at least.");
+        }
+        _rings.reserve(static_cast<::std::size_t>(coreCount) * coreCount);
+        for (::std::size_t i = 0; i < static_cast<::std::size_t>(coreCount) * coreCount; i++) {
+            _rings.emplace_back(new SpscRing<Core::Message>(RING_CAPACITY));
+        }
+        for (unsigned int core = 0; core < coreCount; core++) _cores.emplace_back(new Core(this, core, values));
+    }
+
+    ShardedMatrixStore(const ShardedMatrixStore&) = delete;
+    ShardedMatrixStore& operator=(const ShardedMatrixStore&) = delete;
+
+    /// @brief The number of matrices.
+    inline ::std::size_t size() const { return _matrixCount; }
+    /// @brief The number of cores.
+    inline unsigned int coreCount() const { return _coreCount; }
+    /// @brief The core owning a matrix.
+    inline unsigned int ownerOf(::std::uint64_t key) const { return static_cast<unsigned int>(key % _coreCount); }
+
+    /// @brief Fault in the rings and the matrices of every core, and lock them in memory
+    /// if asked. Messages beyond the capacity of a ring still go to a growing backlog.
+    /// @return Whether everything is locked.
+    inline bool prefault(bool isLocking = true) const {
+        bool isLocked = true;
+        for (const ::std::unique_ptr<SpscRing<Core::Message>>& ring : _rings) {
+            isLocked = ring->prefault(isLocking) && isLocked;
+        }
+        for (const ::std::unique_ptr<Core>& core : _cores) {
+            isLocked = prefaultMemory(core->_matrices.data(), core->_matrices.size() * sizeof(Matrix4x4), isLocking) &&
+                isLocked;
+        }
+        return isLocked;
+    }
+
+    /// @brief Read a matrix between runs.
+    inline Matrix4x4 matrix(::std::uint64_t key) const {
+        checkKey(key);
+        return _cores[ownerOf(key)]->_matrices[key / _coreCount];
+    }
+
+    /// @brief Run a task on every core, each on a thread pinned to a core where the
+    /// system allows it, and serve the messages until every core is done.
+    /// @param task The callable taking the `Core` it runs on.
+    inline void run(const ::std::function<void(Core&)>& task) {
+        ::std::atomic<unsigned int> quiescentCount(0);
+        ::std::exception_ptr error;
+        ::std::mutex errorMutex;
+        auto runCore = [&](unsigned int index) {
+            pinToCore(index);
+            Core& core = *_cores[index];
+            try {
+                task(core);
+            } catch (...) {
+                ::std::lock_guard<::std::mutex> lock(errorMutex);
+                if (!error) error = ::std::current_exception();
+            }
+            // Get every message of this core into the rings, then keep serving until
+            // every core got there too. Loads are answered before their task goes on, so
+            // from then on the rings only hold updates.
+            do {
+                core.poll();
+                core.flush();
+            } while (!core.isBacklogEmpty());
+            quiescentCount.fetch_add(1, ::std::memory_order_acq_rel);
+            while (quiescentCount.load(::std::memory_order_acquire) < _coreCount) {
+                if (core.poll() == 0) ::std::this_thread::yield();
+                core.flush();
+            }
+            core.poll();
+        };
+        ::std::vector<::std::thread> threads;
+        // The calling thread is left alone, rather than pinned for good.
+        for (unsigned int index = 0; index < _coreCount; index++) threads.emplace_back(runCore, index);
+        for (::std::thread& thread : threads) thread.join();
+        if (error) ::std::rethrow_exception(error);
+    }
+
+private:
+    inline void checkKey(::std::uint64_t key) const {
+        if (key >= _matrixCount) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+    }
+    inline SpscRing<Core::Message>& ring(unsigned int from, unsigned int to) {
+        return *_rings[static_cast<::std::size_t>(from) * _coreCount + to];
+    }
+    /// @brief Pin the calling thread, on a best effort basis.
+    inline static void pinToCore(unsigned int index) {
+#if defined(__linux__)
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % workerCount(), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#else
+        (void)index;
+#endif
+    }
+
+private:
+    /// @brief The number of matrices.
+    const ::std::size_t _matrixCount;
+    /// @brief The number of cores.
+    const unsigned int _coreCount;
+    /// @brief The ring of each ordered pair of cores, by sender then receiver.
+    ::std::vector<::std::unique_ptr<SpscRing<Core::Message>>> _rings;
+    /// @brief The cores.
+    ::std::vector<::std::unique_ptr<Core>> _cores;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,354 @@
+/*
+
+File: shared_log.hpp
+Author: Aldhinn Espinas
+Description: This file contains a log of matrix updates in POSIX shared memory,
+    appended by a leader process and applied by follower processes.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(SHARED_LOG_HEADER_FILE)
+#define SHARED_LOG_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "matrix.hpp"
+#include "realtime.hpp"
+#include "registry.hpp"
+
+/// @brief The memory layout of a shared update log, and its mapping.
+class SharedLogMapping {
+public:
+    /// @brief The number of followers a log can have at once.
+    static constexpr unsigned int MAX_FOLLOWERS = 16;
+
+    SharedLogMapping(const SharedLogMapping&) = delete;
+    SharedLogMapping& operator=(const SharedLogMapping&) = delete;
+
+    /// @brief The number of entries of the ring.
+    inline ::std::uint64_t capacity() const { return _header->capacity; }
+    /// @brief The number of updates appended so far.
+    inline ::std::uint64_t tail() const { return _header->tail.load(::std::memory_order_acquire); }
+    /// @brief Determines if the leader closed the log.
+    inline bool isClosed() const { return _header->isClosed.load(::std::memory_order_acquire) != 0; }
+    /// @brief Fault in the shared memory, and lock it in memory if asked.
+    /// @return Whether the shared memory is locked.
+    inline bool prefault(bool isLocking = true) const { return prefaultMemory(_mapping, _size, isLocking); }
+
+protected:
+    /// @brief The kinds of updates.
+    enum class Kind : ::std::uint32_t { Store, Erase };
+    /// @brief The counters of a follower, on a cache line of their own.
+    struct alignas(64) FollowerSlot {
+        /// @brief The process id of the follower holding the slot, 0 while it is free.
+        ::std::atomic<::std::uint32_t> owner;
+        /// @brief The number of updates the follower applied.
+        ::std::atomic<::std::uint64_t> head;
+    };
+    /// @brief The start of the shared memory.
+    struct alignas(64) Header {
+        /// @brief Identifies shared update logs.
+        char magic[8];
+        /// @brief The number of entries of the ring.
+        ::std::uint64_t capacity;
+        /// @brief Set by the leader when it appends no more.
+        ::std::atomic<::std::uint32_t> isClosed;
+        /// @brief The number of updates appended.
+        alignas(64) ::std::atomic<::std::uint64_t> tail;
+        /// @brief The followers.
+        FollowerSlot followers[MAX_FOLLOWERS];
+    };
+    /// @brief An update of the ring.
+    struct alignas(64) Entry {
+        /// @brief One past the index of the update once it is written, since the entries
+        /// are reused round the ring.
+        ::std::atomic<::std::uint64_t> sequence;
+        /// @brief The kind.
+        Kind kind;
+        /// @brief The key of the matrix.
+        ::std::uint64_t key;
+        /// @brief The new value of a store.
+        Matrix4x4 value;
+    };
+
+    /// @brief Map a shared memory object.
+    /// @param name The name of the object, starting with a slash.
+    /// @param capacity The number of entries to create the object with, or 0 to open it.
+    inline SharedLogMapping(const ::std::string& name, ::std::uint64_t capacity) :
+    _name(name), _mapping(nullptr), _size(0), _header(nullptr), _entries(nullptr) {
+        bool isCreating = capacity != 0;
+        if (isCreating) {
+            ::std::uint64_t size = 1;
+            while (size < capacity) size *= 2;
+            capacity = size;
+            ::shm_unlink(name.c_str());
+        }
+        int fd = ::shm_open(name.c_str(), isCreating ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+        if (fd < 0) throwSystemError("Cannot open the shared log " + name);
+        if (isCreating) {
+            _size = sizeof(Header) + capacity * sizeof(Entry);
+            if (::ftruncate(fd, static_cast<::off_t>(_size)) != 0) {
+                int error = errno;
+                ::close(fd);
+                ::shm_unlink(name.c_str());
+                throw ::std::system_error(error, ::std::generic_category(), "Cannot size the shared log " + name);
+            }
+        } else {
+            struct stat status;
+            if (::fstat(fd, &status) != 0 || static_cast<::std::size_t>(status.st_size) < sizeof(Header)) {
+                ::close(fd);
+                throw ::std::runtime_error("The shared memory " + name + " is not a shared log.");
+            }
+            _size = static_cast<::std::size_t>(status.st_size);
+        }
+        _mapping = ::mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int error = errno;
+        ::close(fd);
+        if (_mapping == MAP_FAILED) {
+            _mapping = nullptr;
+            throw ::std::system_error(error, ::std::generic_category(), "Cannot map the shared log " + name);
+        }
+        _header = static_cast<Header*>(_mapping);
+        _entries = reinterpret_cast<Entry*>(static_cast<char*>(_mapping) + sizeof(Header));
+        if (isCreating) {
+            // The fresh object is zeroed, which is a valid state of every atomic here.
+            _header->capacity = capacity;
+            ::std::memcpy(_header->magic, "MATRXLOG", sizeof(_header->magic));
+        } else if (::std::memcmp(_header->magic, "MATRXLOG", sizeof(_header->magic)) != 0 ||
+            _size < sizeof(Header) + _header->capacity * sizeof(Entry)) {
+            ::munmap(_mapping, _size);
+            _mapping = nullptr;
+            throw ::std::runtime_error("The shared memory " + name + " is not a shared log.");
+        }
+    }
+    inline ~SharedLogMapping() {
+        if (_mapping != nullptr) ::munmap(_mapping, _size);
+    }
+
+    /// @brief Throw the error of the last failed system call.
+    [[noreturn]] inline static void throwSystemError(const ::std::string& message) {
+        throw ::std::system_error(errno, ::std::generic_category(), message);
+    }
+    /// @brief The entry of an update in the ring.
+    inline Entry& entry(::std::uint64_t index) const { return _entries[index & (_header->capacity - 1)]; }
+
+    /// @brief The name of the shared memory object.
+    const ::std::string _name;
+    /// @brief The mapping.
+    void* _mapping;
+    /// @brief The size of the mapping.
+    ::std::size_t _size;
+    /// @brief The header, at the start of the mapping.
+    Header* _header;
+    /// @brief The ring, after the header.
+    Entry* _entries;
+};
+
+/// @brief The appending side of a shared update log, owned by the leader process.
+///
+/// Appends never take a lock shared with the followers: an update is written, then made
+/// visible by its sequence number. The leader waits while the slowest follower is a full
+/// ring behind, which holds it back to the pace of its followers. While it waits, it frees
+/// the slots of followers whose process is gone, so a crashed follower does not hold it
+/// back forever. That takes the followers to share the process id namespace of the leader,
+/// and a follower that exited to be reaped by its parent.
+class SharedLogLeader final : public SharedLogMapping {
+public:
+    /// @brief Create the log, replacing any log of the same name.
+    /// @param name The name of the shared memory object, starting with a slash.
+    /// @param capacity The number of entries of the ring, rounded up to a power of 2.
+    inline explicit SharedLogLeader(const ::std::string& name, ::std::uint64_t capacity = 1 << 16) :
+    SharedLogMapping(name, capacity == 0 ? 1 : capacity), _backpressureWaits(0) {}
+    /// @brief Close and remove the log. Followers keep their mapping.
+    inline ~SharedLogLeader() {
+        close();
+        ::shm_unlink(_name.c_str());
+    }
+
+    /// @brief Append the store of a matrix.
+    inline void store(::std::uint64_t key, const Matrix4x4& value) { append(Kind::Store, key, value); }
+    /// @brief Append the removal of a matrix.
+    inline void erase(::std::uint64_t key) { append(Kind::Erase, key, Matrix4x4()); }
+    /// @brief Tell the followers that nothing more will be appended.
+    inline void close() { _header->isClosed.store(1, ::std::memory_order_release); }
+
+    /// @brief The number of followers.
+    inline unsigned int followerCount() const {
+        unsigned int count = 0;
+        for (const FollowerSlot& slot : _header->followers) {
+            if (slot.owner.load(::std::memory_order_acquire) != 0) count++;
+        }
+        return count;
+    }
+    /// @brief The number of updates the slowest follower has yet to apply.
+    inline ::std::uint64_t maxLag() const {
+        ::std::uint64_t tail = _header->tail.load(::std::memory_order_relaxed);
+        return tail - slowestHead(tail);
+    }
+    /// @brief The number of times an append had to wait for a follower.
+    inline unsigned long long backpressureWaits() const { return _backpressureWaits; }
+
+private:
+    /// @brief The lowest head among the followers, or the tail without any.
+    inline ::std::uint64_t slowestHead(::std::uint64_t tail) const {
+        ::std::uint64_t slowest = tail;
+        for (const FollowerSlot& slot : _header->followers) {
+            if (slot.owner.load(::std::memory_order_acquire) != 0) {
+                slowest = ::std::min(slowest, slot.head.load(::std::memory_order_acquire));
+            }
+        }
+        return slowest;
+    }
+    /// @brief Free the slots of the followers whose process no longer exists.
+    inline void releaseExitedFollowers() {
+        for (FollowerSlot& slot : _header->followers) {
+            ::std::uint32_t owner = slot.owner.load(::std::memory_order_acquire);
+            if (owner != 0 && ::kill(static_cast<pid_t>(owner), 0) != 0 && errno == ESRCH) {
+                // Only the slot of that process, in case it was freed and taken meanwhile.
+                slot.owner.compare_exchange_strong(owner, 0, ::std::memory_order_acq_rel);
+            }
+        }
+    }
+    inline void append(Kind kind, ::std::uint64_t key, const Matrix4x4& value) {
+        // Threads of the leader take turns, the followers never wait for them.
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        ::std::uint64_t tail = _header->tail.load(::std::memory_order_relaxed);
+        if (tail - slowestHead(tail) >= _header->capacity) {
+            _backpressureWaits++;
+            do {
+                ::std::this_thread::yield();
+                releaseExitedFollowers();
+            } while (tail - slowestHead(tail) >= _header->capacity);
+        }
+        Entry& target = entry(tail);
+        target.kind = kind;
+        target.key = key;
+        target.value = value;
+        target.sequence.store(tail + 1, ::std::memory_order_release);
+        _header->tail.store(tail + 1, ::std::memory_order_release);
+    }
+
+    /// @brief Serializes the appending threads of the leader.
+    ::std::mutex _mutex;
+    /// @brief The number of times an append had to wait for a follower.
+    unsigned long long _backpressureWaits;
+};
+
+/// @brief The applying side of a shared update log, in a follower process, with a local
+/// replica of the matrices.
+///
+/// A follower sees the updates appended from when it joined, and applies them at its own
+/// pace. Its progress is published once per batch, and holds the leader back once it is
+/// a full ring behind, so a follower that stops has to be destroyed, or its process has
+/// to exit, to release the leader.
+class SharedLogFollower final : public SharedLogMapping {
+public:
+    /// @brief Join a log.
+    /// @param name The name of the shared memory object of the log.
+    inline explicit SharedLogFollower(const ::std::string& name) :
+    SharedLogMapping(name, 0), _slot(nullptr), _applied(0) {
+        const ::std::uint32_t pid = static_cast<::std::uint32_t>(::getpid());
+        for (FollowerSlot& slot : _header->followers) {
+            ::std::uint32_t owner = 0;
+            if (slot.owner.compare_exchange_strong(owner, pid, ::std::memory_order_acq_rel)) {
+                _slot = &slot;
+                break;
+            }
+        }
+        if (_slot == nullptr) {
+            throw ::std::length_error("Too many followers for the shared log " + name + ".");
+        }
+        // Until then the leader may see the head of a former follower, which is behind
+        // and only makes it wait.
+        _head = _header->tail.load(::std::memory_order_acquire);
+        _slot->head.store(_head, ::std::memory_order_release);
+    }
+    /// @brief Leave the log, releasing the leader.
+    inline ~SharedLogFollower() {
+        _slot->owner.store(0, ::std::memory_order_release);
+    }
+
+    /// @brief Apply the updates appended since the last poll.
+    /// @param maxBatch The most updates to apply.
+    /// @return The number of updates applied.
+    inline ::std::size_t poll(::std::size_t maxBatch = 1024) {
+        ::std::size_t count = 0;
+        while (count < maxBatch) {
+            const Entry& source = entry(_head);
+            if (source.sequence.load(::std::memory_order_acquire) != _head + 1) break;
+            if (source.kind == Kind::Store) {
+                _replica.store(source.key, source.value);
+            } else {
+                _replica.erase(source.key);
+            }
+            _head++;
+            count++;
+        }
+        if (count != 0) {
+            _slot->head.store(_head, ::std::memory_order_release);
+            _applied += count;
+        }
+        return count;
+    }
+
+    /// @brief The local replica, readable from any thread of the follower.
+    inline const MatrixRegistry<::std::uint64_t>& replica() const { return _replica; }
+    /// @brief The number of updates applied.
+    inline unsigned long long applied() const { return _applied; }
+    /// @brief The number of updates appended that are not applied yet.
+    inline ::std::uint64_t lag() const { return _header->tail.load(::std::memory_order_acquire) - _head; }
+    /// @brief Determines if the leader closed the log and every update is applied.
+    inline bool isDone() const { return isClosed() && lag() == 0; }
+
+private:
+    /// @brief The slot of this follower.
+    FollowerSlot* _slot;
+    /// @brief The index of the next update to apply.
+    ::std::uint64_t _head;
+    /// @brief The number of updates applied.
+    unsigned long long _applied;
+    /// @brief The local replica.
+    MatrixRegistry<::std::uint64_t> _replica;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,419 @@
+/*
+
+File: sparse_matrix.hpp
+Author: Aldhinn Espinas
+Description: This file contains the concurrent sparse matrix declarations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(SPARSE_MATRIX_HEADER_FILE)
+#define SPARSE_MATRIX_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "parallel.hpp"
+#include "seqlock.hpp"
+
+/// @brief A description of a sparse matrix in compressed row storage with atomic values.
+///
+/// The sparsity pattern is immutable once published. A single value is set in place
+/// without thread locks, while batches of values are written one batch at a time, and
+/// products are computed on a consistent snapshot of the values. Changing the pattern builds a new one and publishes it RCU-style: readers
+/// holding the old pattern keep using it until they are done.
+class ConcurrentSparseMatrix final {
+public:
+    /// @brief The row and column index type.
+    using Index = ::std::uint32_t;
+
+    /// @brief A non-zero element.
+    struct Entry {
+        /// @brief The row-index of the element.
+        Index row;
+        /// @brief The column-index of the element.
+        Index col;
+        /// @brief The value of the element.
+        double value;
+    };
+    /// @brief The position of an element.
+    struct Position {
+        /// @brief The row-index of the element.
+        Index row;
+        /// @brief The column-index of the element.
+        Index col;
+    };
+
+    /// @brief Construct the matrix with the pattern of the given entries.
+    /// @param rows The number of rows.
+    /// @param cols The number of columns.
+    /// @param entries The non-zero elements. A repeated position keeps the last value.
+    inline ConcurrentSparseMatrix(Index rows, Index cols, const ::std::vector<Entry>& entries = {}) :
+    _rows(rows), _cols(cols) {
+        // Column indices are gathered as signed 32-bit integers.
+        if (rows > static_cast<Index>(::std::numeric_limits<::std::int32_t>::max()) ||
+            cols > static_cast<Index>(::std::numeric_limits<::std::int32_t>::max())) {
+            throw ::std::out_of_range("Sparse matrix dimensions are limited to 2^31 - 1.");
+        }
+        for (const Entry& entry : entries) checkIndex(entry.row, entry.col);
+        _pattern = buildPattern(entries);
+    }
+
+    ConcurrentSparseMatrix(const ConcurrentSparseMatrix&) = delete;
+    ConcurrentSparseMatrix& operator=(const ConcurrentSparseMatrix&) = delete;
+
+    /// @brief The number of rows.
+    inline Index rows() const { return _rows; }
+    /// @brief The number of columns.
+    inline Index cols() const { return _cols; }
+    /// @brief The number of elements in the current sparsity pattern.
+    inline ::std::size_t nonZeroCount() const {
+        return currentPattern()->columns.size();
+    }
+    /// @brief Determines if the element is part of the current sparsity pattern.
+    /// @param row The row-index of the element.
+    /// @param col The column-index of the element.
+    inline bool contains(Index row, Index col) const {
+        checkIndex(row, col);
+        return currentPattern()->find(row, col) != NOT_FOUND;
+    }
+
+    /// @brief Get the value of the element in the specified index.
+    /// @param row The row-index of the element.
+    /// @param col The column-index of the element.
+    /// @return The value, zero for elements outside of the sparsity pattern.
+    inline double get(Index row, Index col) const {
+        checkIndex(row, col);
+        ::std::shared_ptr<const Pattern> pattern = currentPattern();
+        ::std::size_t slot = pattern->find(row, col);
+        return slot == NOT_FOUND ? 0.0 : pattern->values[slot].load(::std::memory_order_relaxed);
+    }
+
+    /// @brief Set the value of an element of the sparsity pattern.
+    /// @param row The row-index of the element.
+    /// @param col The column-index of the element.
+    /// @param value The new value.
+    inline void set(Index row, Index col, double value) {
+        checkIndex(row, col);
+        for (;;) {
+            ::std::shared_ptr<Pattern> pattern = currentPattern();
+            ::std::size_t slot = pattern->find(row, col);
+            if (slot == NOT_FOUND) {
+                throw ::std::out_of_range("The element is not part of the sparsity pattern.");
+            }
+            if (tryWrite(*pattern, false, [&]() {
+                pattern->values[slot].store(value, ::std::memory_order_relaxed);
+            })) return;
+        }
+    }
+
+    /// @brief Set the values of several elements of the sparsity pattern at once.
+    /// Readers either see all of the new values or none of them. Concurrent updates take
+    /// a lock of the pattern and apply one after the other.
+    /// @param entries The elements to be set.
+    inline void update(const ::std::vector<Entry>& entries) {
+        for (const Entry& entry : entries) checkIndex(entry.row, entry.col);
+        ::std::vector<::std::size_t> slots(entries.size());
+        for (;;) {
+            ::std::shared_ptr<Pattern> pattern = currentPattern();
+            // Resolve every slot before writing anything.
+            for (::std::size_t i = 0; i < entries.size(); i++) {
+                slots[i] = pattern->find(entries[i].row, entries[i].col);
+                if (slots[i] == NOT_FOUND) {
+                    throw ::std::out_of_range("The element is not part of the sparsity pattern.");
+                }
+            }
+            if (tryWrite(*pattern, true, [&]() {
+                for (::std::size_t i = 0; i < entries.size(); i++) {
+                    pattern->values[slots[i]].store(entries[i].value, ::std::memory_order_relaxed);
+                }
+            })) return;
+        }
+    }
+
+    /// @brief The matrix-vector product, `y = A x`, on a consistent snapshot.
+    /// @param x The input vector with `cols()` elements.
+    /// @param y The output vector with `rows()` elements.
+    inline void multiply(const double* x, double* y) const {
+        ::std::shared_ptr<const Pattern> pattern = currentPattern();
+        pattern->version.read([&]() {
+            parallelFor(0, _rows, ROW_GRAIN, [&](::std::size_t rowBegin, ::std::size_t rowEnd) {
+                multiplyRows(*pattern, x, y, rowBegin, rowEnd);
+            });
+        });
+    }
+    /// @brief The matrix-vector product, `y = A x`, on a consistent snapshot.
+    /// @param x The input vector with `cols()` elements.
+    /// @return The output vector with `rows()` elements.
+    inline ::std::vector<double> multiply(const ::std::vector<double>& x) const {
+        if (x.size() != _cols) {
+            throw ::std::invalid_argument("The vector size does not match the number of columns.");
+        }
+        ::std::vector<double> y(_rows);
+        multiply(x.data(), y.data());
+        return y;
+    }
+    /// @brief The matrix-matrix product, `Y = A X`, on a consistent snapshot.
+    /// @param x The row-major `cols() x vectorCount` input matrix.
+    /// @param vectorCount The number of columns of `x` and `y`.
+    /// @param y The row-major `rows() x vectorCount` output matrix.
+    inline void multiply(const double* x, ::std::size_t vectorCount, double* y) const {
+        ::std::shared_ptr<const Pattern> pattern = currentPattern();
+        pattern->version.read([&]() {
+            parallelFor(0, _rows, ROW_GRAIN, [&](::std::size_t rowBegin, ::std::size_t rowEnd) {
+                multiplyRows(*pattern, x, vectorCount, y, rowBegin, rowEnd);
+            });
+        });
+    }
+
+    /// @brief Change the sparsity pattern.
+    ///
+    /// Values of the elements that are kept are carried over. Concurrent value updates
+    /// are held back only while the values are carried over, and readers are never
+    /// blocked.
+    /// @param inserted The elements to be added, or set if already present.
+    /// @param erased The elements to be removed from the pattern.
+    inline void restructure(const ::std::vector<Entry>& inserted, const ::std::vector<Position>& erased = {}) {
+        for (const Entry& entry : inserted) checkIndex(entry.row, entry.col);
+        for (const Position& position : erased) checkIndex(position.row, position.col);
+
+        // Structural updates are rare and serialized among themselves.
+        ::std::lock_guard<::std::mutex> lock(_restructureMutex);
+        ::std::shared_ptr<Pattern> oldPattern = currentPattern();
+
+        // Seal the old pattern so that writers move over to the new one, then wait
+        // for the writers already in it.
+        oldPattern->sealed.store(true, ::std::memory_order_seq_cst);
+        oldPattern->version.waitForWriters();
+
+        ::std::shared_ptr<Pattern> newPattern;
+        try {
+            // Mark the erased slots.
+            ::std::vector<bool> keep(oldPattern->columns.size(), true);
+            for (const Position& position : erased) {
+                ::std::size_t slot = oldPattern->find(position.row, position.col);
+                if (slot != NOT_FOUND) keep[slot] = false;
+            }
+            // Gather the kept entries, followed by the inserted ones so that they win.
+            ::std::vector<Entry> entries;
+            entries.reserve(oldPattern->columns.size() + inserted.size());
+            for (Index row = 0; row < _rows; row++) {
+                for (::std::size_t slot = oldPattern->rowOffsets[row]; slot < oldPattern->rowOffsets[row + 1]; slot++) {
+                    if (!keep[slot]) continue;
+                    entries.push_back({row, oldPattern->columns[slot],
+                        oldPattern->values[slot].load(::std::memory_order_relaxed)});
+                }
+            }
+            entries.insert(entries.end(), inserted.begin(), inserted.end());
+            newPattern = buildPattern(entries);
+        } catch (...) {
+            // Hand the old pattern back to the writers.
+            oldPattern->sealed.store(false, ::std::memory_order_seq_cst);
+            throw;
+        }
+        ::std::atomic_store(&_pattern, newPattern);
+    }
+
+private:
+    /// @brief An immutable sparsity pattern with its mutable values.
+    struct Pattern {
+        /// @brief The offset of the first slot of each row, plus the total slot count.
+        ::std::vector<::std::size_t> rowOffsets;
+        /// @brief The column-index of each slot, sorted within each row.
+        ::std::vector<Index> columns;
+        /// @brief The value of each slot.
+        ::std::unique_ptr<::std::atomic<double>[]> values;
+        /// @brief The version of the values.
+        SeqLock version;
+        /// @brief Serializes the writers of several values, or two updates could end up mixed.
+        ::std::mutex writeMutex;
+        /// @brief Whether the pattern has been replaced and takes no more writes.
+        ::std::atomic<bool> sealed{false};
+
+        /// @brief Find the slot of an element.
+        /// @return The slot, or `NOT_FOUND`.
+        inline ::std::size_t find(Index row, Index col) const {
+            const Index* begin = columns.data() + rowOffsets[row];
+            const Index* end = columns.data() + rowOffsets[row + 1];
+            const Index* found = ::std::lower_bound(begin, end, col);
+            if (found == end || *found != col) return NOT_FOUND;
+            return static_cast<::std::size_t>(found - columns.data());
+        }
+    };
+
+    /// @brief The slot returned when an element is not part of a pattern.
+    static constexpr ::std::size_t NOT_FOUND = ::std::numeric_limits<::std::size_t>::max();
+    /// @brief The minimum number of rows multiplied by a thread.
+    static constexpr ::std::size_t ROW_GRAIN = 4096;
+
+    /// @brief Throw if the index is outside of the matrix.
+    inline void checkIndex(Index row, Index col) const {
+        if (row >= _rows || col >= _cols) {
+            throw ::std::out_of_range("Invalid index.");
+        }
+    }
+
+    /// @brief The currently published pattern.
+    inline ::std::shared_ptr<Pattern> currentPattern() const {
+        return ::std::atomic_load(&_pattern);
+    }
+
+    /// @brief Build a pattern from a list of entries.
+    /// @param entries The entries. A repeated position keeps the last value.
+    inline ::std::shared_ptr<Pattern> buildPattern(::std::vector<Entry> entries) const {
+        ::std::stable_sort(entries.begin(), entries.end(), [](const Entry& left, const Entry& right) {
+            return left.row != right.row ? left.row < right.row : left.col < right.col;
+        });
+
+        ::std::shared_ptr<Pattern> pattern = ::std::make_shared<Pattern>();
+        pattern->rowOffsets.assign(static_cast<::std::size_t>(_rows) + 1, 0);
+        pattern->columns.reserve(entries.size());
+        ::std::vector<double> values;
+        values.reserve(entries.size());
+        for (::std::size_t i = 0; i < entries.size(); i++) {
+            // The last of a run of repeated positions wins.
+            if (i + 1 < entries.size() && entries[i + 1].row == entries[i].row &&
+                entries[i + 1].col == entries[i].col) continue;
+            pattern->rowOffsets[entries[i].row + 1]++;
+            pattern->columns.push_back(entries[i].col);
+            values.push_back(entries[i].value);
+        }
+        for (Index row = 0; row < _rows; row++) {
+            pattern->rowOffsets[row + 1] += pattern->rowOffsets[row];
+        }
+        pattern->values.reset(new ::std::atomic<double>[values.size()]);
+        for (::std::size_t slot = 0; slot < values.size(); slot++) {
+            pattern->values[slot].store(values[slot], ::std::memory_order_relaxed);
+        }
+        return pattern;
+    }
+
+    /// @brief Run a write section on a pattern unless it has been sealed.
+    /// @param pattern The pattern.
+    /// @param isSerialized Whether the writer has to exclude other writers, since it writes
+    /// several values. A single value is one store and can never end up mixed.
+    /// @param writer The callable that writes the values.
+    /// @return Whether the write went through.
+    template <typename Writer>
+    inline static bool tryWrite(Pattern& pattern, bool isSerialized, Writer&& writer) {
+        {
+            ::std::unique_lock<::std::mutex> lock(pattern.writeMutex, ::std::defer_lock);
+            if (isSerialized) lock.lock();
+            SeqLockWriteGuard guard(pattern.version);
+            if (!pattern.sealed.load(::std::memory_order_seq_cst)) {
+                writer();
+                return true;
+            }
+        }
+        // A new pattern is being published. Give way outside of the write section
+        // and retry on the new pattern.
+        ::std::this_thread::yield();
+        return false;
+    }
+
+    /// @brief The matrix-vector product for a range of rows.
+    inline static void multiplyRows(const Pattern& pattern, const double* x, double* y,
+        ::std::size_t rowBegin, ::std::size_t rowEnd) {
+        static_assert(sizeof(::std::atomic<double>) == sizeof(double),
+            "Atomic value slots are read as plain doubles.");
+        // Plain loads of the atomic slots may observe a value being written. The
+        // sequence lock of the caller discards such a result.
+        const double* values = reinterpret_cast<const double*>(pattern.values.get());
+        const Index* columns = pattern.columns.data();
+        for (::std::size_t row = rowBegin; row < rowEnd; row++) {
+            ::std::size_t slot = pattern.rowOffsets[row];
+            ::std::size_t slotEnd = pattern.rowOffsets[row + 1];
+            double sum = 0.0;
+#if defined(__AVX2__)
+            __m256d sums = _mm256_setzero_pd();
+            // The masked form, with every lane enabled, spares the gather an undefined source.
+            const __m256d gatherMask = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+            for (; slot + 4 <= slotEnd; slot += 4) {
+                __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columns + slot));
+                __m256d gathered = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), x, indices, gatherMask, 8);
+                sums = _mm256_add_pd(sums, _mm256_mul_pd(_mm256_loadu_pd(values + slot), gathered));
+            }
+            alignas(32) double lanes[4];
+            _mm256_store_pd(lanes, sums);
+            sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+            for (; slot < slotEnd; slot++) {
+                sum += values[slot] * x[columns[slot]];
+            }
+            y[row] = sum;
+        }
+    }
+
+    /// @brief The matrix-matrix product for a range of rows.
+    inline static void multiplyRows(const Pattern& pattern, const double* x, ::std::size_t vectorCount,
+        double* y, ::std::size_t rowBegin, ::std::size_t rowEnd) {
+        const double* values = reinterpret_cast<const double*>(pattern.values.get());
+        const Index* columns = pattern.columns.data();
+        for (::std::size_t row = rowBegin; row < rowEnd; row++) {
+            double* yRow = y + row * vectorCount;
+            ::std::fill(yRow, yRow + vectorCount, 0.0);
+            for (::std::size_t slot = pattern.rowOffsets[row]; slot < pattern.rowOffsets[row + 1]; slot++) {
+                double value = values[slot];
+                const double* xRow = x + static_cast<::std::size_t>(columns[slot]) * vectorCount;
+                ::std::size_t col = 0;
+#if defined(__AVX2__)
+                __m256d broadcast = _mm256_set1_pd(value);
+                for (; col + 4 <= vectorCount; col += 4) {
+                    __m256d product = _mm256_mul_pd(broadcast, _mm256_loadu_pd(xRow + col));
+                    _mm256_storeu_pd(yRow + col, _mm256_add_pd(_mm256_loadu_pd(yRow + col), product));
+                }
+#endif
+                for (; col < vectorCount; col++) {
+                    yRow[col] += value * xRow[col];
+                }
+            }
+        }
+    }
+
+private:
+    /// @brief The number of rows.
+    Index _rows;
+    /// @brief The number of columns.
+    Index _cols;
+    /// @brief The published pattern. Accessed with the atomic `shared_ptr` functions.
+    ::std::shared_ptr<Pattern> _pattern;
+    /// @brief Serializes structural updates.
+    ::std::mutex _restructureMutex;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
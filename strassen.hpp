@@ -0,0 +1,309 @@
+/*
+
+File: strassen.hpp
+Author: Aldhinn Espinas
+Description: This file contains the declarations for the Strassen-Winograd multiplication
+    of large dense matrices.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(STRASSEN_HEADER_FILE)
+#define STRASSEN_HEADER_FILE
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "dense_matrix.hpp"
+
+/// @brief The options of a Strassen-Winograd multiplication.
+struct StrassenOptions {
+    /// @brief The dimension at or below which the blocked kernel takes over.
+    /// `tuneStrassenCrossover` finds the one of a given machine.
+    ::std::size_t crossover = 256;
+    /// @brief The number of recursion levels whose seven products run as parallel tasks.
+    /// Each level multiplies the number of tasks by seven.
+    unsigned int parallelDepth = 1;
+};
+
+/// @brief A row-major block of a larger matrix.
+struct MatrixBlock {
+    /// @brief The first element.
+    double* data;
+    /// @brief The distance between the rows.
+    ::std::size_t stride;
+
+    /// @brief The quadrant of a block with the given half-dimensions.
+    inline MatrixBlock quadrant(int rowHalf, int colHalf, ::std::size_t halfRows, ::std::size_t halfCols) const {
+        return {data + rowHalf * halfRows * stride + colHalf * halfCols, stride};
+    }
+};
+
+/// @brief `out = x + sign * y` over blocks.
+inline void combineBlocks(::std::size_t rows, ::std::size_t cols, MatrixBlock x, MatrixBlock y, double sign,
+    MatrixBlock out) {
+    for (::std::size_t row = 0; row < rows; row++) {
+        const double* xRow = x.data + row * x.stride;
+        const double* yRow = y.data + row * y.stride;
+        double* outRow = out.data + row * out.stride;
+        if (sign > 0.0) {
+            for (::std::size_t col = 0; col < cols; col++) outRow[col] = xRow[col] + yRow[col];
+        } else {
+            for (::std::size_t col = 0; col < cols; col++) outRow[col] = xRow[col] - yRow[col];
+        }
+    }
+}
+
+/// @brief The number of elements of workspace used by `strassenMultiply` below a level.
+/// @param rows The rows of A and C at the level.
+/// @param depth The columns of A and rows of B at the level.
+/// @param cols The columns of B and C at the level.
+/// @param levels The number of recursion levels left.
+/// @param parallelDepth The number of levels left that run their products in parallel.
+inline ::std::size_t strassenWorkspaceSize(::std::size_t rows, ::std::size_t depth, ::std::size_t cols,
+    unsigned int levels, unsigned int parallelDepth) {
+    if (levels == 0) return 0;
+    ::std::size_t halfRows = rows / 2, halfDepth = depth / 2, halfCols = cols / 2;
+    ::std::size_t products = 7 * halfRows * halfCols;
+    ::std::size_t operands = halfRows * halfDepth + halfDepth * halfCols;
+    ::std::size_t below = strassenWorkspaceSize(halfRows, halfDepth, halfCols, levels - 1,
+        parallelDepth == 0 ? 0 : parallelDepth - 1);
+    // Parallel products each need their own operands and their own workspace below.
+    return parallelDepth > 0 ? products + 7 * (operands + below) : products + operands + below;
+}
+
+/// @brief One level of the Strassen-Winograd recursion, `C = A B`.
+///
+/// Seven half-size products and fifteen additions replace the eight products of the
+/// classical split. All three dimensions must be divisible by `2^levels`.
+/// @param rows The rows of A and C.
+/// @param depth The columns of A and rows of B.
+/// @param cols The columns of B and C.
+/// @param a The left hand-side block.
+/// @param b The right hand-side block.
+/// @param c The block of the dot product.
+/// @param levels The number of recursion levels left.
+/// @param parallelDepth The number of levels left that run their products in parallel.
+/// @param workspace The workspace, of `strassenWorkspaceSize` elements.
+inline void strassenMultiply(::std::size_t rows, ::std::size_t depth, ::std::size_t cols,
+    MatrixBlock a, MatrixBlock b, MatrixBlock c, unsigned int levels, unsigned int parallelDepth, double* workspace) {
+    if (levels == 0) {
+        for (::std::size_t row = 0; row < rows; row++) {
+            ::std::fill(c.data + row * c.stride, c.data + row * c.stride + cols, 0.0);
+        }
+        gemmAccumulate(rows, cols, depth, a.data, a.stride, b.data, b.stride, c.data, c.stride);
+        return;
+    }
+    const ::std::size_t m = rows / 2, k = depth / 2, n = cols / 2;
+    MatrixBlock a11 = a.quadrant(0, 0, m, k), a12 = a.quadrant(0, 1, m, k);
+    MatrixBlock a21 = a.quadrant(1, 0, m, k), a22 = a.quadrant(1, 1, m, k);
+    MatrixBlock b11 = b.quadrant(0, 0, k, n), b12 = b.quadrant(0, 1, k, n);
+    MatrixBlock b21 = b.quadrant(1, 0, k, n), b22 = b.quadrant(1, 1, k, n);
+
+    MatrixBlock products[7];
+    for (int i = 0; i < 7; i++) products[i] = {workspace + i * m * n, n};
+    double* rest = workspace + 7 * m * n;
+    const bool isParallel = parallelDepth > 0;
+    const unsigned int childParallelDepth = isParallel ? parallelDepth - 1 : 0;
+    const ::std::size_t childWorkspace = strassenWorkspaceSize(m, k, n, levels - 1, childParallelDepth);
+    const ::std::size_t taskWorkspace = m * k + k * n + childWorkspace;
+
+    // The product of index `i`, with its operands built in a workspace of its own.
+    auto product = [&](int i, double* taskMemory) {
+        MatrixBlock s = {taskMemory, k};
+        MatrixBlock t = {taskMemory + m * k, n};
+        double* below = taskMemory + m * k + k * n;
+        MatrixBlock left, right;
+        switch (i) {
+        case 0: left = a11; right = b11; break;
+        case 1: left = a12; right = b21; break;
+        case 2:
+            // S4 = A12 - (A21 + A22 - A11)
+            combineBlocks(m, k, a21, a22, 1.0, s);
+            combineBlocks(m, k, s, a11, -1.0, s);
+            combineBlocks(m, k, a12, s, -1.0, s);
+            left = s; right = b22; break;
+        case 3:
+            // T4 = (B22 - (B12 - B11)) - B21
+            combineBlocks(k, n, b12, b11, -1.0, t);
+            combineBlocks(k, n, b22, t, -1.0, t);
+            combineBlocks(k, n, t, b21, -1.0, t);
+            left = a22; right = t; break;
+        case 4:
+            // S1 = A21 + A22, T1 = B12 - B11
+            combineBlocks(m, k, a21, a22, 1.0, s);
+            combineBlocks(k, n, b12, b11, -1.0, t);
+            left = s; right = t; break;
+        case 5:
+            // S2 = S1 - A11, T2 = B22 - T1
+            combineBlocks(m, k, a21, a22, 1.0, s);
+            combineBlocks(m, k, s, a11, -1.0, s);
+            combineBlocks(k, n, b12, b11, -1.0, t);
+            combineBlocks(k, n, b22, t, -1.0, t);
+            left = s; right = t; break;
+        default:
+            // S3 = A11 - A21, T3 = B22 - B12
+            combineBlocks(m, k, a11, a21, -1.0, s);
+            combineBlocks(k, n, b22, b12, -1.0, t);
+            left = s; right = t; break;
+        }
+        strassenMultiply(m, k, n, left, right, products[i], levels - 1, childParallelDepth, below);
+    };
+
+    if (isParallel) {
+        ::std::vector<::std::future<void>> tasks;
+        for (int i = 1; i < 7; i++) {
+            tasks.push_back(::std::async(::std::launch::async, product, i, rest + i * taskWorkspace));
+        }
+        product(0, rest);
+        // Wait for every task before rethrowing, the workspace outlives none of them.
+        for (::std::future<void>& task : tasks) task.wait();
+        for (::std::future<void>& task : tasks) task.get();
+    } else {
+        for (int i = 0; i < 7; i++) product(i, rest);
+    }
+
+    // U1 = P1 + P2, U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5,
+    // C11 = U1, C12 = U4 + P3, C21 = U3 - P4, C22 = U3 + P5.
+    MatrixBlock c11 = c.quadrant(0, 0, m, n), c12 = c.quadrant(0, 1, m, n);
+    MatrixBlock c21 = c.quadrant(1, 0, m, n), c22 = c.quadrant(1, 1, m, n);
+    combineBlocks(m, n, products[0], products[1], 1.0, c11);
+    combineBlocks(m, n, products[0], products[5], 1.0, products[0]);
+    combineBlocks(m, n, products[0], products[6], 1.0, products[6]);
+    combineBlocks(m, n, products[0], products[4], 1.0, products[0]);
+    combineBlocks(m, n, products[0], products[2], 1.0, c12);
+    combineBlocks(m, n, products[6], products[3], -1.0, c21);
+    combineBlocks(m, n, products[6], products[4], 1.0, c22);
+}
+
+/// @brief The dot product with the Strassen-Winograd algorithm.
+///
+/// Recursion continues while every dimension is above the crossover, and the operands
+/// are padded with zeros to be divisible at every level. The products are not
+/// bitwise identical to the classical ones, see `strassenRelativeError`.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param options The crossover and the parallel depth.
+/// @return The dot product.
+inline DenseMatrix multiplyStrassen(const DenseMatrix& leftMat, const DenseMatrix& rightMat,
+    const StrassenOptions& options = StrassenOptions()) {
+    if (leftMat.cols() != rightMat.rows()) {
+        throw ::std::invalid_argument("The number of columns of the left matrix does not match the rows of the right.");
+    }
+    const ::std::size_t crossover = ::std::max<::std::size_t>(options.crossover, 1);
+    const ::std::size_t rows = leftMat.rows(), depth = leftMat.cols(), cols = rightMat.cols();
+    unsigned int levels = 0;
+    while ((::std::min({rows, depth, cols}) >> levels) > crossover) levels++;
+    if (levels == 0) return leftMat * rightMat;
+
+    // Pad every dimension to a multiple of 2^levels.
+    const ::std::size_t unit = ::std::size_t(1) << levels;
+    const ::std::size_t paddedRows = (rows + unit - 1) / unit * unit;
+    const ::std::size_t paddedDepth = (depth + unit - 1) / unit * unit;
+    const ::std::size_t paddedCols = (cols + unit - 1) / unit * unit;
+    const unsigned int parallelDepth = ::std::min(options.parallelDepth, levels);
+
+    // A single allocation holds the padded operands, the padded product and every temporary.
+    ::std::size_t leftSize = paddedRows * paddedDepth;
+    ::std::size_t rightSize = paddedDepth * paddedCols;
+    ::std::size_t productSize = paddedRows * paddedCols;
+    ::std::vector<double> arena(leftSize + rightSize + productSize +
+        strassenWorkspaceSize(paddedRows, paddedDepth, paddedCols, levels, parallelDepth));
+    MatrixBlock left = {arena.data(), paddedDepth};
+    MatrixBlock right = {arena.data() + leftSize, paddedCols};
+    MatrixBlock product = {arena.data() + leftSize + rightSize, paddedCols};
+    for (::std::size_t row = 0; row < rows; row++) {
+        ::std::copy(leftMat.data() + row * depth, leftMat.data() + (row + 1) * depth, left.data + row * left.stride);
+    }
+    for (::std::size_t row = 0; row < depth; row++) {
+        ::std::copy(rightMat.data() + row * cols, rightMat.data() + (row + 1) * cols, right.data + row * right.stride);
+    }
+
+    strassenMultiply(paddedRows, paddedDepth, paddedCols, left, right, product, levels, parallelDepth,
+        arena.data() + leftSize + rightSize + productSize);
+
+    DenseMatrix dotProductMatrix(rows, cols);
+    for (::std::size_t row = 0; row < rows; row++) {
+        ::std::copy(product.data + row * product.stride, product.data + row * product.stride + cols,
+            dotProductMatrix.data() + row * cols);
+    }
+    return dotProductMatrix;
+}
+
+/// @brief The error of the Strassen-Winograd product against the classical one,
+/// `max|C_strassen - C_classical| / (depth * max|A| * max|B|)`.
+///
+/// The classical kernel is bounded elementwise by about `depth * epsilon * |A| |B|`,
+/// while Strassen-Winograd is only bounded normwise, with a factor growing with every
+/// level. Jobs that tolerate a value of a few orders of magnitude above epsilon may use it.
+/// @param leftMat The left hand-side matrix.
+/// @param rightMat The right hand-side matrix.
+/// @param options The crossover and the parallel depth.
+inline double strassenRelativeError(const DenseMatrix& leftMat, const DenseMatrix& rightMat,
+    const StrassenOptions& options = StrassenOptions()) {
+    DenseMatrix classical = leftMat * rightMat;
+    DenseMatrix strassen = multiplyStrassen(leftMat, rightMat, options);
+    auto maxAbs = [](const DenseMatrix& mat) {
+        double result = 0.0;
+        for (::std::size_t i = 0; i < mat.rows() * mat.cols(); i++) result = ::std::fmax(result, ::std::fabs(mat.data()[i]));
+        return result;
+    };
+    double difference = 0.0;
+    for (::std::size_t i = 0; i < classical.rows() * classical.cols(); i++) {
+        difference = ::std::fmax(difference, ::std::fabs(classical.data()[i] - strassen.data()[i]));
+    }
+    double scale = static_cast<double>(leftMat.cols()) * maxAbs(leftMat) * maxAbs(rightMat);
+    return scale == 0.0 ? 0.0 : difference / scale;
+}
+
+/// @brief Find the crossover of this machine by timing square products of doubling sizes.
+/// @param maxSize The largest size timed.
+/// @return Half of the smallest size where one Strassen-Winograd level beats the blocked
+/// kernel, or `maxSize` if it never does.
+inline ::std::size_t tuneStrassenCrossover(::std::size_t maxSize = 4096) {
+    auto timeOf = [](auto&& multiply) {
+        auto start = ::std::chrono::steady_clock::now();
+        multiply();
+        return ::std::chrono::steady_clock::now() - start;
+    };
+    for (::std::size_t size = 128; size <= maxSize; size *= 2) {
+        DenseMatrix leftMat(size, size, 1.0), rightMat(size, size, 1.0);
+        StrassenOptions oneLevel;
+        oneLevel.crossover = size / 2;
+        oneLevel.parallelDepth = 0;
+        auto classical = timeOf([&]() { return leftMat * rightMat; });
+        auto strassen = timeOf([&]() { return multiplyStrassen(leftMat, rightMat, oneLevel); });
+        if (strassen < classical) return size / 2;
+    }
+    return maxSize;
+}
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,134 @@
+/*
+
+File: sync_matrix.hpp
+Author: Aldhinn Espinas
+Description: This file contains a 4x4 matrix whose synchronization strategy is chosen
+    at runtime, to compare the strategies on the same workload.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(SYNC_MATRIX_HEADER_FILE)
+#define SYNC_MATRIX_HEADER_FILE
+
+#include <atomic>
+#include <mutex>
+
+#include "matrix.hpp"
+#include "seqlock.hpp"
+
+/// @brief How a matrix that is read and written as a whole is synchronized.
+enum class SyncStrategy {
+    /// @brief Every element is atomic, but nothing keeps the elements together.
+    /// Readers may see a mix of two writes.
+    AtomicOnly,
+    /// @brief Readers and writers take a mutex.
+    Mutex,
+    /// @brief Writers take a mutex, readers read optimistically and retry.
+    SeqLock
+};
+
+/// @brief The name of a strategy, for reports.
+inline const char* toString(SyncStrategy strategy) {
+    switch (strategy) {
+    case SyncStrategy::AtomicOnly: return "atomic only";
+    case SyncStrategy::Mutex: return "mutex";
+    default: return "seqlock";
+    }
+}
+
+/// @brief A description of a 4x4 matrix containing atomic values that is read and
+/// written as a whole, with the synchronization strategy chosen at construction.
+class SynchronizedMatrix4x4 final {
+public:
+    /// @brief Construct with an initial value.
+    /// @param strategy The synchronization strategy.
+    /// @param values The initial value.
+    inline explicit SynchronizedMatrix4x4(SyncStrategy strategy = SyncStrategy::Mutex,
+        const Matrix4x4& values = Matrix4x4::identity()) : _strategy(strategy) {
+        for (int i = 0; i < 16; i++) _data[i].store(values.data[i], ::std::memory_order_relaxed);
+    }
+
+    SynchronizedMatrix4x4(const SynchronizedMatrix4x4&) = delete;
+    SynchronizedMatrix4x4& operator=(const SynchronizedMatrix4x4&) = delete;
+
+    /// @brief The synchronization strategy.
+    inline SyncStrategy strategy() const { return _strategy; }
+
+    /// @brief Read the whole matrix.
+    inline Matrix4x4 load() const {
+        Matrix4x4 values;
+        switch (_strategy) {
+        case SyncStrategy::AtomicOnly:
+            for (int i = 0; i < 16; i++) values.data[i] = _data[i].load();
+            break;
+        case SyncStrategy::Mutex: {
+            ::std::lock_guard<::std::mutex> lock(_mutex);
+            for (int i = 0; i < 16; i++) values.data[i] = _data[i].load(::std::memory_order_relaxed);
+            break;
+        }
+        case SyncStrategy::SeqLock:
+            _version.read([&]() {
+                for (int i = 0; i < 16; i++) values.data[i] = _data[i].load(::std::memory_order_relaxed);
+            });
+            break;
+        }
+        return values;
+    }
+    /// @brief Write the whole matrix.
+    /// @param values The new value.
+    inline void store(const Matrix4x4& values) {
+        switch (_strategy) {
+        case SyncStrategy::AtomicOnly:
+            for (int i = 0; i < 16; i++) _data[i].store(values.data[i]);
+            break;
+        case SyncStrategy::Mutex: {
+            ::std::lock_guard<::std::mutex> lock(_mutex);
+            for (int i = 0; i < 16; i++) _data[i].store(values.data[i], ::std::memory_order_relaxed);
+            break;
+        }
+        case SyncStrategy::SeqLock: {
+            // Writers are serialized, or the last two writes could end up mixed.
+            ::std::lock_guard<::std::mutex> lock(_mutex);
+            SeqLockWriteGuard guard(_version);
+            for (int i = 0; i < 16; i++) _data[i].store(values.data[i], ::std::memory_order_relaxed);
+            break;
+        }
+        }
+    }
+
+private:
+    /// @brief The synchronization strategy.
+    const SyncStrategy _strategy;
+    /// @brief The row-major container for the matrix components.
+    ::std::atomic<double> _data[16];
+    /// @brief Serializes writers, and readers under `SyncStrategy::Mutex`.
+    mutable ::std::mutex _mutex;
+    /// @brief The version checked by readers under `SyncStrategy::SeqLock`.
+    SeqLock _version;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
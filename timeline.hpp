@@ -0,0 +1,241 @@
+/*
+
+File: timeline.hpp
+Author: Aldhinn Espinas
+Description: This file contains a collector of accuracy and throughput over time
+    windows of a run.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(TIMELINE_HEADER_FILE)
+#define TIMELINE_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <vector>
+
+/// @brief The events counted by a `Timeline`.
+enum class TimelineCounter : unsigned int {
+    /// @brief A read of the shared data.
+    Reads,
+    /// @brief A write to the shared data.
+    Writes,
+    /// @brief A read that had to be repeated.
+    Retries,
+    /// @brief A calculation that turned out correct.
+    CorrectCalculations,
+    /// @brief A calculation that turned out incorrect.
+    IncorrectCalculations
+};
+
+/// @brief A collector of event counts per time window, such as 10 ms, over a run.
+///
+/// Each thread counts into counters of its own, so counting takes no lock and no
+/// read-modify-write. The windows are rolled up from every thread on demand, while the
+/// run goes on. Events past the last window are counted together in an overflow.
+class Timeline final {
+public:
+    /// @brief The number of kinds of events.
+    static constexpr unsigned int COUNTER_COUNT = 5;
+
+    /// @brief The counts of a window, summed over every thread.
+    struct Window {
+        /// @brief The start of the window, since the start of the run.
+        double startSeconds;
+        /// @brief The length of the window, or of its part elapsed so far.
+        double seconds;
+        /// @brief The count of each event.
+        unsigned long long counts[COUNTER_COUNT];
+
+        /// @brief The count of an event.
+        inline unsigned long long count(TimelineCounter counter) const {
+            return counts[static_cast<unsigned int>(counter)];
+        }
+        /// @brief The count of an event per second.
+        inline double rate(TimelineCounter counter) const {
+            return static_cast<double>(count(counter)) / seconds;
+        }
+        /// @brief The percentage of correct calculations. Not a number without calculations.
+        inline double accuracy() const {
+            unsigned long long correct = count(TimelineCounter::CorrectCalculations);
+            unsigned long long total = correct + count(TimelineCounter::IncorrectCalculations);
+            return (static_cast<double>(correct) * 100.0) / static_cast<double>(total);
+        }
+    };
+
+    /// @brief The counters of a thread. Only that thread writes to them.
+    class Recorder final {
+    public:
+        /// @brief Count events in the current window.
+        /// @param counter The event.
+        /// @param amount The number of events.
+        inline void add(TimelineCounter counter, unsigned long long amount = 1) {
+            auto elapsed = ::std::chrono::steady_clock::now() - _timeline->_start;
+            // Events past the last window go to the overflow, after it.
+            ::std::size_t window = ::std::min(static_cast<::std::size_t>(elapsed / _timeline->_window),
+                _timeline->_windowCount);
+            ::std::atomic<unsigned long long>& slot =
+                _counters[window * COUNTER_COUNT + static_cast<unsigned int>(counter)];
+            // A single writer, no read-modify-write needed.
+            slot.store(slot.load(::std::memory_order_relaxed) + amount, ::std::memory_order_relaxed);
+        }
+
+    private:
+        friend class Timeline;
+        inline Recorder(const Timeline* timeline, ::std::atomic<unsigned long long>* counters) :
+        _timeline(timeline), _counters(counters) {}
+
+        /// @brief The timeline. Needs to outlive the recorder.
+        const Timeline* _timeline;
+        /// @brief The counters of this thread, window by window, then the overflow.
+        ::std::atomic<unsigned long long>* _counters;
+    };
+
+    /// @brief Start a run.
+    /// @param window The length of a window.
+    /// @param windowCount The number of windows recorded, from the start of the run. Later
+    /// events are counted in the overflow.
+    /// @param maxThreads The number of threads that may record.
+    inline explicit Timeline(::std::chrono::microseconds window = ::std::chrono::milliseconds(10),
+        ::std::size_t windowCount = 6000, unsigned int maxThreads = 64) :
+    _start(::std::chrono::steady_clock::now()), _window(window), _windowCount(windowCount),
+    _threads(new ::std::atomic<::std::atomic<unsigned long long>*>[maxThreads]), _maxThreads(maxThreads),
+    _threadCount(0) {
+        if (window.count() <= 0) {
+            throw ::std::invalid_argument("The window has to be longer than zero.");
+        }
+        for (unsigned int i = 0; i < maxThreads; i++) _threads[i].store(nullptr, ::std::memory_order_relaxed);
+    }
+
+    Timeline(const Timeline&) = delete;
+    Timeline& operator=(const Timeline&) = delete;
+
+    /// @brief Get the counters of a new thread.
+    /// @return The recorder, to be used by a single thread.
+    inline Recorder recorder() {
+        ::std::size_t size = (_windowCount + 1) * COUNTER_COUNT;
+        ::std::unique_ptr<::std::atomic<unsigned long long>[]> counters(new ::std::atomic<unsigned long long>[size]);
+        for (::std::size_t i = 0; i < size; i++) counters[i].store(0, ::std::memory_order_relaxed);
+
+        ::std::lock_guard<::std::mutex> lock(_registration);
+        unsigned int index = _threadCount.load(::std::memory_order_relaxed);
+        if (index >= _maxThreads) {
+            throw ::std::length_error("Too many threads for the timeline.");
+        }
+        Recorder result(this, counters.get());
+        _threads[index].store(counters.get(), ::std::memory_order_release);
+        _threadCount.store(index + 1, ::std::memory_order_release);
+        _owned.push_back(::std::move(counters));
+        return result;
+    }
+
+    /// @brief Roll up the windows from every thread, up to the current one. The current
+    /// window only spans the time elapsed in it, so that its rates are not understated.
+    inline ::std::vector<Window> windows() const {
+        auto elapsed = ::std::chrono::steady_clock::now() - _start;
+        ::std::size_t count = ::std::min<::std::size_t>(_windowCount, static_cast<::std::size_t>(elapsed / _window) + 1);
+        return rollUp(0, count, ::std::chrono::duration<double>(elapsed).count());
+    }
+    /// @brief Roll up the events past the last window, from its end until now.
+    /// @return The counts, over no time at all while the last window is not over.
+    inline Window overflow() const {
+        double elapsedSeconds = ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - _start).count();
+        return rollUp(_windowCount, _windowCount + 1, elapsedSeconds)[0];
+    }
+
+    /// @brief Write the windows as CSV, with a header line. The accuracy is left empty in
+    /// windows without calculations.
+    /// @param output The stream.
+    inline void writeCsv(::std::ostream& output) const {
+        output << "start_seconds,reads_per_second,writes_per_second,retries_per_second,accuracy_percent,"
+            "reads,writes,retries,correct,incorrect\n";
+        for (const Window& window : windows()) {
+            output << window.startSeconds << ','
+                << window.rate(TimelineCounter::Reads) << ','
+                << window.rate(TimelineCounter::Writes) << ','
+                << window.rate(TimelineCounter::Retries) << ',';
+            double accuracy = window.accuracy();
+            if (accuracy == accuracy) output << accuracy;
+            for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) output << ',' << window.counts[counter];
+            output << '\n';
+        }
+    }
+
+private:
+    /// @brief Sum the counters of every thread over a range of windows.
+    /// @param begin The first window.
+    /// @param end One past the last window.
+    /// @param elapsedSeconds The time since the start of the run, which ends the windows.
+    inline ::std::vector<Window> rollUp(::std::size_t begin, ::std::size_t end, double elapsedSeconds) const {
+        double windowSeconds = ::std::chrono::duration<double>(_window).count();
+        ::std::vector<Window> result(end - begin);
+        for (::std::size_t window = begin; window < end; window++) {
+            Window& target = result[window - begin];
+            target.startSeconds = static_cast<double>(window) * windowSeconds;
+            // The overflow runs from the end of the last window until now.
+            double windowEnd = window < _windowCount ? target.startSeconds + windowSeconds : elapsedSeconds;
+            target.seconds = ::std::max(0.0, ::std::min(windowEnd, elapsedSeconds) - target.startSeconds);
+            for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) target.counts[counter] = 0;
+        }
+        unsigned int threadCount = _threadCount.load(::std::memory_order_acquire);
+        for (unsigned int thread = 0; thread < threadCount; thread++) {
+            const ::std::atomic<unsigned long long>* counters = _threads[thread].load(::std::memory_order_acquire);
+            for (::std::size_t window = begin; window < end; window++) {
+                for (unsigned int counter = 0; counter < COUNTER_COUNT; counter++) {
+                    result[window - begin].counts[counter] +=
+                        counters[window * COUNTER_COUNT + counter].load(::std::memory_order_relaxed);
+                }
+            }
+        }
+        return result;
+    }
+
+    /// @brief The start of the run.
+    const ::std::chrono::steady_clock::time_point _start;
+    /// @brief The length of a window.
+    const ::std::chrono::steady_clock::duration _window;
+    /// @brief The number of windows recorded.
+    const ::std::size_t _windowCount;
+    /// @brief The counters of each registered thread.
+    ::std::unique_ptr<::std::atomic<::std::atomic<unsigned long long>*>[]> _threads;
+    /// @brief The number of threads that may record.
+    const unsigned int _maxThreads;
+    /// @brief The number of registered threads.
+    ::std::atomic<unsigned int> _threadCount;
+    /// @brief Owns the counters of the registered threads.
+    ::std::vector<::std::unique_ptr<::std::atomic<unsigned long long>[]>> _owned;
+    /// @brief Serializes registrations.
+    ::std::mutex _registration;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
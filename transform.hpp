@@ -0,0 +1,356 @@
+/*
+
+File: transform.hpp
+Author: Aldhinn Espinas
+Description: This file contains the compact similarity transform declarations.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(TRANSFORM_HEADER_FILE)
+#define TRANSFORM_HEADER_FILE
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+
+#if defined(__SSE__)
+#include <immintrin.h>
+#endif
+
+#include "matrix.hpp"
+#include "seqlock.hpp"
+
+/// @brief A description of a similarity transform: a rotation, a uniform scale and a translation.
+///
+/// A point `p` is transformed to `scale * R(rotation) p + translation`, which is what
+/// the 4x4 matrix `[ scale * R  translation ; 0 0 0 1 ]` does to column vectors.
+/// The whole transform fits in 32 bytes.
+struct alignas(32) TrsTransform {
+    /// @brief The unit rotation quaternion, as `x, y, z, w`.
+    float rotation[4];
+    /// @brief The translation.
+    float translation[3];
+    /// @brief The uniform scale.
+    float scale;
+
+    /// @brief The identity transform.
+    inline static TrsTransform identity() {
+        return {{0.0f, 0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, 0.0f}, 1.0f};
+    }
+
+    /// @brief Transform a point.
+    /// @param point The `x, y, z` of the point.
+    /// @param result The `x, y, z` of the transformed point.
+    inline void transformPoint(const float point[3], float result[3]) const {
+#if defined(__SSE__)
+        __m128 transformed = transformPoint(_mm_setr_ps(point[0], point[1], point[2], 0.0f));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, transformed);
+        result[0] = lanes[0];
+        result[1] = lanes[1];
+        result[2] = lanes[2];
+#else
+        float rotated[3];
+        rotate(rotation, point, rotated);
+        for (int i = 0; i < 3; i++) result[i] = scale * rotated[i] + translation[i];
+#endif
+    }
+
+    /// @brief Transform many points.
+    /// @param points The `x, y, z` of each point, packed.
+    /// @param results The `x, y, z` of each transformed point, packed.
+    /// @param count The number of points.
+    inline void transformPoints(const float* points, float* results, ::std::size_t count) const {
+        for (::std::size_t i = 0; i < count; i++) {
+            transformPoint(points + i * 3, results + i * 3);
+        }
+    }
+
+    /// @brief The inverse transform.
+    /// @return The inverse transform.
+    inline TrsTransform inverse() const {
+        TrsTransform result;
+        // The inverse of a unit quaternion is its conjugate.
+        result.rotation[0] = -rotation[0];
+        result.rotation[1] = -rotation[1];
+        result.rotation[2] = -rotation[2];
+        result.rotation[3] = rotation[3];
+        result.scale = 1.0f / scale;
+        // p = R^-1 (q - t) / s, so the translation is -R^-1 t / s.
+        float rotated[3];
+        rotate(result.rotation, translation, rotated);
+        for (int i = 0; i < 3; i++) result.translation[i] = -rotated[i] * result.scale;
+        return result;
+    }
+
+    /// @brief The equivalent 4x4 matrix.
+    /// @return The plain matrix.
+    inline Matrix4x4 toMatrix4x4() const {
+        double x = rotation[0], y = rotation[1], z = rotation[2], w = rotation[3];
+        double s = scale;
+        return {{
+            s * (1.0 - 2.0 * (y * y + z * z)), s * 2.0 * (x * y - z * w), s * 2.0 * (x * z + y * w), translation[0],
+            s * 2.0 * (x * y + z * w), s * (1.0 - 2.0 * (x * x + z * z)), s * 2.0 * (y * z - x * w), translation[1],
+            s * 2.0 * (x * z - y * w), s * 2.0 * (y * z + x * w), s * (1.0 - 2.0 * (x * x + y * y)), translation[2],
+            0.0, 0.0, 0.0, 1.0
+        }};
+    }
+    /// @brief The equivalent atomic 4x4 matrix.
+    /// @return The atomic matrix.
+    inline AtomicMatrix4x4 toMatrix() const {
+        return AtomicMatrix4x4(toMatrix4x4());
+    }
+
+    /// @brief Convert a 4x4 matrix into a transform.
+    ///
+    /// The conversion succeeds when the matrix is a similarity transform without
+    /// reflection whose components are in the range of `float`, and converting the
+    /// result back reproduces the matrix within `tolerance`.
+    /// @param matrix The matrix to be converted.
+    /// @param result The converted transform, left untouched on failure.
+    /// @param tolerance The accepted round-trip error, relative to the largest component.
+    /// @return Whether the conversion succeeded.
+    inline static bool tryFromMatrix(const Matrix4x4& matrix, TrsTransform& result, double tolerance = 1e-5) {
+        const double* m = matrix.data;
+        // Projective transforms have no TRS form.
+        if (m[12] != 0.0 || m[13] != 0.0 || m[14] != 0.0 || m[15] != 1.0) return false;
+
+        double largest = 1.0;
+        for (int i = 0; i < 16; i++) {
+            if (!::std::isfinite(m[i])) return false;
+            largest = ::std::max(largest, ::std::fabs(m[i]));
+        }
+        if (largest > static_cast<double>(::std::numeric_limits<float>::max())) return false;
+
+        // The uniform scale follows from the determinant of the linear part.
+        double determinant =
+            m[0] * (m[5] * m[10] - m[6] * m[9]) -
+            m[1] * (m[4] * m[10] - m[6] * m[8]) +
+            m[2] * (m[4] * m[9] - m[5] * m[8]);
+        if (!(determinant > 0.0)) return false;
+        double s = ::std::cbrt(determinant);
+
+        // Extract the rotation quaternion from the normalized linear part.
+        double r[3][3];
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 3; col++) r[row][col] = m[row * 4 + col] / s;
+        }
+        double q[4];
+        double trace = r[0][0] + r[1][1] + r[2][2];
+        if (trace > 0.0) {
+            double k = 0.5 / ::std::sqrt(trace + 1.0);
+            q[3] = 0.25 / k;
+            q[0] = (r[2][1] - r[1][2]) * k;
+            q[1] = (r[0][2] - r[2][0]) * k;
+            q[2] = (r[1][0] - r[0][1]) * k;
+        } else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+            double k = 2.0 * ::std::sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]);
+            q[3] = (r[2][1] - r[1][2]) / k;
+            q[0] = 0.25 * k;
+            q[1] = (r[0][1] + r[1][0]) / k;
+            q[2] = (r[0][2] + r[2][0]) / k;
+        } else if (r[1][1] > r[2][2]) {
+            double k = 2.0 * ::std::sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]);
+            q[3] = (r[0][2] - r[2][0]) / k;
+            q[0] = (r[0][1] + r[1][0]) / k;
+            q[1] = 0.25 * k;
+            q[2] = (r[1][2] + r[2][1]) / k;
+        } else {
+            double k = 2.0 * ::std::sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]);
+            q[3] = (r[1][0] - r[0][1]) / k;
+            q[0] = (r[0][2] + r[2][0]) / k;
+            q[1] = (r[1][2] + r[2][1]) / k;
+            q[2] = 0.25 * k;
+        }
+        double norm = ::std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+
+        TrsTransform candidate;
+        for (int i = 0; i < 4; i++) candidate.rotation[i] = static_cast<float>(q[i] / norm);
+        for (int i = 0; i < 3; i++) candidate.translation[i] = static_cast<float>(m[i * 4 + 3]);
+        candidate.scale = static_cast<float>(s);
+
+        // Shear and non-uniform scale do not survive the round trip.
+        Matrix4x4 roundTrip = candidate.toMatrix4x4();
+        for (int i = 0; i < 16; i++) {
+            if (::std::fabs(roundTrip.data[i] - m[i]) > tolerance * largest) return false;
+        }
+        result = candidate;
+        return true;
+    }
+    /// @brief Convert a 4x4 matrix into a transform.
+    /// @param matrix The matrix to be converted.
+    /// @param tolerance The accepted round-trip error, relative to the largest component.
+    /// @return The converted transform.
+    inline static TrsTransform fromMatrix(const Matrix4x4& matrix, double tolerance = 1e-5) {
+        TrsTransform result;
+        if (!tryFromMatrix(matrix, result, tolerance)) {
+            throw ::std::domain_error("The matrix is not a similarity transform in the range of a TrsTransform.");
+        }
+        return result;
+    }
+    /// @brief Convert an atomic 4x4 matrix into a transform.
+    /// @param matrix The matrix to be converted.
+    /// @param tolerance The accepted round-trip error, relative to the largest component.
+    /// @return The converted transform.
+    inline static TrsTransform fromMatrix(const AtomicMatrix4x4& matrix, double tolerance = 1e-5) {
+        return fromMatrix(matrix.snapshot(), tolerance);
+    }
+
+#if defined(__SSE__)
+    /// @brief Transform a point held in the first three lanes.
+    inline __m128 transformPoint(__m128 point) const {
+        __m128 rotated = rotate(_mm_load_ps(rotation), point);
+        __m128 offset = _mm_setr_ps(translation[0], translation[1], translation[2], 0.0f);
+        return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(scale), rotated), offset);
+    }
+
+    /// @brief The cross product of the first three lanes.
+    inline static __m128 cross(__m128 left, __m128 right) {
+        __m128 leftYzx = _mm_shuffle_ps(left, left, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 rightYzx = _mm_shuffle_ps(right, right, _MM_SHUFFLE(3, 0, 2, 1));
+        __m128 crossZxy = _mm_sub_ps(_mm_mul_ps(left, rightYzx), _mm_mul_ps(leftYzx, right));
+        return _mm_shuffle_ps(crossZxy, crossZxy, _MM_SHUFFLE(3, 0, 2, 1));
+    }
+    /// @brief Rotate the first three lanes of `vector` by the unit quaternion `quaternion`.
+    inline static __m128 rotate(__m128 quaternion, __m128 vector) {
+        // v' = v + w t + u x t, with t = 2 (u x v) and u the vector part of the quaternion.
+        __m128 w = _mm_shuffle_ps(quaternion, quaternion, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 t = cross(quaternion, vector);
+        t = _mm_add_ps(t, t);
+        return _mm_add_ps(_mm_add_ps(vector, _mm_mul_ps(w, t)), cross(quaternion, t));
+    }
+    /// @brief The Hamilton product of two quaternions.
+    inline static __m128 multiplyQuaternions(__m128 left, __m128 right) {
+        __m128 leftX = _mm_shuffle_ps(left, left, _MM_SHUFFLE(0, 0, 0, 0));
+        __m128 leftY = _mm_shuffle_ps(left, left, _MM_SHUFFLE(1, 1, 1, 1));
+        __m128 leftZ = _mm_shuffle_ps(left, left, _MM_SHUFFLE(2, 2, 2, 2));
+        __m128 leftW = _mm_shuffle_ps(left, left, _MM_SHUFFLE(3, 3, 3, 3));
+        __m128 product = _mm_mul_ps(leftW, right);
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_mul_ps(leftX,
+            _mm_shuffle_ps(right, right, _MM_SHUFFLE(0, 1, 2, 3))), _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f)));
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_mul_ps(leftY,
+            _mm_shuffle_ps(right, right, _MM_SHUFFLE(1, 0, 3, 2))), _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f)));
+        product = _mm_add_ps(product, _mm_mul_ps(_mm_mul_ps(leftZ,
+            _mm_shuffle_ps(right, right, _MM_SHUFFLE(2, 3, 0, 1))), _mm_setr_ps(-1.0f, 1.0f, 1.0f, -1.0f)));
+        return product;
+    }
+#endif
+
+    /// @brief Rotate a vector by a unit quaternion.
+    inline static void rotate(const float quaternion[4], const float vector[3], float result[3]) {
+        const float* u = quaternion;
+        float t[3] = {
+            2.0f * (u[1] * vector[2] - u[2] * vector[1]),
+            2.0f * (u[2] * vector[0] - u[0] * vector[2]),
+            2.0f * (u[0] * vector[1] - u[1] * vector[0])
+        };
+        result[0] = vector[0] + quaternion[3] * t[0] + (u[1] * t[2] - u[2] * t[1]);
+        result[1] = vector[1] + quaternion[3] * t[1] + (u[2] * t[0] - u[0] * t[2]);
+        result[2] = vector[2] + quaternion[3] * t[2] + (u[0] * t[1] - u[1] * t[0]);
+    }
+};
+
+/// @brief The composition of two transforms. `(left * right)(p) = left(right(p))`.
+/// @param left The transform applied last.
+/// @param right The transform applied first.
+/// @return The composed transform.
+inline TrsTransform operator*(const TrsTransform& left, const TrsTransform& right) {
+    TrsTransform result;
+#if defined(__SSE__)
+    __m128 leftRotation = _mm_load_ps(left.rotation);
+    _mm_store_ps(result.rotation, TrsTransform::multiplyQuaternions(leftRotation, _mm_load_ps(right.rotation)));
+    // The translation of the right transform goes through the left one.
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, left.transformPoint(
+        _mm_setr_ps(right.translation[0], right.translation[1], right.translation[2], 0.0f)));
+    result.translation[0] = lanes[0];
+    result.translation[1] = lanes[1];
+    result.translation[2] = lanes[2];
+#else
+    const float* a = left.rotation;
+    const float* b = right.rotation;
+    result.rotation[0] = a[3] * b[0] + a[0] * b[3] + a[1] * b[2] - a[2] * b[1];
+    result.rotation[1] = a[3] * b[1] - a[0] * b[2] + a[1] * b[3] + a[2] * b[0];
+    result.rotation[2] = a[3] * b[2] + a[0] * b[1] - a[1] * b[0] + a[2] * b[3];
+    result.rotation[3] = a[3] * b[3] - a[0] * b[0] - a[1] * b[1] - a[2] * b[2];
+    left.transformPoint(right.translation, result.translation);
+#endif
+    result.scale = left.scale * right.scale;
+    return result;
+}
+
+static_assert(sizeof(TrsTransform) == 8 * sizeof(float), "TrsTransform is expected to be 8 packed floats.");
+
+/// @brief A transform that is published and read as a whole. Readers take no thread
+/// lock, writers take turns under one.
+class AtomicTrsTransform final {
+public:
+    /// @brief Construct with an initial transform.
+    /// @param value The initial transform.
+    inline explicit AtomicTrsTransform(const TrsTransform& value = TrsTransform::identity()) {
+        store(value);
+    }
+
+    AtomicTrsTransform(const AtomicTrsTransform&) = delete;
+    AtomicTrsTransform& operator=(const AtomicTrsTransform&) = delete;
+
+    /// @brief Publish a new transform.
+    /// @param value The new transform.
+    inline void store(const TrsTransform& value) {
+        float components[8];
+        ::std::memcpy(components, &value, sizeof(components));
+        // Writers are serialized, or the last two writes could end up mixed.
+        ::std::lock_guard<::std::mutex> lock(_writeMutex);
+        SeqLockWriteGuard guard(_version);
+        for (int i = 0; i < 8; i++) _components[i].store(components[i], ::std::memory_order_relaxed);
+    }
+    /// @brief Read the last published transform.
+    /// @return A transform that was published as a whole.
+    inline TrsTransform load() const {
+        float components[8];
+        _version.read([&]() {
+            for (int i = 0; i < 8; i++) components[i] = _components[i].load(::std::memory_order_relaxed);
+        });
+        TrsTransform value;
+        ::std::memcpy(&value, components, sizeof(components));
+        return value;
+    }
+
+private:
+    /// @brief The rotation, translation and scale, in the layout of `TrsTransform`.
+    ::std::atomic<float> _components[8];
+    /// @brief The version of the components.
+    SeqLock _version;
+    /// @brief Serializes writers.
+    ::std::mutex _writeMutex;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
@@ -0,0 +1,860 @@
+/*
+
+File: wal.hpp
+Author: Aldhinn Espinas
+Description: This file contains a write-ahead log with group commit, and a matrix
+    registry made durable with it and with checkpoints.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(WAL_HEADER_FILE)
+#define WAL_HEADER_FILE
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+#include "matrix.hpp"
+#include "registry.hpp"
+
+/// @brief The CRC-32C of a buffer, a byte at a time.
+/// @param crc The CRC of the preceding bytes, 0 to start.
+/// @param data The bytes.
+/// @param size The number of bytes.
+/// @return The CRC up to the end of the bytes.
+inline ::std::uint32_t crc32cSoftware(::std::uint32_t crc, const void* data, ::std::size_t size) {
+    static const ::std::vector<::std::uint32_t> table = []() {
+        ::std::vector<::std::uint32_t> entries(256);
+        for (::std::uint32_t byte = 0; byte < 256; byte++) {
+            ::std::uint32_t value = byte;
+            for (int bit = 0; bit < 8; bit++) value = (value >> 1) ^ ((value & 1u) != 0 ? 0x82f63b78u : 0u);
+            entries[byte] = value;
+        }
+        return entries;
+    }();
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    for (::std::size_t i = 0; i < size; i++) crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+/// @brief The CRC-32C of a buffer, with the CRC instruction where available.
+/// @param crc The CRC of the preceding bytes, 0 to start.
+/// @param data The bytes.
+/// @param size The number of bytes.
+/// @return The CRC up to the end of the bytes.
+inline ::std::uint32_t crc32c(::std::uint32_t crc, const void* data, ::std::size_t size) {
+#if defined(__SSE4_2__)
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    ::std::uint64_t value = ~crc & 0xffffffffu;
+    ::std::size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        ::std::uint64_t word;
+        ::std::memcpy(&word, bytes + i, sizeof(word));
+        value = _mm_crc32_u64(value, word);
+    }
+    ::std::uint32_t tail = static_cast<::std::uint32_t>(value);
+    for (; i < size; i++) tail = _mm_crc32_u8(tail, bytes[i]);
+    return ~tail;
+#else
+    return crc32cSoftware(crc, data, size);
+#endif
+}
+
+/// @brief The options of a `WriteAheadLog`.
+struct WalOptions {
+    /// @brief The size past which a new segment file is started.
+    ::std::size_t segmentSize = 64ull * 1024 * 1024;
+    /// @brief Whether a commit waits for `fdatasync`. Only for tests and benchmarks of
+    /// the rest when off.
+    bool isSyncing = true;
+};
+
+/// @brief An append-only log of records, made durable by group commit.
+///
+/// The log is a directory of segment files, each named after the sequence number of its
+/// first record. A record is a checksummed header followed by its payload. Writers that
+/// append while a commit is in progress queue their records, and the next of them to run
+/// writes and syncs them all at once, so a single `fdatasync` commits the records of
+/// many writers.
+class WriteAheadLog final {
+public:
+    /// @brief Open the log of a directory, creating both if missing. A record cut short
+    /// by a crash at the end of the log is dropped.
+    /// @param directory The directory of the log.
+    /// @param options The options.
+    /// @param lastCovered The sequence number of the last record covered elsewhere, such as
+    /// by a checkpoint. Records are numbered after it even if the log ends before it.
+    inline explicit WriteAheadLog(const ::std::string& directory, const WalOptions& options = WalOptions(),
+        ::std::uint64_t lastCovered = 0) :
+    _directory(directory), _options(options), _fd(-1), _segmentSize(0), _nextSequence(1), _durableSequence(0),
+    _isFlushing(false), _syncCount(0) {
+        if (::mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) throwSystemError("Cannot create the log " + directory);
+        ::std::vector<::std::uint64_t> segments = listSegments(directory);
+        for (::std::size_t i = 0; i < segments.size(); i++) {
+            ::std::uint64_t end = 0;
+            ::std::uint64_t last = scanSegment(segmentPath(directory, segments[i]), segments[i], nullptr, end);
+            if (last != 0) _nextSequence = last + 1;
+            bool isLast = i + 1 == segments.size();
+            struct stat status;
+            if (::stat(segmentPath(directory, segments[i]).c_str(), &status) != 0) {
+                throwSystemError("Cannot read the log " + directory);
+            }
+            if (static_cast<::std::uint64_t>(status.st_size) != end) {
+                if (!isLast) {
+                    throw ::std::runtime_error("The log " + directory + " is corrupt.");
+                }
+                if (::truncate(segmentPath(directory, segments[i]).c_str(), static_cast<::off_t>(end)) != 0) {
+                    throwSystemError("Cannot repair the log " + directory);
+                }
+            }
+        }
+        // The records of an empty last segment were all checkpointed and removed.
+        if (!segments.empty()) _nextSequence = ::std::max(_nextSequence, segments.back());
+        // Numbers past the end of the log may have been used by records that did not make
+        // it, and have to stay unused. Sequence numbers are contiguous within a segment.
+        bool isSkipping = lastCovered >= _nextSequence;
+        if (isSkipping) _nextSequence = lastCovered + 1;
+        _durableSequence = _nextSequence - 1;
+        _segments = segments;
+        if (segments.empty() || isSkipping) {
+            openSegment(_nextSequence);
+        } else {
+            _fd = ::open(segmentPath(directory, segments.back()).c_str(), O_WRONLY | O_APPEND);
+            if (_fd < 0) throwSystemError("Cannot open the log " + directory);
+            _segmentSize = static_cast<::std::size_t>(::lseek(_fd, 0, SEEK_END));
+        }
+    }
+    inline ~WriteAheadLog() {
+        if (_fd >= 0) ::close(_fd);
+    }
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    /// @brief Append a record and wait until it is durable.
+    /// @param data The payload.
+    /// @param size The size of the payload.
+    /// @param onSequenced The callable taking the sequence number of the record, run
+    /// while no other record can be sequenced. Changes made by it follow the order of the log.
+    /// @return The sequence number of the record.
+    template <typename Sequenced>
+    inline ::std::uint64_t append(const void* data, ::std::size_t size, Sequenced&& onSequenced) {
+        if (size > 0xffffffffu) {
+            throw ::std::length_error("The record is too large.");
+        }
+        ::std::unique_lock<::std::mutex> lock(_mutex);
+        if (_error) ::std::rethrow_exception(_error);
+        ::std::uint64_t sequence = _nextSequence;
+        onSequenced(sequence);
+        _nextSequence++;
+        Header header = {0, static_cast<::std::uint32_t>(size), sequence};
+        header.crc = crc32c(crc32c(0, &header.size, sizeof(Header) - sizeof(header.crc)), data, size);
+        _pending.append(reinterpret_cast<const char*>(&header), sizeof(header));
+        _pending.append(static_cast<const char*>(data), size);
+        waitUntilDurable(lock, sequence);
+        return sequence;
+    }
+    /// @brief Append a record and wait until it is durable.
+    inline ::std::uint64_t append(const void* data, ::std::size_t size) {
+        return append(data, size, [](::std::uint64_t) {});
+    }
+
+    /// @brief Run a callable between two records, while none can be sequenced.
+    /// @param atCut The callable taking the sequence number of the last record.
+    /// @return The sequence number of the last record.
+    template <typename Cut>
+    inline ::std::uint64_t cut(Cut&& atCut) {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        atCut(_nextSequence - 1);
+        return _nextSequence - 1;
+    }
+    /// @brief Wait until the records up to a sequence number are durable, committing them
+    /// if no writer is.
+    /// @param sequence The sequence number, at most the last one appended.
+    inline void sync(::std::uint64_t sequence) {
+        ::std::unique_lock<::std::mutex> lock(_mutex);
+        waitUntilDurable(lock, ::std::min(sequence, _nextSequence - 1));
+    }
+    /// @brief Commit the queued records and start a new segment with the next record.
+    inline void rotate() {
+        ::std::unique_lock<::std::mutex> lock(_mutex);
+        while (_isFlushing) _condition.wait(lock);
+        if (_error) ::std::rethrow_exception(_error);
+        flushPending(lock, true);
+    }
+    /// @brief Remove the segments holding nothing but records before a sequence number.
+    /// The current segment is always kept.
+    /// @param sequence The first sequence number to keep.
+    /// @return The number of segments removed.
+    inline ::std::size_t truncateBefore(::std::uint64_t sequence) {
+        ::std::vector<::std::uint64_t> removed;
+        {
+            ::std::lock_guard<::std::mutex> lock(_segmentsMutex);
+            while (_segments.size() > 1 && _segments[1] <= sequence) {
+                removed.push_back(_segments.front());
+                _segments.erase(_segments.begin());
+            }
+        }
+        for (::std::uint64_t segment : removed) ::unlink(segmentPath(_directory, segment).c_str());
+        return removed.size();
+    }
+
+    /// @brief The sequence number of the last record appended.
+    inline ::std::uint64_t lastSequence() const {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        return _nextSequence - 1;
+    }
+    /// @brief The number of syncs, each committing a group of records.
+    inline unsigned long long syncCount() const {
+        ::std::lock_guard<::std::mutex> lock(_mutex);
+        return _syncCount;
+    }
+    /// @brief The number of segment files.
+    inline ::std::size_t segmentCount() const {
+        ::std::lock_guard<::std::mutex> lock(_segmentsMutex);
+        return _segments.size();
+    }
+
+    /// @brief Read the records of a log in order, up to the first damaged one.
+    /// @param directory The directory of the log.
+    /// @param fromSequence The first sequence number of interest.
+    /// @param reader The callable taking the sequence number, the payload and its size.
+    /// @return The sequence number of the last record read, 0 if none.
+    template <typename Reader>
+    inline static ::std::uint64_t replay(const ::std::string& directory, ::std::uint64_t fromSequence, Reader&& reader) {
+        ::std::vector<::std::uint64_t> segments = listSegments(directory);
+        ::std::uint64_t last = 0;
+        for (::std::size_t i = 0; i < segments.size(); i++) {
+            if (i + 1 < segments.size() && segments[i + 1] <= fromSequence) continue;
+            ::std::uint64_t end = 0;
+            auto filter = [&](::std::uint64_t sequence, const char* data, ::std::size_t size) {
+                if (sequence >= fromSequence) reader(sequence, data, size);
+            };
+            ::std::function<void(::std::uint64_t, const char*, ::std::size_t)> callback = filter;
+            ::std::uint64_t segmentLast = scanSegment(segmentPath(directory, segments[i]), segments[i], &callback, end);
+            if (segmentLast != 0) last = segmentLast;
+        }
+        return last;
+    }
+    /// @brief Remove the directory of a log, with every file in it.
+    inline static void destroy(const ::std::string& directory) {
+        DIR* handle = ::opendir(directory.c_str());
+        if (handle == nullptr) return;
+        while (dirent* entry = ::readdir(handle)) {
+            if (::std::strcmp(entry->d_name, ".") != 0 && ::std::strcmp(entry->d_name, "..") != 0) {
+                ::unlink((directory + "/" + entry->d_name).c_str());
+            }
+        }
+        ::closedir(handle);
+        ::rmdir(directory.c_str());
+    }
+
+private:
+    /// @brief The header of a record.
+    struct Header {
+        /// @brief The CRC-32C of the rest of the header and of the payload.
+        ::std::uint32_t crc;
+        /// @brief The size of the payload.
+        ::std::uint32_t size;
+        /// @brief The sequence number.
+        ::std::uint64_t sequence;
+    };
+
+    [[noreturn]] inline static void throwSystemError(const ::std::string& message) {
+        throw ::std::system_error(errno, ::std::generic_category(), message);
+    }
+    inline static ::std::string segmentPath(const ::std::string& directory, ::std::uint64_t firstSequence) {
+        char name[40];
+        ::std::snprintf(name, sizeof(name), "/segment-%020llu.wal", static_cast<unsigned long long>(firstSequence));
+        return directory + name;
+    }
+    /// @brief The first sequence numbers of the segments of a log, in order.
+    inline static ::std::vector<::std::uint64_t> listSegments(const ::std::string& directory) {
+        ::std::vector<::std::uint64_t> segments;
+        DIR* handle = ::opendir(directory.c_str());
+        if (handle == nullptr) return segments;
+        while (dirent* entry = ::readdir(handle)) {
+            unsigned long long first;
+            char suffix[8];
+            if (::std::sscanf(entry->d_name, "segment-%20llu.%7s", &first, suffix) == 2 &&
+                ::std::strcmp(suffix, "wal") == 0) {
+                segments.push_back(first);
+            }
+        }
+        ::closedir(handle);
+        ::std::sort(segments.begin(), segments.end());
+        return segments;
+    }
+    /// @brief Read the valid records of a segment.
+    /// @param path The path of the segment.
+    /// @param firstSequence The sequence number the segment starts at.
+    /// @param reader Takes each record, if not null.
+    /// @param end Set to the offset past the last valid record.
+    /// @return The sequence number of the last valid record, 0 if none.
+    inline static ::std::uint64_t scanSegment(const ::std::string& path, ::std::uint64_t firstSequence,
+        const ::std::function<void(::std::uint64_t, const char*, ::std::size_t)>* reader, ::std::uint64_t& end) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throwSystemError("Cannot open the log segment " + path);
+        ::std::string contents;
+        char buffer[1 << 16];
+        for (;;) {
+            ::ssize_t count = ::read(fd, buffer, sizeof(buffer));
+            if (count < 0) {
+                int error = errno;
+                ::close(fd);
+                throw ::std::system_error(error, ::std::generic_category(), "Cannot read the log segment " + path);
+            }
+            if (count == 0) break;
+            contents.append(buffer, static_cast<::std::size_t>(count));
+        }
+        ::close(fd);
+
+        ::std::uint64_t last = 0, expected = firstSequence;
+        ::std::size_t offset = 0;
+        while (contents.size() - offset >= sizeof(Header)) {
+            Header header;
+            ::std::memcpy(&header, contents.data() + offset, sizeof(header));
+            if (header.sequence != expected || contents.size() - offset - sizeof(Header) < header.size) break;
+            const char* payload = contents.data() + offset + sizeof(Header);
+            ::std::uint32_t crc = crc32c(crc32c(0, &header.size, sizeof(Header) - sizeof(header.crc)), payload, header.size);
+            if (crc != header.crc) break;
+            if (reader != nullptr) (*reader)(header.sequence, payload, header.size);
+            last = header.sequence;
+            expected++;
+            offset += sizeof(Header) + header.size;
+        }
+        end = offset;
+        return last;
+    }
+
+    /// @brief Create a segment and make it the current one.
+    inline void openSegment(::std::uint64_t firstSequence) {
+        int fd = ::open(segmentPath(_directory, firstSequence).c_str(), O_WRONLY | O_CREAT | O_APPEND | O_TRUNC, 0644);
+        if (fd < 0) throwSystemError("Cannot create a segment of the log " + _directory);
+        // The new file has to survive a crash too.
+        int directoryFd = ::open(_directory.c_str(), O_RDONLY);
+        if (directoryFd >= 0) {
+            if (_options.isSyncing) ::fsync(directoryFd);
+            ::close(directoryFd);
+        }
+        if (_fd >= 0) ::close(_fd);
+        _fd = fd;
+        _segmentSize = 0;
+        ::std::lock_guard<::std::mutex> lock(_segmentsMutex);
+        _segments.push_back(firstSequence);
+    }
+
+    /// @brief Wait until the records up to a sequence number are durable, committing them
+    /// if no writer is.
+    /// @param lock The lock of the log.
+    /// @param sequence The sequence number, at most the last one appended.
+    inline void waitUntilDurable(::std::unique_lock<::std::mutex>& lock, ::std::uint64_t sequence) {
+        while (_durableSequence < sequence) {
+            if (_error) ::std::rethrow_exception(_error);
+            if (_isFlushing) {
+                _condition.wait(lock);
+            } else {
+                flushPending(lock, false);
+            }
+        }
+    }
+    /// @brief Write and sync the queued records, as the one writer doing so. The lock is
+    /// released meanwhile.
+    /// @param lock The lock of the log.
+    /// @param shouldRotate Whether to start a new segment after the records.
+    inline void flushPending(::std::unique_lock<::std::mutex>& lock, bool shouldRotate) {
+        _isFlushing = true;
+        ::std::string batch;
+        batch.swap(_pending);
+        ::std::uint64_t last = _nextSequence - 1;
+        lock.unlock();
+        try {
+            if (!batch.empty() && _segmentSize != 0 && _segmentSize + batch.size() > _options.segmentSize) {
+                openSegment(_durableSequence + 1);
+            }
+            ::std::size_t written = 0;
+            while (written < batch.size()) {
+                ::ssize_t count = ::write(_fd, batch.data() + written, batch.size() - written);
+                if (count < 0) {
+                    if (errno == EINTR) continue;
+                    throwSystemError("Cannot write the log " + _directory);
+                }
+                written += static_cast<::std::size_t>(count);
+            }
+            _segmentSize += batch.size();
+            if (!batch.empty() && _options.isSyncing) {
+#if defined(__linux__)
+                if (::fdatasync(_fd) != 0) throwSystemError("Cannot sync the log " + _directory);
+#else
+                if (::fsync(_fd) != 0) throwSystemError("Cannot sync the log " + _directory);
+#endif
+            }
+            if (shouldRotate) openSegment(last + 1);
+        } catch (...) {
+            lock.lock();
+            // The log cannot tell which records made it, so it takes no more.
+            _error = ::std::current_exception();
+            _isFlushing = false;
+            _condition.notify_all();
+            throw;
+        }
+        lock.lock();
+        if (!batch.empty()) _syncCount++;
+        _durableSequence = last;
+        _isFlushing = false;
+        _condition.notify_all();
+    }
+
+private:
+    /// @brief The directory of the log.
+    const ::std::string _directory;
+    /// @brief The options.
+    const WalOptions _options;
+    /// @brief The current segment. Only used by the flushing writer.
+    int _fd;
+    /// @brief The size of the current segment. Only used by the flushing writer.
+    ::std::size_t _segmentSize;
+    /// @brief Guards the sequencing and the queued records.
+    mutable ::std::mutex _mutex;
+    /// @brief Wakes up the writers when a commit is done.
+    ::std::condition_variable _condition;
+    /// @brief Guards the list of segments, which the committing writer extends without `_mutex`.
+    mutable ::std::mutex _segmentsMutex;
+    /// @brief The first sequence number of each segment.
+    ::std::vector<::std::uint64_t> _segments;
+    /// @brief The records waiting for a commit.
+    ::std::string _pending;
+    /// @brief The sequence number of the next record.
+    ::std::uint64_t _nextSequence;
+    /// @brief The sequence number of the last record committed.
+    ::std::uint64_t _durableSequence;
+    /// @brief Determines if a writer is committing.
+    bool _isFlushing;
+    /// @brief The number of syncs.
+    unsigned long long _syncCount;
+    /// @brief The failure of a commit, after which the log takes no more records.
+    ::std::exception_ptr _error;
+};
+
+/// @brief A `MatrixRegistry` whose changes are logged to a `WriteAheadLog`, with
+/// checkpoints that bound the log, recovered on construction.
+///
+/// A change returns once durable. It is applied to the registry when it is sequenced,
+/// so the registry and the log agree on the order of changes, but readers may see it
+/// before it is durable.
+///
+/// A checkpoint cuts the log between two records and writes an image of the registry as
+/// of that cut, while writers go on. Until the image is written, the first change of each
+/// key after the cut saves the value it replaces, and the image takes that saved value
+/// over the current one. The log before the cut is then dropped.
+/// @tparam Key The key type, a string or an integer.
+/// @tparam Hash The hash of the keys.
+template <typename Key, typename Hash = ::std::hash<Key>>
+class DurableMatrixRegistry final {
+public:
+    /// @brief A change of a bulk update.
+    using Update = typename MatrixRegistry<Key, Hash>::Update;
+
+    /// @brief Recover the registry from the log of a directory.
+    /// @param directory The directory of the log.
+    /// @param options The options of the log.
+    /// @param shardCount The number of shards of the registry.
+    inline explicit DurableMatrixRegistry(const ::std::string& directory, const WalOptions& options = WalOptions(),
+        unsigned int shardCount = 64) :
+    _directory(directory), _registry(shardCount), _recoveredRecords(0), _isCapturing(false) {
+        for (::std::uint64_t sequence : listFiles(directory, "checkpoint-", "img.tmp")) {
+            ::unlink(checkpointPath(directory, sequence, true).c_str());
+        }
+        ::std::vector<Update> image;
+        _checkpointSequence = readCheckpoint(directory, image);
+        if (!image.empty()) _registry.update(image);
+        WriteAheadLog::replay(directory, _checkpointSequence + 1, [this](::std::uint64_t, const char* data, ::std::size_t size) {
+            applyRecord(data, size);
+            _recoveredRecords++;
+        });
+        _log.reset(new WriteAheadLog(directory, options, _checkpointSequence));
+    }
+
+    DurableMatrixRegistry(const DurableMatrixRegistry&) = delete;
+    DurableMatrixRegistry& operator=(const DurableMatrixRegistry&) = delete;
+
+    /// @brief The registry, for reads.
+    inline const MatrixRegistry<Key, Hash>& registry() const { return _registry; }
+    /// @brief The log.
+    inline WriteAheadLog& log() { return *_log; }
+    /// @brief The number of records replayed by the construction.
+    inline ::std::uint64_t recoveredRecords() const { return _recoveredRecords; }
+    /// @brief The sequence number of the cut of the last checkpoint, 0 if none.
+    inline ::std::uint64_t checkpointSequence() const {
+        ::std::lock_guard<::std::mutex> lock(_checkpointMutex);
+        return _checkpointSequence;
+    }
+
+    /// @brief Set the matrix of a key durably, adding the key if it is missing.
+    inline void store(const Key& key, const Matrix4x4& value) { update({{key, value}}); }
+    /// @brief Apply a batch of changes durably and as one, on replay too.
+    inline void update(const ::std::vector<Update>& updates) {
+        ::std::string record(1, static_cast<char>(RecordKind::Update));
+        appendInteger(record, static_cast<::std::uint32_t>(updates.size()));
+        for (const Update& update : updates) {
+            appendKey(record, update.key);
+            record.append(reinterpret_cast<const char*>(update.value.data), sizeof(update.value.data));
+        }
+        _log->append(record.data(), record.size(), [&](::std::uint64_t) {
+            if (_isCapturing) {
+                for (const Update& update : updates) capture(update.key);
+            }
+            _registry.update(updates);
+        });
+    }
+    /// @brief Remove a key durably.
+    /// @return Whether the key was present.
+    inline bool erase(const Key& key) {
+        ::std::string record(1, static_cast<char>(RecordKind::Erase));
+        appendKey(record, key);
+        bool isErased = false;
+        _log->append(record.data(), record.size(), [&](::std::uint64_t) {
+            if (_isCapturing) capture(key);
+            isErased = _registry.erase(key);
+        });
+        return isErased;
+    }
+
+    /// @brief Write an image of the registry as of a cut of the log, then drop the log
+    /// before the cut. Writers are not held back.
+    /// @return The sequence number of the last record before the cut.
+    inline ::std::uint64_t checkpoint() {
+        ::std::lock_guard<::std::mutex> checkpointLock(_checkpointMutex);
+        // Records after the cut start a new segment, so that the older ones can go whole.
+        _log->rotate();
+        ::std::uint64_t cut = _log->cut([this](::std::uint64_t) {
+            ::std::lock_guard<::std::mutex> lock(_captureMutex);
+            _preimages.clear();
+            _isCapturing = true;
+        });
+        const ::std::string temporaryPath = checkpointPath(_directory, cut, true);
+        try {
+            writeImage(temporaryPath, cut);
+            // Records up to the cut may still wait for a commit, and the image must not
+            // cover any that could be lost.
+            _log->sync(cut);
+        } catch (...) {
+            stopCapturing();
+            ::unlink(temporaryPath.c_str());
+            throw;
+        }
+        stopCapturing();
+        if (::rename(temporaryPath.c_str(), checkpointPath(_directory, cut, false).c_str()) != 0) {
+            throw ::std::system_error(errno, ::std::generic_category(), "Cannot write the checkpoint of " + _directory);
+        }
+        int directoryFd = ::open(_directory.c_str(), O_RDONLY);
+        if (directoryFd >= 0) {
+            ::fsync(directoryFd);
+            ::close(directoryFd);
+        }
+        for (::std::uint64_t sequence : listFiles(_directory, "checkpoint-", "img")) {
+            if (sequence < cut) ::unlink(checkpointPath(_directory, sequence, false).c_str());
+        }
+        _log->truncateBefore(cut + 1);
+        _checkpointSequence = cut;
+        return cut;
+    }
+    /// @brief Run `checkpoint()` on a thread of its own.
+    inline ::std::future<::std::uint64_t> checkpointAsync() {
+        return ::std::async(::std::launch::async, [this]() { return checkpoint(); });
+    }
+
+    /// @brief Read the last checkpoint of a directory.
+    /// @param directory The directory of the log.
+    /// @param entries Receives the keys and matrices of the image.
+    /// @return The sequence number of the cut, 0 if there is no checkpoint.
+    inline static ::std::uint64_t readCheckpoint(const ::std::string& directory, ::std::vector<Update>& entries) {
+        entries.clear();
+        ::std::vector<::std::uint64_t> sequences = listFiles(directory, "checkpoint-", "img");
+        if (sequences.empty()) return 0;
+        const ::std::string path = checkpointPath(directory, sequences.back(), false);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw ::std::system_error(errno, ::std::generic_category(), "Cannot open the checkpoint " + path);
+        ::std::string contents;
+        char buffer[1 << 16];
+        for (::ssize_t count; (count = ::read(fd, buffer, sizeof(buffer))) > 0;) {
+            contents.append(buffer, static_cast<::std::size_t>(count));
+        }
+        ::close(fd);
+
+        const ::std::size_t headerSize = sizeof(CHECKPOINT_MAGIC) + sizeof(::std::uint64_t);
+        const ::std::size_t trailerSize = sizeof(::std::uint64_t) + sizeof(::std::uint32_t);
+        if (contents.size() < headerSize + trailerSize ||
+            ::std::memcmp(contents.data(), CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+            throw ::std::runtime_error("The checkpoint " + path + " is corrupt.");
+        }
+        ::std::uint32_t crc;
+        ::std::memcpy(&crc, contents.data() + contents.size() - sizeof(crc), sizeof(crc));
+        if (crc32c(0, contents.data(), contents.size() - sizeof(crc)) != crc) {
+            throw ::std::runtime_error("The checkpoint " + path + " is corrupt.");
+        }
+        const char* data = contents.data() + sizeof(CHECKPOINT_MAGIC);
+        const char* end = contents.data() + contents.size() - trailerSize;
+        ::std::uint64_t sequence = readInteger<::std::uint64_t>(data, end);
+        ::std::uint64_t count;
+        ::std::memcpy(&count, end, sizeof(count));
+        entries.resize(count);
+        for (Update& entry : entries) {
+            entry.key = readKey(data, end);
+            readBytes(data, end, entry.value.data, sizeof(entry.value.data));
+        }
+        return sequence;
+    }
+
+private:
+    /// @brief The kinds of records.
+    enum class RecordKind : char { Update = 1, Erase = 2 };
+    /// @brief Identifies checkpoint images.
+    static constexpr char CHECKPOINT_MAGIC[8] = {'M', 'X', 'C', 'H', 'K', 'P', 'T', '1'};
+    /// @brief A value saved for the checkpoint in progress.
+    struct Preimage {
+        /// @brief Determines if the key was present at the cut.
+        bool isPresent;
+        /// @brief The value at the cut.
+        Matrix4x4 value;
+    };
+
+    inline static ::std::string checkpointPath(const ::std::string& directory, ::std::uint64_t sequence,
+        bool isTemporary) {
+        char name[48];
+        ::std::snprintf(name, sizeof(name), "/checkpoint-%020llu.img%s", static_cast<unsigned long long>(sequence),
+            isTemporary ? ".tmp" : "");
+        return directory + name;
+    }
+    /// @brief The sequence numbers in the names of the files with a prefix and an extension.
+    inline static ::std::vector<::std::uint64_t> listFiles(const ::std::string& directory, const char* prefix,
+        const char* extension) {
+        ::std::vector<::std::uint64_t> sequences;
+        DIR* handle = ::opendir(directory.c_str());
+        if (handle == nullptr) return sequences;
+        ::std::size_t prefixLength = ::std::strlen(prefix);
+        while (dirent* entry = ::readdir(handle)) {
+            const char* name = entry->d_name;
+            char* dot = nullptr;
+            if (::std::strncmp(name, prefix, prefixLength) != 0) continue;
+            unsigned long long sequence = ::std::strtoull(name + prefixLength, &dot, 10);
+            if (dot != name + prefixLength && *dot == '.' && ::std::strcmp(dot + 1, extension) == 0) {
+                sequences.push_back(sequence);
+            }
+        }
+        ::closedir(handle);
+        ::std::sort(sequences.begin(), sequences.end());
+        return sequences;
+    }
+
+    /// @brief Save the value of a key at the cut, before its first change after it.
+    /// Runs while records cannot be sequenced.
+    inline void capture(const Key& key) {
+        ::std::lock_guard<::std::mutex> lock(_captureMutex);
+        if (_preimages.count(key) != 0) return;
+        Preimage preimage;
+        preimage.isPresent = _registry.load(key, preimage.value);
+        _preimages.emplace(key, preimage);
+    }
+    inline void stopCapturing() {
+        _log->cut([this](::std::uint64_t) { _isCapturing = false; });
+        ::std::lock_guard<::std::mutex> lock(_captureMutex);
+        _preimages.clear();
+    }
+
+    /// @brief Write the image of the registry at a cut, while capturing.
+    inline void writeImage(const ::std::string& path, ::std::uint64_t cut) {
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw ::std::system_error(errno, ::std::generic_category(), "Cannot create the checkpoint " + path);
+        ::std::string buffer;
+        ::std::uint32_t crc = 0;
+        auto writeBuffer = [&]() {
+            crc = crc32c(crc, buffer.data(), buffer.size());
+            ::std::size_t written = 0;
+            while (written < buffer.size()) {
+                ::ssize_t count = ::write(fd, buffer.data() + written, buffer.size() - written);
+                if (count < 0 && errno == EINTR) continue;
+                if (count < 0) {
+                    int error = errno;
+                    ::close(fd);
+                    throw ::std::system_error(error, ::std::generic_category(), "Cannot write the checkpoint " + path);
+                }
+                written += static_cast<::std::size_t>(count);
+            }
+            buffer.clear();
+        };
+        buffer.append(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+        appendInteger(buffer, cut);
+        ::std::uint64_t count = 0;
+        auto appendEntry = [&](const Key& key, const Matrix4x4& value) {
+            appendKey(buffer, key);
+            buffer.append(reinterpret_cast<const char*>(value.data), sizeof(value.data));
+            count++;
+            if (buffer.size() >= (1u << 20)) writeBuffer();
+        };
+
+        // A key not saved yet has not changed since the cut, and cannot while the capture
+        // lock is held. Keys removed since the cut are only found among the saved ones.
+        const ::std::size_t CHUNK = 1024;
+        ::std::vector<Key> keys = _registry.keys();
+        ::std::unordered_set<Key, Hash> emitted;
+        for (::std::size_t begin = 0; begin < keys.size(); begin += CHUNK) {
+            ::std::lock_guard<::std::mutex> lock(_captureMutex);
+            for (::std::size_t i = begin; i < ::std::min(keys.size(), begin + CHUNK); i++) {
+                auto preimage = _preimages.find(keys[i]);
+                if (preimage != _preimages.end()) {
+                    if (preimage->second.isPresent) appendEntry(keys[i], preimage->second.value);
+                    emitted.insert(keys[i]);
+                } else {
+                    Matrix4x4 value;
+                    if (_registry.load(keys[i], value)) appendEntry(keys[i], value);
+                }
+            }
+        }
+        {
+            ::std::lock_guard<::std::mutex> lock(_captureMutex);
+            for (const auto& preimage : _preimages) {
+                if (preimage.second.isPresent && emitted.count(preimage.first) == 0) {
+                    appendEntry(preimage.first, preimage.second.value);
+                }
+            }
+        }
+        appendInteger(buffer, count);
+        writeBuffer();
+        ::std::string trailer;
+        appendInteger(trailer, crc);
+        buffer = trailer;
+        writeBuffer();
+        if (::fsync(fd) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw ::std::system_error(error, ::std::generic_category(), "Cannot sync the checkpoint " + path);
+        }
+        ::close(fd);
+    }
+
+    template <typename Integer>
+    inline static void appendInteger(::std::string& record, Integer value) {
+        record.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    template <typename Integer>
+    inline static Integer readInteger(const char*& data, const char* end) {
+        Integer value;
+        readBytes(data, end, &value, sizeof(value));
+        return value;
+    }
+    inline static void readBytes(const char*& data, const char* end, void* target, ::std::size_t size) {
+        if (static_cast<::std::size_t>(end - data) < size) {
+            throw ::std::runtime_error("The log has a malformed record.");
+        }
+        ::std::memcpy(target, data, size);
+        data += size;
+    }
+    inline static void appendKey(::std::string& record, const Key& key) {
+        if constexpr (::std::is_integral<Key>::value) {
+            appendInteger(record, key);
+        } else {
+            appendInteger(record, static_cast<::std::uint32_t>(key.size()));
+            record.append(key.data(), key.size());
+        }
+    }
+    inline static Key readKey(const char*& data, const char* end) {
+        if constexpr (::std::is_integral<Key>::value) {
+            return readInteger<Key>(data, end);
+        } else {
+            Key key(readInteger<::std::uint32_t>(data, end), '\0');
+            readBytes(data, end, &key[0], key.size());
+            return key;
+        }
+    }
+
+    /// @brief Apply a record of the log to the registry.
+    inline void applyRecord(const char* data, ::std::size_t size) {
+        const char* end = data + size;
+        RecordKind kind = static_cast<RecordKind>(readInteger<char>(data, end));
+        if (kind == RecordKind::Update) {
+            ::std::vector<Update> updates(readInteger<::std::uint32_t>(data, end));
+            for (Update& update : updates) {
+                update.key = readKey(data, end);
+                readBytes(data, end, update.value.data, sizeof(update.value.data));
+            }
+            _registry.update(updates);
+        } else if (kind == RecordKind::Erase) {
+            _registry.erase(readKey(data, end));
+        } else {
+            throw ::std::runtime_error("The log has a malformed record.");
+        }
+    }
+
+private:
+    /// @brief The directory of the log and of the checkpoints.
+    const ::std::string _directory;
+    /// @brief The registry.
+    MatrixRegistry<Key, Hash> _registry;
+    /// @brief The log.
+    ::std::unique_ptr<WriteAheadLog> _log;
+    /// @brief The number of records replayed by the construction.
+    ::std::uint64_t _recoveredRecords;
+    /// @brief Serializes checkpoints.
+    mutable ::std::mutex _checkpointMutex;
+    /// @brief The sequence number of the cut of the last checkpoint.
+    ::std::uint64_t _checkpointSequence;
+    /// @brief Determines if changes save their keys' values. Set and read while records
+    /// cannot be sequenced.
+    bool _isCapturing;
+    /// @brief Guards the saved values.
+    ::std::mutex _captureMutex;
+    /// @brief The values at the cut of the keys changed since.
+    ::std::unordered_map<Key, Preimage, Hash> _preimages;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file
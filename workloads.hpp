@@ -0,0 +1,566 @@
+/*
+
+File: workloads.hpp
+Author: Aldhinn Espinas
+Description: This file contains benchmark workloads on 4x4 matrices that model real
+    uses, run against concurrent writers.
+
+License: MIT License
+
+Copyright (c) 2024-Present Aldhinn Espinas
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+
+#if !defined(WORKLOADS_HEADER_FILE)
+#define WORKLOADS_HEADER_FILE
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "matrix.hpp"
+#include "sync_matrix.hpp"
+
+/// @brief The outcome of a workload run.
+struct WorkloadResult {
+    /// @brief The number of steps the reader completed.
+    unsigned long long readSteps;
+    /// @brief The number of steps the writers completed.
+    unsigned long long writeSteps;
+    /// @brief The number of matrices the reader saw in a state no writer wrote.
+    unsigned long long inconsistentReads;
+    /// @brief The duration of the run.
+    double seconds;
+
+    /// @brief The reader steps per second.
+    inline double readRate() const { return static_cast<double>(readSteps) / seconds; }
+    /// @brief The writer steps per second.
+    inline double writeRate() const { return static_cast<double>(writeSteps) / seconds; }
+};
+
+/// @brief Run a workload: writers call `writeStep` in the background while the calling
+/// thread calls `readStep` for the given duration.
+/// @param workload The workload, with `writeStep(writerIndex, writerCount, random)` and
+/// `readStep()` returning the number of inconsistent matrices it saw.
+/// @param writerCount The number of writer threads.
+/// @param duration The duration of the run.
+/// @return The outcome.
+template <typename Workload>
+inline WorkloadResult runWorkload(Workload& workload, unsigned int writerCount, ::std::chrono::milliseconds duration) {
+    ::std::atomic<bool> shouldContinue(true);
+    ::std::atomic<unsigned long long> writeSteps(0);
+    ::std::vector<::std::thread> writers;
+    for (unsigned int writerIndex = 0; writerIndex < writerCount; writerIndex++) {
+        writers.emplace_back([&, writerIndex]() {
+            ::std::mt19937 random(writerIndex + 1);
+            unsigned long long steps = 0;
+            while (shouldContinue.load(::std::memory_order_relaxed)) {
+                workload.writeStep(writerIndex, writerCount, random);
+                steps++;
+            }
+            writeSteps.fetch_add(steps);
+        });
+    }
+
+    WorkloadResult result = {0, 0, 0, 0.0};
+    auto start = ::std::chrono::steady_clock::now();
+    auto elapsed = ::std::chrono::steady_clock::duration::zero();
+    do {
+        result.inconsistentReads += workload.readStep();
+        result.readSteps++;
+        elapsed = ::std::chrono::steady_clock::now() - start;
+    } while (elapsed < duration);
+    shouldContinue.store(false);
+    for (::std::thread& writer : writers) writer.join();
+
+    result.writeSteps = writeSteps.load();
+    result.seconds = ::std::chrono::duration<double>(elapsed).count();
+    return result;
+}
+
+/// @brief A rotation of an angle about a unit axis, with a translation.
+/// @param axis The unit axis.
+/// @param angle The angle in radians.
+/// @param translation The translation.
+inline Matrix4x4 rigidTransform(const double* axis, double angle, const double* translation) {
+    const double c = ::std::cos(angle), s = ::std::sin(angle), t = 1.0 - c;
+    const double x = axis[0], y = axis[1], z = axis[2];
+    Matrix4x4 result = Matrix4x4::identity();
+    result(0, 0) = c + t * x * x;     result(0, 1) = t * x * y - s * z; result(0, 2) = t * x * z + s * y;
+    result(1, 0) = t * x * y + s * z; result(1, 1) = c + t * y * y;     result(1, 2) = t * y * z - s * x;
+    result(2, 0) = t * x * z - s * y; result(2, 1) = t * y * z + s * x; result(2, 2) = c + t * z * z;
+    for (unsigned int row = 0; row < 3; row++) result(row, 3) = translation[row];
+    return result;
+}
+
+/// @brief Determines if the rotation part of a transform is orthonormal. The mix of two
+/// different rotations almost never is.
+inline bool isRigid(const Matrix4x4& mat, double tolerance = 1e-9) {
+    for (unsigned int i = 0; i < 3; i++) {
+        for (unsigned int j = i; j < 3; j++) {
+            double dot = mat(0, i) * mat(0, j) + mat(1, i) * mat(1, j) + mat(2, i) * mat(2, j);
+            if (::std::fabs(dot - (i == j ? 1.0 : 0.0)) > tolerance) return false;
+        }
+    }
+    return mat(3, 0) == 0.0 && mat(3, 1) == 0.0 && mat(3, 2) == 0.0 && mat(3, 3) == 1.0;
+}
+
+/// @brief Linear-blend skinning. Writers animate bones, the reader takes the bone
+/// palette of a frame and skins every vertex with it.
+class SkinningWorkload final {
+public:
+    /// @brief The number of bones influencing a vertex.
+    static constexpr unsigned int INFLUENCES = 4;
+
+    /// @brief Construct a skeleton and a mesh bound to it.
+    /// @param strategy The synchronization of the bone matrices.
+    /// @param boneCount The number of bones.
+    /// @param vertexCount The number of vertices.
+    inline SkinningWorkload(SyncStrategy strategy, ::std::size_t boneCount = 2048, ::std::size_t vertexCount = 20000) :
+    _bones(boneCount), _palette(boneCount), _restPositions(vertexCount * 3), _skinnedPositions(vertexCount * 3),
+    _boneIndices(vertexCount * INFLUENCES), _weights(vertexCount * INFLUENCES) {
+        for (::std::size_t i = 0; i < boneCount; i++) _bones[i].reset(new SynchronizedMatrix4x4(strategy));
+        ::std::mt19937 random(7);
+        ::std::uniform_real_distribution<double> position(-1.0, 1.0);
+        for (::std::size_t vertex = 0; vertex < vertexCount; vertex++) {
+            for (int axis = 0; axis < 3; axis++) _restPositions[vertex * 3 + axis] = position(random);
+            double total = 0.0;
+            for (unsigned int i = 0; i < INFLUENCES; i++) {
+                _boneIndices[vertex * INFLUENCES + i] = static_cast<unsigned int>(random() % boneCount);
+                _weights[vertex * INFLUENCES + i] = 2.0 + position(random);
+                total += _weights[vertex * INFLUENCES + i];
+            }
+            for (unsigned int i = 0; i < INFLUENCES; i++) _weights[vertex * INFLUENCES + i] /= total;
+        }
+    }
+
+    /// @brief Pose a random bone.
+    inline void writeStep(unsigned int, unsigned int, ::std::mt19937& random) {
+        static const double AXIS[3] = {0.0, 0.6, 0.8};
+        ::std::uniform_real_distribution<double> distribution(-3.0, 3.0);
+        double translation[3] = {distribution(random), distribution(random), distribution(random)};
+        _bones[random() % _bones.size()]->store(rigidTransform(AXIS, distribution(random), translation));
+    }
+    /// @brief Skin a frame.
+    /// @return The number of bones of the palette read in a torn state.
+    inline unsigned long long readStep() {
+        unsigned long long inconsistent = 0;
+        for (::std::size_t bone = 0; bone < _bones.size(); bone++) {
+            _palette[bone] = _bones[bone]->load();
+            if (!isRigid(_palette[bone])) inconsistent++;
+        }
+        for (::std::size_t vertex = 0; vertex < _restPositions.size() / 3; vertex++) {
+            const double* rest = &_restPositions[vertex * 3];
+            double skinned[3] = {0.0, 0.0, 0.0};
+            for (unsigned int i = 0; i < INFLUENCES; i++) {
+                const Matrix4x4& bone = _palette[_boneIndices[vertex * INFLUENCES + i]];
+                double weight = _weights[vertex * INFLUENCES + i];
+                for (unsigned int row = 0; row < 3; row++) {
+                    skinned[row] += weight * (bone(row, 0) * rest[0] + bone(row, 1) * rest[1] +
+                        bone(row, 2) * rest[2] + bone(row, 3));
+                }
+            }
+            for (int axis = 0; axis < 3; axis++) _skinnedPositions[vertex * 3 + axis] = skinned[axis];
+        }
+        return inconsistent;
+    }
+
+private:
+    /// @brief The bone matrices, shared with the writers.
+    ::std::vector<::std::unique_ptr<SynchronizedMatrix4x4>> _bones;
+    /// @brief The bone matrices of the current frame.
+    ::std::vector<Matrix4x4> _palette;
+    /// @brief The bind-pose positions.
+    ::std::vector<double> _restPositions;
+    /// @brief The skinned positions.
+    ::std::vector<double> _skinnedPositions;
+    /// @brief The bones influencing each vertex.
+    ::std::vector<unsigned int> _boneIndices;
+    /// @brief The weights of the influences of each vertex, summing up to 1.
+    ::std::vector<double> _weights;
+};
+
+/// @brief Batched Kalman filter prediction, `P = F P F^T + Q`, of constant-velocity
+/// tracks. Writers retune the time step of the motion model, the reader predicts every
+/// track with the model it reads.
+class KalmanPredictWorkload final {
+public:
+    /// @brief Construct the tracks.
+    /// @param strategy The synchronization of the motion model.
+    /// @param trackCount The number of tracks.
+    inline explicit KalmanPredictWorkload(SyncStrategy strategy, ::std::size_t trackCount = 4096) :
+    _transition(strategy, transitionFor(0.01)), _noise(strategy, noiseFor(0.01)),
+    _covariances(trackCount, Matrix4x4::identity()) {}
+
+    /// @brief The transition of the state `(x, y, vx, vy)` over a time step.
+    inline static Matrix4x4 transitionFor(double timeStep) {
+        Matrix4x4 transition = Matrix4x4::identity();
+        transition(0, 2) = timeStep;
+        transition(1, 3) = timeStep;
+        return transition;
+    }
+    /// @brief The process noise of a time step, for a unit white-noise acceleration.
+    inline static Matrix4x4 noiseFor(double timeStep) {
+        Matrix4x4 noise;
+        double cube = timeStep * timeStep * timeStep / 3.0, square = timeStep * timeStep / 2.0;
+        noise(0, 0) = cube; noise(0, 2) = square;
+        noise(1, 1) = cube; noise(1, 3) = square;
+        noise(2, 0) = square; noise(2, 2) = timeStep;
+        noise(3, 1) = square; noise(3, 3) = timeStep;
+        return noise;
+    }
+
+    /// @brief Retune the time step.
+    inline void writeStep(unsigned int, unsigned int, ::std::mt19937& random) {
+        double timeStep = ::std::uniform_real_distribution<double>(0.001, 0.05)(random);
+        _transition.store(transitionFor(timeStep));
+        _noise.store(noiseFor(timeStep));
+    }
+    /// @brief Predict every track.
+    /// @return The number of model matrices read in a torn state.
+    inline unsigned long long readStep() {
+        Matrix4x4 transition = _transition.load();
+        Matrix4x4 noise = _noise.load();
+        unsigned long long inconsistent = 0;
+        if (transition(0, 2) != transition(1, 3)) inconsistent++;
+        if (noise(0, 0) != noise(1, 1) || noise(2, 2) != noise(3, 3)) inconsistent++;
+        Matrix4x4 transposed = transpose(transition);
+        for (Matrix4x4& covariance : _covariances) {
+            covariance = transition * covariance * transposed + noise;
+            // Without measurements the covariance only grows. Start the track over.
+            if (trace(covariance) > 1e6) covariance = Matrix4x4::identity();
+        }
+        return inconsistent;
+    }
+
+private:
+    /// @brief The transition of the motion model.
+    SynchronizedMatrix4x4 _transition;
+    /// @brief The process noise of the motion model.
+    SynchronizedMatrix4x4 _noise;
+    /// @brief The state covariance of each track.
+    ::std::vector<Matrix4x4> _covariances;
+};
+
+/// @brief Rigid-body integration. Writers integrate the bodies they own and publish
+/// their transforms, the reader gathers every transform like a renderer would.
+class RigidBodyWorkload final {
+public:
+    /// @brief Construct the bodies, spinning about random axes.
+    /// @param strategy The synchronization of the transforms.
+    /// @param bodyCount The number of bodies.
+    inline explicit RigidBodyWorkload(SyncStrategy strategy, ::std::size_t bodyCount = 4096) :
+    _transforms(bodyCount), _states(bodyCount) {
+        ::std::mt19937 random(11);
+        ::std::normal_distribution<double> distribution;
+        for (::std::size_t i = 0; i < bodyCount; i++) {
+            _transforms[i].reset(new SynchronizedMatrix4x4(strategy));
+            BodyState& state = _states[i];
+            double length = 0.0;
+            for (int axis = 0; axis < 3; axis++) {
+                state.axis[axis] = distribution(random);
+                length += state.axis[axis] * state.axis[axis];
+                state.position[axis] = 10.0 * distribution(random);
+                state.velocity[axis] = distribution(random);
+            }
+            for (int axis = 0; axis < 3; axis++) state.axis[axis] /= ::std::sqrt(length);
+            state.angle = 0.0;
+            state.angularSpeed = distribution(random);
+        }
+    }
+
+    /// @brief Integrate a random body among the ones owned by the writer.
+    inline void writeStep(unsigned int writerIndex, unsigned int writerCount, ::std::mt19937& random) {
+        const double TIME_STEP = 1.0 / 240.0;
+        ::std::size_t owned = (_states.size() - writerIndex + writerCount - 1) / writerCount;
+        if (owned == 0) return;
+        ::std::size_t body = writerIndex + (random() % owned) * writerCount;
+        BodyState& state = _states[body];
+        state.angle = ::std::fmod(state.angle + state.angularSpeed * TIME_STEP, 2.0 * 3.14159265358979323846);
+        for (int axis = 0; axis < 3; axis++) state.position[axis] += state.velocity[axis] * TIME_STEP;
+        _transforms[body]->store(rigidTransform(state.axis, state.angle, state.position));
+    }
+    /// @brief Gather the transforms and the center of the bodies.
+    /// @return The number of transforms read in a torn state.
+    inline unsigned long long readStep() {
+        unsigned long long inconsistent = 0;
+        double center[3] = {0.0, 0.0, 0.0};
+        for (const ::std::unique_ptr<SynchronizedMatrix4x4>& transform : _transforms) {
+            Matrix4x4 value = transform->load();
+            if (!isRigid(value)) inconsistent++;
+            for (unsigned int axis = 0; axis < 3; axis++) center[axis] += value(axis, 3);
+        }
+        _center[0] = center[0]; _center[1] = center[1]; _center[2] = center[2];
+        return inconsistent;
+    }
+
+private:
+    /// @brief The motion of a body, only touched by the writer owning it.
+    struct BodyState {
+        /// @brief The unit axis of rotation.
+        double axis[3];
+        /// @brief The angle about the axis.
+        double angle;
+        /// @brief The angular speed about the axis.
+        double angularSpeed;
+        /// @brief The position.
+        double position[3];
+        /// @brief The velocity.
+        double velocity[3];
+    };
+
+    /// @brief The published transforms.
+    ::std::vector<::std::unique_ptr<SynchronizedMatrix4x4>> _transforms;
+    /// @brief The motion of every body. Body `i` is owned by writer `i % writerCount`.
+    ::std::vector<BodyState> _states;
+    /// @brief The sum of the positions read last.
+    double _center[3];
+};
+
+/// @brief How the keys of a workload are drawn.
+struct KeyDistribution {
+    /// @brief The kinds of distributions.
+    enum class Kind {
+        /// @brief Every key is equally likely.
+        Uniform,
+        /// @brief The key of rank `i` is drawn with a probability proportional to `1 / i^theta`.
+        Zipfian,
+        /// @brief A hot set of keys gets a fixed share of the accesses, uniformly within each set.
+        Hotspot
+    };
+
+    /// @brief The kind of distribution.
+    Kind kind = Kind::Uniform;
+    /// @brief The skew of the Zipfian distribution, below 1.
+    double theta = 0.99;
+    /// @brief The fraction of the keys in the hot set.
+    double hotSetFraction = 0.01;
+    /// @brief The fraction of the accesses to the hot set.
+    double hotAccessFraction = 0.9;
+    /// @brief Whether the ranks are hashed to keys, so that the hot keys are spread out
+    /// instead of being neighbours in memory.
+    bool isScrambled = true;
+
+    /// @brief A uniform distribution.
+    inline static KeyDistribution uniform() { return KeyDistribution(); }
+    /// @brief A Zipfian distribution.
+    inline static KeyDistribution zipfian(double theta = 0.99) {
+        KeyDistribution distribution;
+        distribution.kind = Kind::Zipfian;
+        distribution.theta = theta;
+        return distribution;
+    }
+    /// @brief A hotspot distribution.
+    inline static KeyDistribution hotspot(double hotSetFraction = 0.01, double hotAccessFraction = 0.9) {
+        KeyDistribution distribution;
+        distribution.kind = Kind::Hotspot;
+        distribution.hotSetFraction = hotSetFraction;
+        distribution.hotAccessFraction = hotAccessFraction;
+        return distribution;
+    }
+};
+
+/// @brief Draws keys from a distribution. Immutable once constructed, so threads share
+/// it and each draws its own key stream with a random number generator of its own.
+class KeyGenerator final {
+public:
+    /// @brief Prepare the distribution. Zipfian distributions take O(keyCount).
+    /// @param keyCount The number of keys.
+    /// @param distribution The distribution.
+    inline KeyGenerator(::std::size_t keyCount, const KeyDistribution& distribution) :
+    _keyCount(keyCount), _distribution(distribution), _zetaN(0.0), _alpha(0.0), _eta(0.0), _hotKeys(0) {
+        if (keyCount == 0) {
+            throw ::std::invalid_argument("There has to be at least one key.");
+        }
+        if (distribution.kind == KeyDistribution::Kind::Zipfian) {
+            if (!(distribution.theta > 0.0 && distribution.theta < 1.0)) {
+                throw ::std::invalid_argument("The Zipfian skew has to be between 0 and 1.");
+            }
+            // Gray et al., "Quickly generating billion-record synthetic databases".
+            for (::std::size_t i = 1; i <= keyCount; i++) {
+                _zetaN += 1.0 / ::std::pow(static_cast<double>(i), distribution.theta);
+            }
+            double zeta2 = 1.0 + 1.0 / ::std::pow(2.0, distribution.theta);
+            _alpha = 1.0 / (1.0 - distribution.theta);
+            _eta = (1.0 - ::std::pow(2.0 / static_cast<double>(keyCount), 1.0 - distribution.theta)) /
+                (1.0 - zeta2 / _zetaN);
+        }
+        _hotKeys = ::std::max<::std::size_t>(1,
+            static_cast<::std::size_t>(distribution.hotSetFraction * static_cast<double>(keyCount)));
+    }
+
+    /// @brief The number of keys.
+    inline ::std::size_t keyCount() const { return _keyCount; }
+
+    /// @brief Draw the rank of a key, 0 being the most accessed.
+    inline ::std::size_t nextRank(::std::mt19937_64& random) const {
+        ::std::uniform_real_distribution<double> unit(0.0, 1.0);
+        switch (_distribution.kind) {
+        case KeyDistribution::Kind::Zipfian: {
+            double u = unit(random);
+            double uz = u * _zetaN;
+            if (uz < 1.0) return 0;
+            if (uz < 1.0 + ::std::pow(0.5, _distribution.theta)) return ::std::min<::std::size_t>(1, _keyCount - 1);
+            ::std::size_t rank = static_cast<::std::size_t>(
+                static_cast<double>(_keyCount) * ::std::pow(_eta * u - _eta + 1.0, _alpha));
+            return ::std::min(rank, _keyCount - 1);
+        }
+        case KeyDistribution::Kind::Hotspot:
+            if (_hotKeys >= _keyCount || unit(random) < _distribution.hotAccessFraction) return random() % _hotKeys;
+            return _hotKeys + random() % (_keyCount - _hotKeys);
+        default:
+            return random() % _keyCount;
+        }
+    }
+    /// @brief Draw a key.
+    inline ::std::size_t next(::std::mt19937_64& random) const {
+        ::std::size_t rank = nextRank(random);
+        return _distribution.isScrambled ? scramble(rank) : rank;
+    }
+    /// @brief The key of a rank.
+    inline ::std::size_t scramble(::std::size_t rank) const {
+        // FNV-1a over the bytes of the rank, like the scrambled generator of YCSB.
+        ::std::uint64_t hash = 14695981039346656037ull;
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (static_cast<::std::uint64_t>(rank) >> (byte * 8)) & 0xff;
+            hash *= 1099511628211ull;
+        }
+        return static_cast<::std::size_t>(hash % _keyCount);
+    }
+
+private:
+    /// @brief The number of keys.
+    ::std::size_t _keyCount;
+    /// @brief The distribution.
+    KeyDistribution _distribution;
+    /// @brief The generalized harmonic number of the keys, for the Zipfian distribution.
+    double _zetaN;
+    /// @brief `1 / (1 - theta)`, for the Zipfian distribution.
+    double _alpha;
+    /// @brief The correction of the Zipfian approximation.
+    double _eta;
+    /// @brief The number of keys in the hot set.
+    ::std::size_t _hotKeys;
+};
+
+/// @brief The outcome of a run of a `ManyMatrixWorkload`.
+struct MixedWorkloadResult {
+    /// @brief The number of reads.
+    unsigned long long reads;
+    /// @brief The number of writes.
+    unsigned long long writes;
+    /// @brief The number of reads that saw a matrix no writer wrote.
+    unsigned long long inconsistentReads;
+    /// @brief The duration of the run.
+    double seconds;
+
+    /// @brief The operations per second.
+    inline double operationRate() const { return static_cast<double>(reads + writes) / seconds; }
+};
+
+/// @brief A mix of reads and writes over many matrices, with skewed keys. Every thread
+/// both reads and writes, each with a key stream of its own.
+///
+/// A write fills a matrix with a single value, so a read seeing different values saw
+/// parts of several writes.
+class ManyMatrixWorkload final {
+public:
+    /// @brief Construct the matrices.
+    /// @param strategy The synchronization of the matrices.
+    /// @param matrixCount The number of matrices.
+    /// @param readFraction The fraction of the operations that are reads.
+    /// @param distribution The distribution of the keys.
+    inline ManyMatrixWorkload(SyncStrategy strategy, ::std::size_t matrixCount, double readFraction,
+        const KeyDistribution& distribution) :
+    _matrices(matrixCount), _keys(matrixCount, distribution), _readFraction(readFraction) {
+        for (::std::unique_ptr<SynchronizedMatrix4x4>& matrix : _matrices) {
+            matrix.reset(new SynchronizedMatrix4x4(strategy, Matrix4x4()));
+        }
+    }
+
+    /// @brief The key generator.
+    inline const KeyGenerator& keys() const { return _keys; }
+
+    /// @brief Run the workload.
+    /// @param threadCount The number of threads.
+    /// @param duration The duration of the run.
+    /// @return The outcome.
+    inline MixedWorkloadResult run(unsigned int threadCount, ::std::chrono::milliseconds duration) {
+        ::std::atomic<bool> shouldContinue(true);
+        ::std::atomic<unsigned long long> reads(0), writes(0), inconsistentReads(0);
+        ::std::vector<::std::thread> threads;
+        auto start = ::std::chrono::steady_clock::now();
+        for (unsigned int threadIndex = 0; threadIndex < threadCount; threadIndex++) {
+            threads.emplace_back([&, threadIndex]() {
+                ::std::mt19937_64 random(threadIndex * 0x9e3779b97f4a7c15ull + 1);
+                ::std::uniform_real_distribution<double> unit(0.0, 1.0);
+                unsigned long long threadReads = 0, threadWrites = 0, threadInconsistent = 0;
+                while (shouldContinue.load(::std::memory_order_relaxed)) {
+                    SynchronizedMatrix4x4& matrix = *_matrices[_keys.next(random)];
+                    if (unit(random) < _readFraction) {
+                        Matrix4x4 value = matrix.load();
+                        for (int i = 1; i < 16; i++) {
+                            if (value.data[i] != value.data[0]) {
+                                threadInconsistent++;
+                                break;
+                            }
+                        }
+                        threadReads++;
+                    } else {
+                        Matrix4x4 value;
+                        double fill = static_cast<double>(random() % 1000000);
+                        for (int i = 0; i < 16; i++) value.data[i] = fill;
+                        matrix.store(value);
+                        threadWrites++;
+                    }
+                }
+                reads.fetch_add(threadReads);
+                writes.fetch_add(threadWrites);
+                inconsistentReads.fetch_add(threadInconsistent);
+            });
+        }
+        ::std::this_thread::sleep_for(duration);
+        shouldContinue.store(false);
+        for (::std::thread& thread : threads) thread.join();
+        double seconds = ::std::chrono::duration<double>(::std::chrono::steady_clock::now() - start).count();
+        return {reads.load(), writes.load(), inconsistentReads.load(), seconds};
+    }
+
+private:
+    /// @brief The matrices.
+    ::std::vector<::std::unique_ptr<SynchronizedMatrix4x4>> _matrices;
+    /// @brief The key generator.
+    KeyGenerator _keys;
+    /// @brief The fraction of the operations that are reads.
+    double _readFraction;
+};
+
+#endif
+// End of file.
+// DO NOT WRITE BEYOND HERE.
\ No newline at end of file